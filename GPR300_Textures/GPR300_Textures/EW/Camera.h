@@ -13,6 +13,11 @@ public:
 	inline float getYaw()const { return mYaw; }
 	inline float getPitch()const { return mPitch; }
 	inline float getFov()const { return mFov; }
+	inline float getNearPlane()const { return mNearPlane; }
+	inline float getFarPlane()const { return mFarPlane; }
+	inline float getAspectRatio()const { return mAspectRatio; }
+	inline float getOrthoSize()const { return mOrthoSize; }
+	inline bool isOrtho()const { return mOrtho; }
 	glm::vec3 getForward();
 	glm::mat4 getProjectionMatrix();
 	glm::mat4 getViewMatrix();
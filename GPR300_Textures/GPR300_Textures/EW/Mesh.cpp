@@ -1,44 +1,490 @@
 //Author: Eric Winebrenner
 
 #include "Mesh.h"
+
+#include <stdio.h>
+#include <math.h>
+#include <utility>
+
+#include <glm/gtc/packing.hpp>
+
 namespace ew {
-	Mesh::Mesh(MeshData* meshData) {
+	glm::vec2 encodeOctahedral(glm::vec3 normal) {
+		normal /= fabsf(normal.x) + fabsf(normal.y) + fabsf(normal.z);
+		glm::vec2 encoded = glm::vec2(normal.x, normal.y);
+		//The lower half folds out over the corners
+		if (normal.z < 0) {
+			encoded.x = (1.f - fabsf(normal.y)) * (normal.x >= 0 ? 1.f : -1.f);
+			encoded.y = (1.f - fabsf(normal.x)) * (normal.y >= 0 ? 1.f : -1.f);
+		}
+		return encoded;
+	}
+
+	glm::vec3 decodeOctahedral(glm::vec2 encoded) {
+		glm::vec3 normal = glm::vec3(encoded.x, encoded.y, 1.f - fabsf(encoded.x) - fabsf(encoded.y));
+		if (normal.z < 0) {
+			normal.x = (1.f - fabsf(encoded.y)) * (encoded.x >= 0 ? 1.f : -1.f);
+			normal.y = (1.f - fabsf(encoded.x)) * (encoded.y >= 0 ? 1.f : -1.f);
+		}
+		return glm::normalize(normal);
+	}
+
+	VertexQuantization computeVertexQuantization(const std::vector<Vertex>& vertices) {
+		VertexQuantization quantization;
+		if (vertices.empty()) {
+			return quantization;
+		}
+
+		glm::vec3 min = vertices[0].position;
+		glm::vec3 max = vertices[0].position;
+		glm::vec2 uvMin = vertices[0].uv;
+		glm::vec2 uvMax = vertices[0].uv;
+		for (size_t i = 1; i < vertices.size(); i++) {
+			min = glm::min(min, vertices[i].position);
+			max = glm::max(max, vertices[i].position);
+			uvMin = glm::min(uvMin, vertices[i].uv);
+			uvMax = glm::max(uvMax, vertices[i].uv);
+		}
+
+		quantization.positionOffset = (min + max) * .5f;
+		quantization.positionScale = (max - min) * .5f;
+		quantization.uvOffset = uvMin;
+		quantization.uvScale = uvMax - uvMin;
+		return quantization;
+	}
+
+	QuantizedVertex quantizeVertex(const Vertex& vertex, const VertexQuantization& quantization) {
+		QuantizedVertex quantized;
+		glm::vec3 relative = vertex.position - quantization.positionOffset;
+		for (int c = 0; c < 3; c++) {
+			//Flat axes, like a plane's, only ever hold the offset
+			float unit = quantization.positionScale[c] > 0.f ? relative[c] / quantization.positionScale[c] : 0.f;
+			quantized.position[c] = (int16_t)glm::packSnorm1x16(unit);
+		}
+		quantized.position[3] = 0;
+
+		glm::vec2 octahedral = encodeOctahedral(vertex.normal);
+		quantized.normal[0] = (int16_t)glm::packSnorm1x16(octahedral.x);
+		quantized.normal[1] = (int16_t)glm::packSnorm1x16(octahedral.y);
+
+		glm::vec2 uvRelative = vertex.uv - quantization.uvOffset;
+		for (int c = 0; c < 2; c++) {
+			quantized.uv[c] = glm::packUnorm1x16(quantization.uvScale[c] > 0.f ? uvRelative[c] / quantization.uvScale[c] : 0.f);
+		}
+		return quantized;
+	}
+
+	Vertex dequantizeVertex(const QuantizedVertex& vertex, const VertexQuantization& quantization) {
+		glm::vec3 unit = glm::vec3(glm::unpackSnorm1x16((uint16_t)vertex.position[0]), glm::unpackSnorm1x16((uint16_t)vertex.position[1]), glm::unpackSnorm1x16((uint16_t)vertex.position[2]));
+		glm::vec3 position = unit * quantization.positionScale + quantization.positionOffset;
+		glm::vec3 normal = decodeOctahedral(glm::vec2(glm::unpackSnorm1x16((uint16_t)vertex.normal[0]), glm::unpackSnorm1x16((uint16_t)vertex.normal[1])));
+		glm::vec2 uvUnit = glm::vec2(glm::unpackUnorm1x16(vertex.uv[0]), glm::unpackUnorm1x16(vertex.uv[1]));
+		glm::vec2 uv = uvUnit * quantization.uvScale + quantization.uvOffset;
+		return Vertex(position, normal, uv);
+	}
+
+	void measureQuantizationError(const MeshData& meshData, QuantizationError& error) {
+		VertexQuantization quantization = computeVertexQuantization(meshData.vertices);
+		for (size_t i = 0; i < meshData.vertices.size(); i++) {
+			const Vertex& vertex = meshData.vertices[i];
+			Vertex decoded = dequantizeVertex(quantizeVertex(vertex, quantization), quantization);
+			glm::vec3 positionError = glm::abs(decoded.position - vertex.position);
+			glm::vec2 uvError = glm::abs(decoded.uv - vertex.uv);
+			float cosine = glm::clamp(glm::dot(decoded.normal, glm::normalize(vertex.normal)), -1.f, 1.f);
+			error.position = glm::max(error.position, glm::max(positionError.x, glm::max(positionError.y, positionError.z)));
+			error.normal = glm::max(error.normal, glm::degrees(acosf(cosine)));
+			error.uv = glm::max(error.uv, glm::max(uvError.x, uvError.y));
+		}
+	}
+
+	Bounds computeBounds(const std::vector<Vertex>& vertices) {
+		Bounds bounds;
+		if (vertices.empty()) {
+			return bounds;
+		}
+
+		bounds.min = bounds.max = vertices[0].position;
+		for (size_t i = 1; i < vertices.size(); i++) {
+			bounds.min = glm::min(bounds.min, vertices[i].position);
+			bounds.max = glm::max(bounds.max, vertices[i].position);
+		}
+
+		bounds.center = (bounds.min + bounds.max) * .5f;
+		float radiusSq = 0.f;
+		for (size_t i = 0; i < vertices.size(); i++) {
+			glm::vec3 offset = vertices[i].position - bounds.center;
+			radiusSq = glm::max(radiusSq, glm::dot(offset, offset));
+		}
+		bounds.radius = sqrtf(radiusSq);
+		return bounds;
+	}
+
+	//16 bit units an index range takes, even so every range starts 4 byte aligned
+	static GLsizei indexUnits(GLsizei numIndices, GLenum indexType) {
+		return indexType == GL_UNSIGNED_SHORT ? (numIndices + 1) & ~1 : numIndices * 2;
+	}
+
+	static GLsizei indexUnitSize(GLenum indexType) {
+		return indexType == GL_UNSIGNED_SHORT ? 1 : 2;
+	}
+
+	static size_t indexBytes(GLenum indexType) {
+		return indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int);
+	}
+
+	//Attribute formats of QuantizedVertex, shared by the full and instanced vertex arrays
+	static void setQuantizedVertexAttributes(GLuint vbo) {
+		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+
+		glVertexAttribPointer(0, 3, GL_SHORT, GL_TRUE, sizeof(QuantizedVertex), (const void*)(offsetof(QuantizedVertex, position)));
+		glEnableVertexAttribArray(0);
+
+		glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(QuantizedVertex), (const void*)(offsetof(QuantizedVertex, normal)));
+		glEnableVertexAttribArray(1);
+
+		glVertexAttribPointer(2, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(QuantizedVertex), (const void*)(offsetof(QuantizedVertex, uv)));
+		glEnableVertexAttribArray(2);
+	}
+
+	MeshPool::MeshPool(GLsizei maxVertices, GLsizei maxIndices, bool splitPositions) {
+		//Immutable storage, meshes are written into it with glNamedBufferSubData
+		glCreateBuffers(1, &mVBO);
+		glNamedBufferStorage(mVBO, maxVertices * sizeof(QuantizedVertex), nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+		//Copy of just the positions, so depth passes don't pull normals and uvs through the cache. snorm16, padded to 8 bytes.
+		if (splitPositions) {
+			glCreateBuffers(1, &mPositionVBO);
+			glNamedBufferStorage(mPositionVBO, maxVertices * sizeof(int16_t) * 4, nullptr, GL_DYNAMIC_STORAGE_BIT);
+		}
+
+		//Lightmap uvs live in their own buffer so meshes without them keep the same vertex layout, unorm16 like the other uvs
+		glCreateBuffers(1, &mLightmapVBO);
+		glNamedBufferStorage(mLightmapVBO, maxVertices * sizeof(uint16_t) * 2, nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+		//Sized for maxIndices 32 bit indices, 16 bit meshes fit twice as many
+		glCreateBuffers(1, &mEBO);
+		glNamedBufferStorage(mEBO, maxIndices * sizeof(unsigned int), nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+		glCreateBuffers(1, &mInstanceVBO);
 
 		glGenVertexArrays(1, &mVAO);
 		glBindVertexArray(mVAO);
 
-		glGenBuffers(1, &mVBO);
-		glBindBuffer(GL_ARRAY_BUFFER, mVBO);
-		glBufferData(GL_ARRAY_BUFFER, meshData->vertices.size() * sizeof(Vertex), &meshData->vertices[0], GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO);
+		setQuantizedVertexAttributes(mVBO);
+
+		glBindBuffer(GL_ARRAY_BUFFER, mLightmapVBO);
+		glVertexAttribPointer(3, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(uint16_t) * 2, (const void*)0);
+		glEnableVertexAttribArray(3);
+
+		glGenVertexArrays(1, &mDepthVAO);
+		glBindVertexArray(mDepthVAO);
 
-		glGenBuffers(1, &mEBO);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, meshData->indices.size() * sizeof(unsigned int), &meshData->indices[0], GL_STATIC_DRAW);
 
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)(offsetof(Vertex, position)));
+		//Without the copy, depth passes read the positions out of the full vertices
+		if (mPositionVBO != 0) {
+			glBindBuffer(GL_ARRAY_BUFFER, mPositionVBO);
+			glVertexAttribPointer(0, 3, GL_SHORT, GL_TRUE, sizeof(int16_t) * 4, (const void*)0);
+		}
+		else {
+			glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+			glVertexAttribPointer(0, 3, GL_SHORT, GL_TRUE, sizeof(QuantizedVertex), (const void*)(offsetof(QuantizedVertex, position)));
+		}
 		glEnableVertexAttribArray(0);
 
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)(offsetof(Vertex, normal)));
-		glEnableVertexAttribArray(1);
+		//Same vertex streams as mVAO, plus the instance buffer advancing once per instance
+		glGenVertexArrays(1, &mInstancedVAO);
+		glBindVertexArray(mInstancedVAO);
 
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)(offsetof(Vertex, uv)));
-		glEnableVertexAttribArray(2);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO);
+		setQuantizedVertexAttributes(mVBO);
 
-		mNumIndices = (GLsizei)meshData->indices.size();
-		mNumVertices = (GLsizei)meshData->vertices.size();
+		glBindBuffer(GL_ARRAY_BUFFER, mInstanceVBO);
+
+		//A mat4 attribute takes 4 locations, one per column
+		for (int column = 0; column < 4; column++) {
+			glVertexAttribPointer(4 + column, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (const void*)(offsetof(InstanceData, model) + sizeof(glm::vec4) * column));
+			glEnableVertexAttribArray(4 + column);
+			glVertexAttribDivisor(4 + column, 1);
+		}
+
+		glVertexAttribPointer(8, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (const void*)(offsetof(InstanceData, color)));
+		glEnableVertexAttribArray(8);
+		glVertexAttribDivisor(8, 1);
+
+		glBindVertexArray(0);
+
+		mFreeVertices.push_back({ 0, maxVertices });
+		mFreeIndices.push_back({ 0, maxIndices * 2 });
 	}
 
-	Mesh::~Mesh()
+	MeshPool::~MeshPool()
 	{
 		glDeleteVertexArrays(1, &mVAO);
+		glDeleteVertexArrays(1, &mDepthVAO);
+		glDeleteVertexArrays(1, &mInstancedVAO);
 		glDeleteBuffers(1, &mVBO);
+		if (mPositionVBO != 0) {
+			glDeleteBuffers(1, &mPositionVBO);
+		}
+		glDeleteBuffers(1, &mLightmapVBO);
 		glDeleteBuffers(1, &mEBO);
+		glDeleteBuffers(1, &mInstanceVBO);
 	}
 
-	void Mesh::draw()
+	bool MeshPool::takeRange(std::vector<Range>& freeRanges, GLsizei size, GLsizei& offset)
+	{
+		//First fit, meshes are few and mostly live as long as the pool
+		for (size_t i = 0; i < freeRanges.size(); i++) {
+			if (freeRanges[i].size >= size) {
+				offset = freeRanges[i].offset;
+				freeRanges[i].offset += size;
+				freeRanges[i].size -= size;
+				if (freeRanges[i].size == 0) {
+					freeRanges.erase(freeRanges.begin() + i);
+				}
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void MeshPool::returnRange(std::vector<Range>& freeRanges, GLsizei offset, GLsizei size)
+	{
+		//Kept sorted by offset so neighbours can merge back together
+		size_t i = 0;
+		while (i < freeRanges.size() && freeRanges[i].offset < offset) {
+			i++;
+		}
+		freeRanges.insert(freeRanges.begin() + i, { offset, size });
+
+		if (i + 1 < freeRanges.size() && freeRanges[i].offset + freeRanges[i].size == freeRanges[i + 1].offset) {
+			freeRanges[i].size += freeRanges[i + 1].size;
+			freeRanges.erase(freeRanges.begin() + i + 1);
+		}
+		if (i > 0 && freeRanges[i - 1].offset + freeRanges[i - 1].size == freeRanges[i].offset) {
+			freeRanges[i - 1].size += freeRanges[i].size;
+			freeRanges.erase(freeRanges.begin() + i);
+		}
+	}
+
+	bool MeshPool::allocate(const MeshData* meshData, GLint& baseVertex, GLsizei& firstIndex, GLenum& indexType, VertexQuantization& quantization)
+	{
+		GLsizei numVertices = (GLsizei)meshData->vertices.size();
+		GLsizei numIndices = (GLsizei)meshData->indices.size();
+
+		//Indices are relative to the base vertex, so only the mesh's own vertex count decides the width
+		indexType = numVertices <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+		GLsizei units = indexUnits(numIndices, indexType);
+
+		GLsizei vertexOffset, unitOffset;
+		if (!takeRange(mFreeVertices, numVertices, vertexOffset)) {
+			return false;
+		}
+		if (!takeRange(mFreeIndices, units, unitOffset)) {
+			returnRange(mFreeVertices, vertexOffset, numVertices);
+			return false;
+		}
+
+		quantization = computeVertexQuantization(meshData->vertices);
+
+		std::vector<QuantizedVertex> vertices(numVertices);
+		std::vector<int16_t> positions(numVertices * 4);
+		for (GLsizei i = 0; i < numVertices; i++) {
+			vertices[i] = quantizeVertex(meshData->vertices[i], quantization);
+			for (int c = 0; c < 4; c++) {
+				positions[i * 4 + c] = vertices[i].position[c];
+			}
+		}
+		glNamedBufferSubData(mVBO, vertexOffset * sizeof(QuantizedVertex), numVertices * sizeof(QuantizedVertex), &vertices[0]);
+		if (mPositionVBO != 0) {
+			glNamedBufferSubData(mPositionVBO, vertexOffset * sizeof(int16_t) * 4, numVertices * sizeof(int16_t) * 4, &positions[0]);
+		}
+
+		if (indexType == GL_UNSIGNED_SHORT) {
+			std::vector<uint16_t> indices(meshData->indices.begin(), meshData->indices.end());
+			glNamedBufferSubData(mEBO, unitOffset * sizeof(uint16_t), numIndices * sizeof(uint16_t), &indices[0]);
+		}
+		else {
+			glNamedBufferSubData(mEBO, unitOffset * sizeof(uint16_t), numIndices * sizeof(unsigned int), &meshData->indices[0]);
+		}
+
+		//Meshes without lightmap uvs still get a defined range, the shader just doesn't use it
+		std::vector<uint16_t> lightmapUVs(numVertices * 2, 0);
+		if (meshData->lightmapUVs.size() == meshData->vertices.size()) {
+			for (GLsizei i = 0; i < numVertices; i++) {
+				lightmapUVs[i * 2] = glm::packUnorm1x16(meshData->lightmapUVs[i].x);
+				lightmapUVs[i * 2 + 1] = glm::packUnorm1x16(meshData->lightmapUVs[i].y);
+			}
+		}
+		glNamedBufferSubData(mLightmapVBO, vertexOffset * sizeof(uint16_t) * 2, numVertices * sizeof(uint16_t) * 2, &lightmapUVs[0]);
+
+		mUsedVertices += numVertices;
+		mUsedIndices += numIndices;
+		mUsedIndexUnits += units;
+
+		baseVertex = vertexOffset;
+		firstIndex = unitOffset / indexUnitSize(indexType);
+		return true;
+	}
+
+	void MeshPool::release(GLint baseVertex, GLsizei numVertices, GLsizei firstIndex, GLsizei numIndices, GLenum indexType)
+	{
+		GLsizei units = indexUnits(numIndices, indexType);
+		returnRange(mFreeVertices, baseVertex, numVertices);
+		returnRange(mFreeIndices, firstIndex * indexUnitSize(indexType), units);
+		mUsedVertices -= numVertices;
+		mUsedIndices -= numIndices;
+		mUsedIndexUnits -= units;
+	}
+
+	size_t MeshPool::getUsedBytes() const
+	{
+		//Full vertex, depth-only position and lightmap uv streams
+		size_t positionBytes = mPositionVBO != 0 ? sizeof(int16_t) * 4 : 0;
+		return mUsedVertices * (sizeof(QuantizedVertex) + positionBytes + sizeof(uint16_t) * 2) + mUsedIndexUnits * sizeof(uint16_t);
+	}
+
+	size_t MeshPool::getDepthVertexBytes() const
+	{
+		//Without the copy the positions are spread through the full vertices, so every cache line fetched carries all of them
+		return mPositionVBO != 0 ? sizeof(int16_t) * 4 : sizeof(QuantizedVertex);
+	}
+
+	size_t MeshPool::getFullVertexBytes() const
+	{
+		return sizeof(QuantizedVertex) + sizeof(uint16_t) * 2;
+	}
+
+	size_t MeshPool::getUnquantizedBytes() const
+	{
+		return mUsedVertices * (sizeof(Vertex) + sizeof(glm::vec3) + sizeof(glm::vec2)) + mUsedIndices * sizeof(unsigned int);
+	}
+
+	void MeshPool::bindVertexArray()
 	{
 		glBindVertexArray(mVAO);
-		glDrawElements(GL_TRIANGLES, mNumIndices, GL_UNSIGNED_INT, 0);
+	}
+
+	void MeshPool::bindDepthVertexArray()
+	{
+		glBindVertexArray(mDepthVAO);
+	}
+
+	void MeshPool::bindInstances(const std::vector<InstanceData>& instances)
+	{
+		//Reallocate when it has to grow, otherwise orphan the old contents so the upload doesn't wait on last frame's draw
+		GLsizeiptr size = (GLsizeiptr)(instances.size() * sizeof(InstanceData));
+		if (size > mInstanceCapacity) {
+			mInstanceCapacity = size;
+		}
+		glNamedBufferData(mInstanceVBO, mInstanceCapacity, nullptr, GL_STREAM_DRAW);
+		glNamedBufferSubData(mInstanceVBO, 0, size, &instances[0]);
+
+		glBindVertexArray(mInstancedVAO);
+	}
+
+	Mesh::Mesh(MeshPool* pool, MeshData* meshData) {
+		if (meshData->vertices.empty() || meshData->indices.empty()) {
+			return;
+		}
+
+		if (!pool->allocate(meshData, mBaseVertex, mFirstIndex, mIndexType, mVertexQuantization)) {
+			printf("Mesh pool is out of space for %zu vertices and %zu indices\n", meshData->vertices.size(), meshData->indices.size());
+			return;
+		}
+
+		mPool = pool;
+		mNumIndices = (GLsizei)meshData->indices.size();
+		mNumVertices = (GLsizei)meshData->vertices.size();
+		mBounds = meshData->bounds;
+	}
+
+	Mesh::~Mesh()
+	{
+		releaseRange();
+	}
+
+	Mesh::Mesh(Mesh&& other) noexcept
+		: mPool(other.mPool), mIndexType(other.mIndexType), mBaseVertex(other.mBaseVertex), mFirstIndex(other.mFirstIndex), mNumIndices(other.mNumIndices), mNumVertices(other.mNumVertices), mBounds(other.mBounds), mVertexQuantization(other.mVertexQuantization) {
+		other.mPool = nullptr;
+		other.mNumIndices = 0;
+		other.mNumVertices = 0;
+	}
+
+	Mesh& Mesh::operator=(Mesh&& other) noexcept
+	{
+		if (this != &other) {
+			releaseRange();
+			mPool = other.mPool;
+			mIndexType = other.mIndexType;
+			mBaseVertex = other.mBaseVertex;
+			mFirstIndex = other.mFirstIndex;
+			mNumIndices = other.mNumIndices;
+			mNumVertices = other.mNumVertices;
+			mBounds = other.mBounds;
+			mVertexQuantization = other.mVertexQuantization;
+			other.mPool = nullptr;
+			other.mNumIndices = 0;
+			other.mNumVertices = 0;
+		}
+		return *this;
+	}
+
+	void Mesh::releaseRange()
+	{
+		if (mPool != nullptr) {
+			mPool->release(mBaseVertex, mNumVertices, mFirstIndex, mNumIndices, mIndexType);
+			mPool = nullptr;
+		}
+	}
+
+	void Mesh::bindVertexQuantization()
+	{
+		//Current generic attribute values aren't vertex array state, so they carry over into whichever one is bound
+		const VertexQuantization& q = mVertexQuantization;
+		glVertexAttrib4f(POSITION_SCALE_ATTRIBUTE, q.positionScale.x, q.positionScale.y, q.positionScale.z, 0.f);
+		glVertexAttrib4f(POSITION_OFFSET_ATTRIBUTE, q.positionOffset.x, q.positionOffset.y, q.positionOffset.z, 0.f);
+		glVertexAttrib4f(UV_QUANTIZATION_ATTRIBUTE, q.uvScale.x, q.uvScale.y, q.uvOffset.x, q.uvOffset.y);
+	}
+
+	void Mesh::draw()
+	{
+		if (mPool == nullptr) {
+			return;
+		}
+		bindVertexQuantization();
+		glDrawElementsBaseVertex(GL_TRIANGLES, mNumIndices, mIndexType, (void*)(mFirstIndex * indexBytes(mIndexType)), mBaseVertex);
+	}
+
+	void Mesh::drawDepthOnly()
+	{
+		if (mPool == nullptr) {
+			return;
+		}
+		bindVertexQuantization();
+		glDrawElementsBaseVertex(GL_TRIANGLES, mNumIndices, mIndexType, (void*)(mFirstIndex * indexBytes(mIndexType)), mBaseVertex);
+	}
+
+	void Mesh::drawInstanced(GLsizei instanceCount)
+	{
+		if (mPool == nullptr) {
+			return;
+		}
+		mPool->bindVertexArray();
+		bindVertexQuantization();
+		glDrawElementsInstancedBaseVertex(GL_TRIANGLES, mNumIndices, mIndexType, (const void*)(mFirstIndex * indexBytes(mIndexType)), instanceCount, mBaseVertex);
+	}
+
+	void Mesh::drawInstanced(const std::vector<InstanceData>& instances)
+	{
+		if (mPool == nullptr || instances.empty()) {
+			return;
+		}
+		mPool->bindInstances(instances);
+		bindVertexQuantization();
+		glDrawElementsInstancedBaseVertex(GL_TRIANGLES, mNumIndices, mIndexType, (const void*)(mFirstIndex * indexBytes(mIndexType)), (GLsizei)instances.size(), mBaseVertex);
 	}
 
 }
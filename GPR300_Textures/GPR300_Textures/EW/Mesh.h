@@ -4,35 +4,190 @@
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 #include <vector>
+#include <cstdint>
 
 namespace ew {
 	struct Vertex {
 		glm::vec3 position;
 		glm::vec3 normal;
 		glm::vec2 uv;
+		//Left uninitialized, so generators can size their arrays up front and fill them in without clearing them first
+		Vertex() {}
 		Vertex(glm::vec3 position, glm::vec3 normal, glm::vec2 uv)
 			: position(position), normal(normal), uv(uv) {};
 	};
 
+	/// <summary>
+	/// Local space extents, an axis aligned box and a sphere around the mesh
+	/// </summary>
+	struct Bounds {
+		glm::vec3 min = glm::vec3(0);
+		glm::vec3 max = glm::vec3(0);
+		glm::vec3 center = glm::vec3(0);
+		float radius = 0.f;
+	};
+
+	//Box around the vertices and the sphere around its center, for meshes whose extents aren't known up front
+	Bounds computeBounds(const std::vector<Vertex>& vertices);
+
 	/// <summary>
 	/// Just holds a bunch of vertex + face (indices) data
 	/// </summary>
 	struct MeshData {
 		std::vector<Vertex> vertices;
 		std::vector<unsigned int> indices;
+		//Optional second uv set for lightmaps, one per vertex when filled in
+		std::vector<glm::vec2> lightmapUVs;
+		//Filled in by the shape generators and importers
+		Bounds bounds;
+	};
+
+	/// <summary>
+	/// What a Vertex becomes on the GPU, 16 bytes instead of 32.
+	/// snorm16 position inside the mesh's box, octahedral normal in two snorm16 and unorm16 uvs inside the mesh's uv range.
+	/// </summary>
+	struct QuantizedVertex {
+		int16_t position[4];	//w is padding
+		int16_t normal[2];
+		uint16_t uv[2];
+	};
+
+	/// <summary>
+	/// Maps a mesh's box onto -1 to 1 for its snorm16 positions, and its uv range onto 0-1 for its unorm16 uvs.
+	/// The vertex shaders undo both with value * scale + offset.
+	/// </summary>
+	struct VertexQuantization {
+		glm::vec3 positionScale = glm::vec3(1);
+		glm::vec3 positionOffset = glm::vec3(0);
+		glm::vec2 uvScale = glm::vec2(1);
+		glm::vec2 uvOffset = glm::vec2(0);
+	};
+
+	//Generic attributes every vertex shader reads the current mesh's VertexQuantization from, no array is ever bound to them.
+	//The uv one holds the scale in xy and the offset in zw.
+	const GLuint POSITION_SCALE_ATTRIBUTE = 9;
+	const GLuint POSITION_OFFSET_ATTRIBUTE = 10;
+	const GLuint UV_QUANTIZATION_ATTRIBUTE = 11;
+
+	//Box around the positions and the uvs, so precision follows the mesh's size wherever it sits, and tiled or
+	//negative uvs like the sphere's survive
+	VertexQuantization computeVertexQuantization(const std::vector<Vertex>& vertices);
+
+	//Folds a unit vector onto the octahedron and unfolds it onto a square, both components in -1 to 1
+	glm::vec2 encodeOctahedral(glm::vec3 normal);
+	glm::vec3 decodeOctahedral(glm::vec2 encoded);
+
+	QuantizedVertex quantizeVertex(const Vertex& vertex, const VertexQuantization& quantization);
+	//Exactly what the vertex shader reads back, for measuring the error
+	Vertex dequantizeVertex(const QuantizedVertex& vertex, const VertexQuantization& quantization);
+
+	/// <summary>
+	/// Largest round trip error of quantizing some meshes. Normals in degrees.
+	/// </summary>
+	struct QuantizationError {
+		float position = 0.f;
+		float normal = 0.f;
+		float uv = 0.f;
+	};
+
+	//Quantizes meshData the way MeshPool does and grows error to cover it. A standalone check, uploads don't pay for it.
+	void measureQuantizationError(const MeshData& meshData, QuantizationError& error);
+
+	/// <summary>
+	/// Per-instance attributes for instanced draws, the model matrix streams to locations 4-7 and the color to 8
+	/// </summary>
+	struct InstanceData {
+		glm::mat4 model;
+		glm::vec4 color;
 	};
 
+	class Mesh;
+
 	/// <summary>
-	/// Holds OpenGL buffers, can be drawn
+	/// One immutable vertex buffer and index buffer shared by every mesh, with a single VAO to draw them all through.
+	/// Meshes are ranges in it and draw with a base vertex, so switching between them binds nothing new.
+	/// Vertices are stored as QuantizedVertex, and indices are 16 bit for any mesh with few enough vertices.
+	/// </summary>
+	class MeshPool {
+	public:
+		//splitPositions keeps a second, position only copy of the vertices that depth passes read instead of the full vertex
+		MeshPool(GLsizei maxVertices, GLsizei maxIndices, bool splitPositions = true);
+		~MeshPool();
+		MeshPool(const MeshPool&) = delete;
+		MeshPool& operator=(const MeshPool&) = delete;
+
+		//Quantizes meshData into free ranges of the buffers, false when there is no room left.
+		//firstIndex counts in indexType, which is GL_UNSIGNED_SHORT or GL_UNSIGNED_INT.
+		bool allocate(const MeshData* meshData, GLint& baseVertex, GLsizei& firstIndex, GLenum& indexType, VertexQuantization& quantization);
+		void release(GLint baseVertex, GLsizei numVertices, GLsizei firstIndex, GLsizei numIndices, GLenum indexType);
+
+		void bindVertexArray();
+		void bindDepthVertexArray();
+		//Uploads instances and binds the vertex array that streams them
+		void bindInstances(const std::vector<InstanceData>& instances);
+
+		GLsizei getUsedVertices() const { return mUsedVertices; }
+		GLsizei getUsedIndices() const { return mUsedIndices; }
+		//Bytes the used ranges take up, against what float vertices and 32 bit indices would
+		size_t getUsedBytes() const;
+		size_t getUnquantizedBytes() const;
+		//Bytes of vertex data a depth only draw reads per vertex, against a full draw
+		size_t getDepthVertexBytes() const;
+		size_t getFullVertexBytes() const;
+		bool hasSplitPositions() const { return mPositionVBO != 0; }
+	private:
+		struct Range {
+			GLsizei offset;
+			GLsizei size;
+		};
+		static bool takeRange(std::vector<Range>& freeRanges, GLsizei size, GLsizei& offset);
+		static void returnRange(std::vector<Range>& freeRanges, GLsizei offset, GLsizei size);
+
+		GLuint mVAO, mDepthVAO, mInstancedVAO;
+		GLuint mVBO, mPositionVBO = 0, mLightmapVBO, mEBO, mInstanceVBO;
+		GLsizeiptr mInstanceCapacity = 0;
+		std::vector<Range> mFreeVertices, mFreeIndices;
+		GLsizei mUsedVertices = 0, mUsedIndices = 0;
+		//Index space is counted in 16 bit units, 32 bit meshes take two each. Ranges are kept even so they stay 4 byte aligned.
+		GLsizei mUsedIndexUnits = 0;
+	};
+
+	/// <summary>
+	/// Handle to a range of a MeshPool, can be drawn. Move only, the range goes back to the pool when it is destroyed.
 	/// </summary>
 	class Mesh {
 	public:
-		Mesh(MeshData* meshData);
+		Mesh(MeshPool* pool, MeshData* meshData);
 		~Mesh();
+		Mesh(const Mesh&) = delete;
+		Mesh& operator=(const Mesh&) = delete;
+		Mesh(Mesh&& other) noexcept;
+		Mesh& operator=(Mesh&& other) noexcept;
+		//Draws through whichever pool vertex array is bound, callers bind it once per pass with MeshPool::bindVertexArray
 		void draw();
+		void drawInstanced(GLsizei instanceCount);
+		//Uploads instances and draws every one of them in a single call
+		void drawInstanced(const std::vector<InstanceData>& instances);
+		//Only streams positions, for depth passes. Expects MeshPool::bindDepthVertexArray instead.
+		void drawDepthOnly();
+
+		GLint getBaseVertex() const { return mBaseVertex; }
+		GLsizei getFirstIndex() const { return mFirstIndex; }
+		GLsizei getNumIndices() const { return mNumIndices; }
+		GLenum getIndexType() const { return mIndexType; }
+		const Bounds& getBounds() const { return mBounds; }
+		const VertexQuantization& getVertexQuantization() const { return mVertexQuantization; }
 	private:
-		GLuint mVAO, mVBO, mEBO;
-		GLsizei mNumIndices;
-		GLsizei mNumVertices;
+		MeshPool* mPool = nullptr;
+		GLenum mIndexType = GL_UNSIGNED_INT;
+		GLint mBaseVertex = 0;
+		GLsizei mFirstIndex = 0;
+		GLsizei mNumIndices = 0;
+		GLsizei mNumVertices = 0;
+		Bounds mBounds;
+		VertexQuantization mVertexQuantization;
+		void releaseRange();
+		//Sets the generic attributes the vertex shaders dequantize positions and uvs with
+		void bindVertexQuantization();
 	};
 }
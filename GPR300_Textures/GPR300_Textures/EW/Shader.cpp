@@ -3,6 +3,7 @@
 #include "Shader.h"
 #include <fstream>
 #include <sstream>
+#include <cstring>
 
 #include <glm/vec3.hpp> // glm::vec3
 #include <glm/vec4.hpp> // glm::vec4
@@ -10,67 +11,235 @@
 #include <glm/ext/matrix_transform.hpp> // glm::translate, glm::rotate, glm::scale
 #include <glm/gtc/type_ptr.hpp>
 
-Shader::Shader(std::string vertexShaderPath, std::string fragmentShaderPath)
+GLuint Shader::s_fallbackId = 0;
+UniformStats Shader::s_frameStats;
+UniformStats Shader::s_lastFrameStats;
+
+Shader::Shader(std::string vertexShaderPath, std::string fragmentShaderPath, bool async, std::string defines)
+	: m_vertexPath(vertexShaderPath), m_fragmentPath(fragmentShaderPath), m_defines(defines)
+{
+	beginCompile();
+
+	if (!async) {
+		finishCompile();
+	}
+}
+
+Shader::~Shader()
+{
+	if (m_pendingId != 0) {
+		glDeleteShader(m_pendingVertex);
+		glDeleteShader(m_pendingFragment);
+		glDeleteProgram(m_pendingId);
+	}
+	glDeleteProgram(m_id);
+}
+
+void Shader::reload()
+{
+	//Throw away an in flight compile, the files changed again since it started
+	if (m_pendingId != 0) {
+		glDeleteShader(m_pendingVertex);
+		glDeleteShader(m_pendingFragment);
+		glDeleteProgram(m_pendingId);
+		m_pendingId = 0;
+	}
+	beginCompile();
+}
+
+bool Shader::poll()
+{
+	if (m_pendingId == 0) {
+		return false;
+	}
+
+	//Without KHR_parallel_shader_compile the status query below blocks until the driver is done
+	if (GLEW_KHR_parallel_shader_compile) {
+		GLint complete = GL_FALSE;
+		glGetProgramiv(m_pendingId, GL_COMPLETION_STATUS_KHR, &complete);
+		if (!complete) {
+			return false;
+		}
+	}
+
+	GLuint previous = m_id;
+	finishCompile();
+	return m_id != previous;
+}
+
+void Shader::beginCompile()
 {
-	std::string vertexShaderString = readFile(vertexShaderPath);
-	GLuint vertexShader = compileShader(vertexShaderString.c_str(), GL_VERTEX_SHADER);
+	std::string vertexShaderString = insertDefines(readFile(m_vertexPath));
+	m_pendingVertex = compileShader(vertexShaderString.c_str(), GL_VERTEX_SHADER);
 
-	std::string fragmentShaderString = readFile(fragmentShaderPath);
-	GLuint fragmentShader = compileShader(fragmentShaderString.c_str(), GL_FRAGMENT_SHADER);
+	std::string fragmentShaderString = insertDefines(readFile(m_fragmentPath));
+	m_pendingFragment = compileShader(fragmentShaderString.c_str(), GL_FRAGMENT_SHADER);
 
 	//Create an empty shader program
-	m_id = glCreateProgram();
+	m_pendingId = glCreateProgram();
 
 	//Attach our shader objects
-	glAttachShader(m_id, vertexShader);
-	glAttachShader(m_id, fragmentShader);
+	glAttachShader(m_pendingId, m_pendingVertex);
+	glAttachShader(m_pendingId, m_pendingFragment);
 
 	//Link program - will create an executable program with the attached shaders
-	glLinkProgram(m_id);
+	//Compile status is not queried until finishCompile so the driver can work on it in the background
+	glLinkProgram(m_pendingId);
+}
 
+void Shader::finishCompile()
+{
 	//Logging
 	int success;
-	glGetProgramiv(m_id, GL_LINK_STATUS, &success);
+	glGetProgramiv(m_pendingId, GL_LINK_STATUS, &success);
 	if (!success) {
+		m_lastError = getShaderLog(m_pendingVertex) + getShaderLog(m_pendingFragment) + getProgramLog(m_pendingId);
+		printf("Failed to link shader program (%s, %s): %s\n", m_vertexPath.c_str(), m_fragmentPath.c_str(), m_lastError.c_str());
 
-		GLchar infoLog[512];
-		glGetProgramInfoLog(m_id, 512, NULL, infoLog);
-		printf("Failed to link shader program: %s", infoLog);
+		//Keep drawing with whatever program we had before
+		glDeleteProgram(m_pendingId);
 	}
+	else {
+		m_lastError.clear();
+		glDeleteProgram(m_id);
+		m_id = m_pendingId;
 
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShader);
+		//The new program starts from default values, so the old shadow is useless
+		reflectUniforms();
+	}
+
+	glDeleteShader(m_pendingVertex);
+	glDeleteShader(m_pendingFragment);
+	m_pendingId = 0;
+	m_pendingVertex = 0;
+	m_pendingFragment = 0;
 }
 
 void Shader::use()
 {
-	glUseProgram(m_id);
+	glUseProgram(getProgram());
 }
 
-void Shader::setFloat(std::string name, float value)
+void Shader::setFloat(const std::string& name, float value)
 {
-	glProgramUniform1f(m_id, glGetUniformLocation(m_id, name.c_str()), value);
+	GLint location = updateShadow(name, &value, sizeof(value));
+	if (location != -1) {
+		glProgramUniform1f(getProgram(), location, value);
+	}
 }
 
-void Shader::setInt(std::string name, int value)
+void Shader::setInt(const std::string& name, int value)
 {
-	glProgramUniform1i(m_id, glGetUniformLocation(m_id, name.c_str()), value);
+	GLint location = updateShadow(name, &value, sizeof(value));
+	if (location != -1) {
+		glProgramUniform1i(getProgram(), location, value);
+	}
 }
 
-void Shader::setMat4(std::string name, const glm::mat4& value) { 
-	glProgramUniformMatrix4fv(m_id, glGetUniformLocation(m_id, name.c_str()), 1, false, glm::value_ptr(value));
+void Shader::setMat4(const std::string& name, const glm::mat4& value) { 
+	GLint location = updateShadow(name, glm::value_ptr(value), sizeof(value));
+	if (location != -1) {
+		glProgramUniformMatrix4fv(getProgram(), location, 1, false, glm::value_ptr(value));
+	}
 }
 
-void Shader::setVec3(std::string name, const glm::vec3& value)
+void Shader::setVec3(const std::string& name, const glm::vec3& value)
 {
-	glProgramUniform3f(m_id, glGetUniformLocation(m_id, name.c_str()), value.x, value.y, value.z);
+	GLint location = updateShadow(name, glm::value_ptr(value), sizeof(value));
+	if (location != -1) {
+		glProgramUniform3f(getProgram(), location, value.x, value.y, value.z);
+	}
 }
 
-void Shader::setVec2(std::string name, const glm::vec2& value)
+void Shader::setVec4(const std::string& name, const glm::vec4& value)
 {
-	glProgramUniform2f(m_id, glGetUniformLocation(m_id, name.c_str()), value.x, value.y);
+	GLint location = updateShadow(name, glm::value_ptr(value), sizeof(value));
+	if (location != -1) {
+		glProgramUniform4f(getProgram(), location, value.x, value.y, value.z, value.w);
+	}
 }
 
+void Shader::setVec2(const std::string& name, const glm::vec2& value)
+{
+	GLint location = updateShadow(name, glm::value_ptr(value), sizeof(value));
+	if (location != -1) {
+		glProgramUniform2f(getProgram(), location, value.x, value.y);
+	}
+}
+
+void Shader::reflectUniforms()
+{
+	m_uniformLookup.clear();
+	m_uniforms.clear();
+
+	GLint uniformCount = 0;
+	glGetProgramiv(m_id, GL_ACTIVE_UNIFORMS, &uniformCount);
+	GLint maxNameLength = 0;
+	glGetProgramiv(m_id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+	std::vector<GLchar> nameBuffer(maxNameLength > 0 ? maxNameLength : 1);
+	for (GLint i = 0; i < uniformCount; i++) {
+		GLint arraySize = 0;
+		GLenum type;
+		glGetActiveUniform(m_id, (GLuint)i, (GLsizei)nameBuffer.size(), NULL, &arraySize, &type, &nameBuffer[0]);
+		std::string name = &nameBuffer[0];
+
+		//Arrays of basic types come back once as "name[0]", give every element its own shadow
+		std::string baseName = name;
+		bool isArray = name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0;
+		if (isArray) {
+			baseName = name.substr(0, name.size() - 3);
+		}
+
+		for (GLint element = 0; element < arraySize; element++) {
+			std::string elementName = isArray ? baseName + "[" + std::to_string(element) + "]" : name;
+
+			GLint location = glGetUniformLocation(m_id, elementName.c_str());
+			if (location == -1) {
+				//Uniform blocks and storage buffer members have no location
+				continue;
+			}
+
+			UniformShadow shadow;
+			shadow.location = location;
+			shadow.hasValue = false;
+			m_uniforms.push_back(shadow);
+			m_uniformLookup[elementName] = m_uniforms.size() - 1;
+
+			//glGetUniformLocation also accepts the array name alone for the first element
+			if (isArray && element == 0) {
+				m_uniformLookup[baseName] = m_uniforms.size() - 1;
+			}
+		}
+	}
+}
+
+GLint Shader::updateShadow(const std::string& name, const void* value, size_t size)
+{
+	//The fallback program is shared between shaders and never reflected
+	if (m_id == 0) {
+		s_frameStats.issued++;
+		return glGetUniformLocation(getProgram(), name.c_str());
+	}
+
+	std::unordered_map<std::string, size_t>::iterator found = m_uniformLookup.find(name);
+	if (found == m_uniformLookup.end()) {
+		//Not active in this program (optimized out or stripped by a permutation), GL would ignore it anyway
+		s_frameStats.skipped++;
+		return -1;
+	}
+
+	UniformShadow& shadow = m_uniforms[found->second];
+	if (shadow.hasValue && memcmp(shadow.value, value, size) == 0) {
+		s_frameStats.skipped++;
+		return -1;
+	}
+
+	memcpy(shadow.value, value, size);
+	shadow.hasValue = true;
+	s_frameStats.issued++;
+	return shadow.location;
+}
 
 std::string Shader::readFile(const std::string& filePath)
 {
@@ -85,6 +254,23 @@ std::string Shader::readFile(const std::string& filePath)
 	return stringStream.str();
 }
 
+std::string Shader::insertDefines(const std::string& source)
+{
+	if (m_defines.empty()) {
+		return source;
+	}
+
+	//#version has to stay the first statement, so the defines go on the line after it
+	size_t insertPos = 0;
+	size_t versionPos = source.find("#version");
+	if (versionPos != std::string::npos) {
+		size_t lineEnd = source.find('\n', versionPos);
+		insertPos = lineEnd == std::string::npos ? source.size() : lineEnd + 1;
+	}
+
+	return source.substr(0, insertPos) + m_defines + source.substr(insertPos);
+}
+
 GLuint Shader::compileShader(const char* shaderSource, GLenum shaderType)
 {
 	GLuint shader = glCreateShader(shaderType);
@@ -93,15 +279,35 @@ GLuint Shader::compileShader(const char* shaderSource, GLenum shaderType)
 	//Compiles the shader source
 	glCompileShader(shader);
 
-	//Get result of last compile - either GL_TRUE or GL_FALSE
+	//Compile status is checked once the program has linked, see finishCompile
+	return shader;
+}
+
+std::string Shader::getShaderLog(GLuint shader)
+{
 	GLint success;
 	glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-	if (!success) {
-		const char* shaderName = shaderType == GL_VERTEX_SHADER ? "VERTEX" : "FRAGMENT";
-		//Dump logs into a char array - 512 is an arbitrary length
-		GLchar infoLog[512];
-		glGetShaderInfoLog(shader, 512, NULL, infoLog);
-		printf("Failed to compile %s shader: %s", shaderName, infoLog);
+	if (success) {
+		return "";
 	}
-	return shader;
+
+	GLint shaderType;
+	glGetShaderiv(shader, GL_SHADER_TYPE, &shaderType);
+	const char* shaderName = shaderType == GL_VERTEX_SHADER ? "VERTEX" : "FRAGMENT";
+
+	//Size the log to whatever the driver reports instead of a fixed buffer
+	GLint logLength = 0;
+	glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
+	std::string infoLog(logLength > 0 ? logLength : 1, '\0');
+	glGetShaderInfoLog(shader, (GLsizei)infoLog.size(), NULL, &infoLog[0]);
+	return std::string("Failed to compile ") + shaderName + " shader: " + infoLog.c_str() + "\n";
+}
+
+std::string Shader::getProgramLog(GLuint program)
+{
+	GLint logLength = 0;
+	glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
+	std::string infoLog(logLength > 0 ? logLength : 1, '\0');
+	glGetProgramInfoLog(program, (GLsizei)infoLog.size(), NULL, &infoLog[0]);
+	return infoLog.c_str();
 }
@@ -4,21 +4,86 @@
 #include "GL/glew.h"
 #include <glm/glm.hpp>
 #include <string>
+#include <unordered_map>
+#include <vector>
+
+//Uniform uploads across every shader, see Shader::endUniformFrame
+struct UniformStats
+{
+	int issued = 0;
+	int skipped = 0;
+};
 
 class Shader
 {
 public:
-	Shader(std::string vertexShaderPath, std::string fragmentShaderPath);
+	//If async is true, compilation is only started here and finished by poll()
+	//defines is inserted after the #version line of both stages, one "#define NAME VALUE" per line
+	Shader(std::string vertexShaderPath, std::string fragmentShaderPath, bool async = false, std::string defines = "");
+	~Shader();
 	void use();
-	void setFloat(std::string name, float value);
-	void setInt(std::string name, int value);
-	void setMat4(std::string name, const glm::mat4& value);
-	void setVec2(std::string name, const glm::vec2& value);
-	void setVec3(std::string name, const glm::vec3& value);
+	//Setters compare against a CPU copy of the program's uniforms and skip the GL call when nothing changed
+	void setFloat(const std::string& name, float value);
+	void setInt(const std::string& name, int value);
+	void setMat4(const std::string& name, const glm::mat4& value);
+	void setVec2(const std::string& name, const glm::vec2& value);
+	void setVec3(const std::string& name, const glm::vec3& value);
+	void setVec4(const std::string& name, const glm::vec4& value);
+
+	//Re-reads both source files and starts compiling them. The current program stays in use until the new one links.
+	void reload();
+	//Finishes a pending compile if the driver is done with it. Returns true if a new program was swapped in.
+	bool poll();
+
+	inline bool isReady()const { return m_id != 0; }
+	inline bool isCompiling()const { return m_pendingId != 0; }
+	inline const std::string& getVertexPath()const { return m_vertexPath; }
+	inline const std::string& getFragmentPath()const { return m_fragmentPath; }
+	inline const std::string& getDefines()const { return m_defines; }
+	inline const std::string& getLastError()const { return m_lastError; }
+	//Program that is actually bound, which is the fallback program until the first successful link
+	inline GLuint getProgram()const { return m_id != 0 ? m_id : s_fallbackId; }
+
+	static void setFallbackProgram(GLuint id) { s_fallbackId = id; }
+
+	//Call once per frame, moves this frame's upload counts into getLastFrameUniformStats
+	static void endUniformFrame() { s_lastFrameStats = s_frameStats; s_frameStats = UniformStats(); }
+	static const UniformStats& getLastFrameUniformStats() { return s_lastFrameStats; }
 private:
+	//CPU copy of one uniform, large enough for a mat4
+	struct UniformShadow {
+		GLint location;
+		bool hasValue;
+		unsigned char value[sizeof(glm::mat4)];
+	};
+
 	Shader(const Shader& r) = delete;
 	std::string readFile(const std::string& filePath);
 	GLuint compileShader(const char* shaderSource, GLenum type);
-	GLuint m_id;
+	std::string insertDefines(const std::string& source);
+	void beginCompile();
+	void finishCompile();
+	std::string getShaderLog(GLuint shader);
+	std::string getProgramLog(GLuint program);
+	void reflectUniforms();
+	//Returns the location to upload to, or -1 if the uniform does not exist or already holds this value
+	GLint updateShadow(const std::string& name, const void* value, size_t size);
+
+	std::string m_vertexPath;
+	std::string m_fragmentPath;
+	std::string m_defines;
+	std::string m_lastError;
+
+	GLuint m_id = 0;
+	GLuint m_pendingId = 0;
+	GLuint m_pendingVertex = 0;
+	GLuint m_pendingFragment = 0;
+
+	std::unordered_map<std::string, size_t> m_uniformLookup;
+	std::vector<UniformShadow> m_uniforms;
+
+	static GLuint s_fallbackId;
+	static UniformStats s_frameStats;
+	static UniformStats s_lastFrameStats;
 };
 
@@ -1,9 +1,23 @@
 //Author: Eric Winebrenner
 
 #include "ShapeGen.h"
+#include "ThreadPool.h"
 #include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <math.h>
+#include <vector>
 
 namespace ew {
+	//Every shape here is centered on the origin, so its box is symmetric and the sphere reaches the box's corners
+	static Bounds centeredBounds(glm::vec3 halfExtents, float radius) {
+		Bounds bounds;
+		bounds.min = -halfExtents;
+		bounds.max = halfExtents;
+		bounds.center = glm::vec3(0);
+		bounds.radius = radius;
+		return bounds;
+	}
+
 	void createPlane(float width, float height, MeshData& meshData) {
 		meshData.vertices.clear();
 		meshData.indices.clear();
@@ -23,6 +37,7 @@ namespace ew {
 			0, 3, 2
 		};
 		meshData.indices.assign(&indices[0], &indices[6]);
+		meshData.bounds = centeredBounds(glm::vec3(halfWidth, 0, halfHeight), glm::length(glm::vec2(halfWidth, halfHeight)));
 	};
 
 	void createQuad(float width, float height, MeshData& meshData) {
@@ -44,6 +59,7 @@ namespace ew {
 			0, 2, 3
 		};
 		meshData.indices.assign(&indices[0], &indices[6]);
+		meshData.bounds = centeredBounds(glm::vec3(halfWidth, halfHeight, 0), glm::length(glm::vec2(halfWidth, halfHeight)));
 	};
 
 	void createCube(float width, float height, float depth, MeshData& meshData)
@@ -125,55 +141,96 @@ namespace ew {
 			22, 23, 20
 		};
 		meshData.indices.assign(&indices[0], &indices[36]);
+		meshData.bounds = centeredBounds(glm::vec3(halfWidth, halfHeight, halfDepth), glm::length(glm::vec3(halfWidth, halfHeight, halfDepth)));
 	}
 
-	void createSphere(float radius, int numSegments, MeshData& meshData)
-	{
-		meshData.vertices.clear();
-		meshData.indices.clear();
+	//Below this many segments a sphere is built on the calling thread, waking the pool would cost more than it saves
+	const int PARALLEL_SPHERE_SEGMENTS = 256;
+
+	//Runs fn(first, end) over [0, count) in ranges spread across threadPool's workers, or inline without one
+	template<typename Fn>
+	static void forEachRowRange(int count, ThreadPool* threadPool, Fn fn) {
+		if (threadPool == nullptr || count <= 1) {
+			fn(0, count);
+			return;
+		}
 
+		//A few ranges per thread, so a worker that starts late doesn't hold up the rest
+		int rangeCount = std::min(count, threadPool->GetThreadCount() * 4);
+		int perRange = (count + rangeCount - 1) / rangeCount;
+		threadPool->ParallelFor((count + perRange - 1) / perRange, [&](int range) {
+			int first = range * perRange;
+			fn(first, std::min(first + perRange, count));
+		});
+	}
+
+	void createSphere(float radius, int numSegments, MeshData& meshData, ThreadPool* threadPool)
+	{
 		float topY = radius;
 		float bottomY = -radius;
 
+		unsigned int ringVertexCount = numSegments + 1;
+		int rowCount = numSegments - 1;
+
+		//Exact sizes, poles plus every row, then the caps, the rings between rows and the bottom cap's wrap around
+		size_t vertexCount = 2 + (size_t)rowCount * ringVertexCount;
+		size_t indexCount = (size_t)numSegments * 3 + (size_t)(numSegments - 2) * numSegments * 6 + (size_t)ringVertexCount * 3;
+		meshData.vertices.resize(vertexCount);
+		meshData.indices.resize(indexCount);
+
 		unsigned int topIndex = 0;
-		meshData.vertices.push_back({ glm::vec3(0,topY,0),glm::vec3(0,1,0), glm::vec2(.5, 0)});
+		meshData.vertices[topIndex] = { glm::vec3(0,topY,0),glm::vec3(0,1,0), glm::vec2(.5, 0)};
 
 		//Angle between segments
 		float thetaStep = (2.0f * glm::pi<float>()) / (float)numSegments;
 		float phiStep = (glm::pi<float>()) / (float)numSegments;
 
-		for (int i = 1; i < numSegments; i++)
+		//Every row walks the same angles around, so their sines and cosines are worked out once
+		std::vector<float> sinTheta(ringVertexCount), cosTheta(ringVertexCount);
+		for (int j = 0; j <= numSegments; ++j)
 		{
-			float phi = phiStep * i;
+			float theta = (thetaStep * j);
+			sinTheta[j] = sinf(theta);
+			cosTheta[j] = cosf(theta);
+		}
 
-			//Create row
-			for (int j = 0; j <= numSegments; ++j)
+		ThreadPool* rowPool = numSegments >= PARALLEL_SPHERE_SEGMENTS ? threadPool : nullptr;
+		Vertex* vertices = meshData.vertices.data();
+		forEachRowRange(rowCount, rowPool, [&](int firstRow, int endRow) {
+			for (int row = firstRow; row < endRow; row++)
 			{
-				float theta = (thetaStep * j);
-
-				float x = sinf(phi) * sinf(theta);
+				int i = row + 1;
+				float phi = phiStep * i;
+				float sinPhi = sinf(phi);
 				float y = cosf(phi);
-				float z = sinf(phi) * cosf(theta);
-
-				glm::vec3 position = radius * glm::vec3(x, y, z);
-				glm::vec3 normal = glm::normalize(glm::vec3(x, y, z));
-				glm::vec2 uv = glm::vec2(
-					j / (float)numSegments,
-					-i / (float)numSegments);
-				//printf("%f, %f\n", uv.x, uv.y);
-				meshData.vertices.push_back({ position, normal, uv });
+
+				//Create row
+				Vertex* out = vertices + 1 + (size_t)row * ringVertexCount;
+				for (int j = 0; j <= numSegments; ++j)
+				{
+					float x = sinPhi * sinTheta[j];
+					float z = sinPhi * cosTheta[j];
+
+					glm::vec3 position = radius * glm::vec3(x, y, z);
+					glm::vec3 normal = glm::normalize(glm::vec3(x, y, z));
+					glm::vec2 uv = glm::vec2(
+						j / (float)numSegments,
+						-i / (float)numSegments);
+					out[j] = { position, normal, uv };
+				}
 			}
-		}
+		});
 
-		meshData.vertices.push_back({ glm::vec3(0,bottomY,0), glm::vec3(0,-1,0), glm::vec2(.5, 1) });
-		unsigned int bottomIndex = (unsigned int)meshData.vertices.size() - 1;
-		unsigned int ringVertexCount = numSegments + 1;
+		unsigned int bottomIndex = (unsigned int)vertexCount - 1;
+		meshData.vertices[bottomIndex] = { glm::vec3(0,bottomY,0), glm::vec3(0,-1,0), glm::vec2(.5, 1) };
+
+		unsigned int* indices = meshData.indices.data();
 
 		//TOP CAP
 		for (int i = 0; i < numSegments; ++i) {
-			meshData.indices.push_back(topIndex); //top cap center 
-			meshData.indices.push_back(i + 1);
-			meshData.indices.push_back(i + 2);
+			*indices++ = topIndex; //top cap center 
+			*indices++ = i + 1;
+			*indices++ = i + 2;
 		}
 
 		//RINGS
@@ -181,31 +238,39 @@ namespace ew {
 
 		//Row index
 		//-2 to ignore poles
-		for (int y = 0; y < numSegments - 2; ++y)
-		{
-			//Column index
-			for (int x = 0; x < numSegments; ++x)
+		unsigned int* ringIndices = indices;
+		forEachRowRange(numSegments - 2, rowPool, [&](int firstRow, int endRow) {
+			for (int y = firstRow; y < endRow; ++y)
 			{
-				//Triangle 1
-				meshData.indices.push_back(start + y * ringVertexCount + x);
-				meshData.indices.push_back(start + (y + 1) * ringVertexCount + x);
-				meshData.indices.push_back(start + y * ringVertexCount + x + 1);
-
-				//Triangle 2
-				meshData.indices.push_back(start + y * ringVertexCount + x + 1);
-				meshData.indices.push_back(start + (y + 1) * ringVertexCount + x);
-				meshData.indices.push_back(start + (y + 1) * ringVertexCount + x + 1);
+				unsigned int* out = ringIndices + (size_t)y * numSegments * 6;
+
+				//Column index
+				for (int x = 0; x < numSegments; ++x)
+				{
+					//Triangle 1
+					*out++ = start + y * ringVertexCount + x;
+					*out++ = start + (y + 1) * ringVertexCount + x;
+					*out++ = start + y * ringVertexCount + x + 1;
+
+					//Triangle 2
+					*out++ = start + y * ringVertexCount + x + 1;
+					*out++ = start + (y + 1) * ringVertexCount + x;
+					*out++ = start + (y + 1) * ringVertexCount + x + 1;
+				}
 			}
-		}
+		});
+		indices += (size_t)(numSegments - 2) * numSegments * 6;
 
 		start = bottomIndex - ringVertexCount;
 
 		//BOTTOM CAP
 		for (unsigned int i = 0; i < ringVertexCount; ++i) {
-			meshData.indices.push_back(start + i + 1);
-			meshData.indices.push_back(start + i);
-			meshData.indices.push_back(bottomIndex); //bottom cap center 
+			*indices++ = start + i + 1;
+			*indices++ = start + i;
+			*indices++ = bottomIndex; //bottom cap center 
 		}
+
+		meshData.bounds = centeredBounds(glm::vec3(radius), radius);
 	}
 
 	void createCylinder(float height, float radius, int numSegments, MeshData& meshData)
@@ -213,21 +278,33 @@ namespace ew {
 		meshData.vertices.clear();
 		meshData.indices.clear();
 
+		//Exact sizes, two caps of a center and a ring each, then the side's two rings. 12 indices per segment.
+		meshData.vertices.reserve((size_t)numSegments * 4 + 6);
+		meshData.indices.reserve((size_t)numSegments * 12);
+
 		float halfHeight = height * 0.5f;
 		float thetaStep = glm::pi<float>() * 2.0f / numSegments;
 
+		//Both caps go around the same angles
+		std::vector<float> sinTheta(numSegments + 1), cosTheta(numSegments + 1);
+		for (int i = 0; i <= numSegments; i++)
+		{
+			sinTheta[i] = sinf(i * thetaStep);
+			cosTheta[i] = cosf(i * thetaStep);
+		}
+
 		//VERTICES
 		//Top cap (facing up)
 		meshData.vertices.push_back(Vertex(glm::vec3(0, halfHeight, 0), glm::vec3(0, 1, 0), glm::vec2(.5, .5)));
 		for (int i = 0; i <= numSegments; i++)
 		{
 			glm::vec3 pos = glm::vec3(
-				cos(i * thetaStep) * radius,
+				cosTheta[i] * radius,
 				halfHeight,
-				sin(i * thetaStep) * radius
+				sinTheta[i] * radius
 			);
 
-			glm::vec2 uv = glm::vec2((cos(i * thetaStep) + 1) / 2, (sin(i * thetaStep) + 1) / 2);
+			glm::vec2 uv = glm::vec2((cosTheta[i] + 1) / 2, (sinTheta[i] + 1) / 2);
 			meshData.vertices.push_back(Vertex(pos, glm::vec3(0, 1, 0), uv));
 		}
 
@@ -237,11 +314,11 @@ namespace ew {
 		for (int i = 0; i <= numSegments; i++)
 		{
 			glm::vec3 pos = glm::vec3(
-				cos(i * thetaStep) * radius,
+				cosTheta[i] * radius,
 				-halfHeight,
-				sin(i * thetaStep) * radius
+				sinTheta[i] * radius
 			);
-			glm::vec2 uv = glm::vec2((cos(i * thetaStep) + 1) / 2, (sin(i * thetaStep) + 1) / 2);
+			glm::vec2 uv = glm::vec2((cosTheta[i] + 1) / 2, (sinTheta[i] + 1) / 2);
 			meshData.vertices.push_back(Vertex(pos, glm::vec3(0, -1, 0), uv));
 		}
 
@@ -290,6 +367,8 @@ namespace ew {
 			meshData.indices.push_back(start + 1);
 			meshData.indices.push_back(start + numSegments + 2);
 		}
+
+		meshData.bounds = centeredBounds(glm::vec3(radius, halfHeight, radius), glm::length(glm::vec2(radius, halfHeight)));
 	}
 
 }
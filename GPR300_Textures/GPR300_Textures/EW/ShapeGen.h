@@ -3,10 +3,13 @@
 #pragma once
 #include "Mesh.h"
 
+class ThreadPool;
+
 namespace ew {
 	void createPlane(float width, float height, MeshData& meshData);
 	void createQuad(float width, float height, MeshData& meshData);
 	void createCube(float width, float height, float depth, MeshData& meshData);
-	void createSphere(float radius, int numSegments, MeshData& meshData);
+	//Large spheres split their rows across threadPool when one is given
+	void createSphere(float radius, int numSegments, MeshData& meshData, ThreadPool* threadPool = nullptr);
 	void createCylinder(float height, float radius, int numSegments, MeshData& meshData);
 }
@@ -18,5 +18,20 @@ namespace ew {
 			rotation = glm::vec3(0);
 			scale = glm::vec3(1);
 		}
+		//Goes up by one whenever position, rotation or scale changed since the last call, lets caches tell if the transform moved
+		unsigned int getVersion() {
+			if (position != mLastPosition || rotation != mLastRotation || scale != mLastScale) {
+				mLastPosition = position;
+				mLastRotation = rotation;
+				mLastScale = scale;
+				mVersion++;
+			}
+			return mVersion;
+		}
+	private:
+		glm::vec3 mLastPosition = glm::vec3(0);
+		glm::vec3 mLastRotation = glm::vec3(0);
+		glm::vec3 mLastScale = glm::vec3(1);
+		unsigned int mVersion = 1;
 	};
 }
@@ -0,0 +1,38 @@
+#ifndef ATTENUATION_H
+#define ATTENUATION_H
+
+#include <cmath>
+
+//GL falloff attenuation, 1 / (constant + linear * d + quadratic * d^2)
+struct Attenuation
+{
+	float constant = 1.f;
+	float linear = .35f;
+	float quadratic = .44f;
+
+	float GetFactor(float dist) const
+	{
+		return 1.f / (constant + linear * dist + quadratic * dist * dist);
+	}
+
+	//Distance at which a light of the given intensity falls below cutoff, the falloff itself never reaches zero
+	float GetRadius(float intensity, float cutoff) const
+	{
+		//Solve quadratic * d^2 + linear * d + constant = intensity / cutoff
+		float target = intensity / cutoff;
+		if (target <= constant)
+		{
+			return 0.f;
+		}
+
+		if (quadratic <= 0.f)
+		{
+			return linear > 0.f ? (target - constant) / linear : INFINITY;
+		}
+
+		float discriminant = linear * linear - 4.f * quadratic * (constant - target);
+		return (-linear + std::sqrt(discriminant)) / (2.f * quadratic);
+	}
+};
+
+#endif
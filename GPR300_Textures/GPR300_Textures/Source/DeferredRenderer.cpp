@@ -0,0 +1,192 @@
+#include "DeferredRenderer.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <string>
+
+#include "imgui.h"
+
+//Texture units the light passes read the G-buffer from, above the ones TextureManager hands out
+static const GLuint ALBEDO_DIFFUSE_UNIT = 29;
+static const GLuint NORMAL_SPECULAR_UNIT = 30;
+static const GLuint DEPTH_UNIT = 31;
+
+DeferredRenderer::DeferredRenderer(ShaderManager* manager, FrameRingBuffer* ring)
+	: frameRing(ring)
+{
+	geometryShader = manager->Load("shaders/defaultLit.vert", "shaders/gBuffer.frag");
+	pointLightShader = manager->Load("shaders/deferredLightVolume.vert", "shaders/deferredLight.frag");
+	spotlightShader = manager->Load("shaders/deferredLightVolume.vert", "shaders/deferredLight.frag", "#define SPOTLIGHT\n");
+	directionalShader = manager->Load("shaders/fullscreen.vert", "shaders/deferredLight.frag", "#define DIRECTIONAL\n");
+
+	glCreateVertexArrays(1, &emptyVertexArray);
+}
+
+DeferredRenderer::~DeferredRenderer()
+{
+	DeleteTargets();
+	glDeleteVertexArrays(1, &emptyVertexArray);
+}
+
+void DeferredRenderer::CreateTargets(int screenWidth, int screenHeight)
+{
+	DeleteTargets();
+
+	width = screenWidth;
+	height = screenHeight;
+
+	const GLenum formats[TARGET_COUNT] = { GL_RGBA8, GL_RGBA16F, GL_RGBA16F };
+
+	glCreateFramebuffers(1, &framebuffer);
+	glCreateTextures(GL_TEXTURE_2D, TARGET_COUNT, targets);
+	for (int i = 0; i < TARGET_COUNT; i++)
+	{
+		glTextureStorage2D(targets[i], 1, formats[i], width, height);
+		glTextureParameteri(targets[i], GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTextureParameteri(targets[i], GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glNamedFramebufferTexture(framebuffer, GL_COLOR_ATTACHMENT0 + i, targets[i], 0);
+	}
+
+	//Same format as the default framebuffer's depth so it can be blitted across for the forward drawn gizmos
+	glCreateTextures(GL_TEXTURE_2D, 1, &depthTexture);
+	glTextureStorage2D(depthTexture, 1, GL_DEPTH24_STENCIL8, width, height);
+	glTextureParameteri(depthTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureParameteri(depthTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glNamedFramebufferTexture(framebuffer, GL_DEPTH_STENCIL_ATTACHMENT, depthTexture, 0);
+
+	if (glCheckNamedFramebufferStatus(framebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		printf("G-buffer framebuffer is incomplete\n");
+	}
+}
+
+void DeferredRenderer::DeleteTargets()
+{
+	if (framebuffer == 0)
+	{
+		return;
+	}
+
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteTextures(TARGET_COUNT, targets);
+	glDeleteTextures(1, &depthTexture);
+	framebuffer = 0;
+}
+
+Shader& DeferredRenderer::BeginGeometry(int screenWidth, int screenHeight)
+{
+	if (screenWidth != width || screenHeight != height)
+	{
+		CreateTargets(screenWidth, screenHeight);
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+	const GLenum drawBuffers[TARGET_COUNT] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+	glNamedFramebufferDrawBuffers(framebuffer, TARGET_COUNT, drawBuffers);
+
+	float clearColor[4] = { 0, 0, 0, 0 };
+	for (int i = 0; i < TARGET_COUNT; i++)
+	{
+		glClearNamedFramebufferfv(framebuffer, GL_COLOR, i, clearColor);
+	}
+	glClearNamedFramebufferfi(framebuffer, GL_DEPTH_STENCIL, 0, 1.f, 0);
+
+	//Alpha blending would mix material terms with whatever is behind them
+	glDisable(GL_BLEND);
+
+	geometryShader->use();
+	return *geometryShader;
+}
+
+void DeferredRenderer::BindGBuffer(Shader& shader, Camera& camera, const Attenuation& attenuation, bool phong, ShadowAtlas& shadows)
+{
+	shader.use();
+	shader.setInt("_GAlbedoDiffuse", ALBEDO_DIFFUSE_UNIT);
+	shader.setInt("_GNormalSpecular", NORMAL_SPECULAR_UNIT);
+	shader.setInt("_GDepth", DEPTH_UNIT);
+
+	shader.setMat4("_View", camera.getViewMatrix());
+	shader.setMat4("_Projection", camera.getProjectionMatrix());
+	shader.setMat4("_InverseViewProjection", glm::inverse(camera.getProjectionMatrix() * camera.getViewMatrix()));
+	shader.setVec2("_ScreenSize", glm::vec2(width, height));
+	shader.setVec3("_CamPos", camera.getPosition());
+	shader.setInt("_Phong", phong);
+
+	shader.setFloat("_Attenuation.constant", attenuation.constant);
+	shader.setFloat("_Attenuation.linear", attenuation.linear);
+	shader.setFloat("_Attenuation.quadratic", attenuation.quadratic);
+
+	shadows.Bind(shader);
+}
+
+void DeferredRenderer::ShadeLights(Camera& camera, const LightSystem& lights, const Attenuation& attenuation, bool phong, ShadowAtlas& shadows, ew::Mesh& sphereMesh, ew::Mesh& cylinderMesh, GLuint outputFramebuffer)
+{
+	const std::vector<GPUPointLight>& gpuPointLights = lights.GetGPUPointLights();
+	const std::vector<GPUSpotLight>& gpuSpotLights = lights.GetGPUSpotlights();
+
+	//Fresh ranges of the frame ring like LightClusterer's buffers
+	FrameRingBuffer::BindRange(GL_SHADER_STORAGE_BUFFER, DEFERRED_POINT_LIGHT_BINDING, frameRing->UploadStorage(gpuPointLights.data(), gpuPointLights.size() * sizeof(GPUPointLight)));
+	FrameRingBuffer::BindRange(GL_SHADER_STORAGE_BUFFER, DEFERRED_SPOTLIGHT_BINDING, frameRing->UploadStorage(gpuSpotLights.data(), gpuSpotLights.size() * sizeof(GPUSpotLight)));
+
+	//Only the lighting target is written from here on, the rest are read
+	glNamedFramebufferDrawBuffer(framebuffer, GL_COLOR_ATTACHMENT0 + LIGHTING);
+	glBindTextureUnit(ALBEDO_DIFFUSE_UNIT, targets[ALBEDO_DIFFUSE]);
+	glBindTextureUnit(NORMAL_SPECULAR_UNIT, targets[NORMAL_SPECULAR]);
+	glBindTextureUnit(DEPTH_UNIT, depthTexture);
+
+	//Additive, and no depth test since the depth texture is being sampled
+	//Back faces only, so a volume still covers the screen when the camera is inside it
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_ONE, GL_ONE);
+	glDisable(GL_DEPTH_TEST);
+	glDepthMask(GL_FALSE);
+	glCullFace(GL_FRONT);
+
+	if (!gpuPointLights.empty())
+	{
+		BindGBuffer(*pointLightShader, camera, attenuation, phong, shadows);
+		sphereMesh.drawInstanced((GLsizei)gpuPointLights.size());
+	}
+
+	if (!gpuSpotLights.empty())
+	{
+		BindGBuffer(*spotlightShader, camera, attenuation, phong, shadows);
+		cylinderMesh.drawInstanced((GLsizei)gpuSpotLights.size());
+	}
+
+	glCullFace(GL_BACK);
+
+	if (lights.directionalLightCount > 0)
+	{
+		const LightSystem::DirectionalLightArrays& directionalLights = lights.GetDirectionalLights();
+
+		BindGBuffer(*directionalShader, camera, attenuation, phong, shadows);
+		directionalShader->setInt("_UsedDirectionalLights", lights.directionalLightCount);
+		for (int i = 0; i < lights.directionalLightCount; i++)
+		{
+			directionalShader->setVec3("_DirectionalLight[" + std::to_string(i) + "].dir", glm::vec3(directionalLights.dirX[i], directionalLights.dirY[i], directionalLights.dirZ[i]));
+			directionalShader->setVec3("_DirectionalLight[" + std::to_string(i) + "].color", glm::vec3(directionalLights.colorR[i], directionalLights.colorG[i], directionalLights.colorB[i]));
+			directionalShader->setFloat("_DirectionalLight[" + std::to_string(i) + "].intensity", directionalLights.intensity[i]);
+		}
+
+		glBindVertexArray(emptyVertexArray);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+	}
+
+	//Back to the state the forward path expects
+	glDepthMask(GL_TRUE);
+	glEnable(GL_DEPTH_TEST);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	glNamedFramebufferReadBuffer(framebuffer, GL_COLOR_ATTACHMENT0 + LIGHTING);
+	glBlitNamedFramebuffer(framebuffer, outputFramebuffer, 0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
+}
+
+void DeferredRenderer::ExposeImGui()
+{
+	//Bytes per pixel of each target plus depth
+	int bytesPerPixel = 4 + 8 + 8 + 4;
+	ImGui::Text("G-buffer: %dx%d, %.1f MB", width, height, width * height * bytesPerPixel / (1024.f * 1024.f));
+}
@@ -0,0 +1,63 @@
+#ifndef DEFERRED_RENDERER_H
+#define DEFERRED_RENDERER_H
+
+#include "GL/glew.h"
+#include "glm/glm.hpp"
+
+#include "Camera.h"
+#include "Mesh.h"
+#include "Shader.h"
+#include "ShaderManager.h"
+#include "Attenuation.h"
+#include "LightSystem.h"
+#include "ShadowAtlas.h"
+#include "FrameRingBuffer.h"
+
+//Storage buffer bindings read by deferredLightVolume.vert and deferredLight.frag
+const GLuint DEFERRED_POINT_LIGHT_BINDING = 0;
+const GLuint DEFERRED_SPOTLIGHT_BINDING = 1;
+
+//Alternative to the forward path: geometry writes a G-buffer once, then every light only shades the pixels inside its volume
+class DeferredRenderer
+{
+public:
+	DeferredRenderer(ShaderManager* manager, FrameRingBuffer* ring);
+	~DeferredRenderer();
+
+	//Binds and clears the G-buffer, resizing it to the screen first if needed. Draw the scene with the returned shader.
+	Shader& BeginGeometry(int screenWidth, int screenHeight);
+
+	//Adds every light into the lighting target, then copies it and the depth to outputFramebuffer and leaves that bound
+	void ShadeLights(Camera& camera, const LightSystem& lights, const Attenuation& attenuation, bool phong, ShadowAtlas& shadows, ew::Mesh& sphereMesh, ew::Mesh& cylinderMesh, GLuint outputFramebuffer = 0);
+
+	void ExposeImGui();
+
+private:
+	enum Target
+	{
+		ALBEDO_DIFFUSE,		//RGBA8, albedo and diffuse coefficient
+		NORMAL_SPECULAR,	//RGBA16F, octahedral normal, specular coefficient and shininess
+		LIGHTING,			//RGBA16F, ambient from the geometry pass plus every light
+		TARGET_COUNT
+	};
+
+	Shader* geometryShader;
+	Shader* pointLightShader;
+	Shader* spotlightShader;
+	Shader* directionalShader;
+
+	GLuint framebuffer = 0;
+	GLuint targets[TARGET_COUNT] = {};
+	GLuint depthTexture = 0;
+	FrameRingBuffer* frameRing;
+	GLuint emptyVertexArray = 0;	//Core profile needs a vertex array bound even for the attribute-less fullscreen triangle
+
+	int width = 0;
+	int height = 0;
+
+	void CreateTargets(int screenWidth, int screenHeight);
+	void DeleteTargets();
+	void BindGBuffer(Shader& shader, Camera& camera, const Attenuation& attenuation, bool phong, ShadowAtlas& shadows);
+};
+
+#endif
@@ -0,0 +1,147 @@
+#include "DistantLightSH.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+#include "imgui.h"
+
+static const float PI = 3.14159265f;
+
+//Clamped cosine lobe per band, turns projected radiance into irradiance
+static const float COSINE_LOBE[3] = { PI, 2.f * PI / 3.f, PI / 4.f };
+
+//Real L2 basis, in the order defaultLit.frag's evaluateIrradianceSH expects
+static void EvaluateBasis(const glm::vec3& dir, float basis[9])
+{
+	basis[0] = .282095f;
+	basis[1] = .488603f * dir.y;
+	basis[2] = .488603f * dir.z;
+	basis[3] = .488603f * dir.x;
+	basis[4] = 1.092548f * dir.x * dir.y;
+	basis[5] = 1.092548f * dir.y * dir.z;
+	basis[6] = .315392f * (3.f * dir.z * dir.z - 1.f);
+	basis[7] = 1.092548f * dir.x * dir.z;
+	basis[8] = .546274f * (dir.x * dir.x - dir.y * dir.y);
+}
+
+void DistantLightSH::Update(const LightSystem& lights, const Attenuation& attenuation, const glm::vec3& referencePos, bool allowPointLights)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	distantLights.clear();
+	nearPointLights.clear();
+
+	if (enabled)
+	{
+		const LightSystem::DirectionalLightArrays& directionals = lights.GetDirectionalLights();
+		for (int i = 0; i < lights.directionalLightCount; i++)
+		{
+			DistantLight light;
+			light.dir = glm::normalize(glm::vec3(directionals.dirX[i], directionals.dirY[i], directionals.dirZ[i]));
+			light.radiance = directionals.intensity[i] * glm::vec3(directionals.colorR[i], directionals.colorG[i], directionals.colorB[i]);
+			light.shadowIndex = i;
+			light.pointLight = false;
+			distantLights.push_back(light);
+		}
+	}
+
+	//Far point lights barely change direction or falloff across the scene, so one direction and intensity stands in for all of it
+	const std::vector<GPUPointLight>& pointLights = lights.GetGPUPointLights();
+	bool projectPointLights = enabled && projectFarPointLights && allowPointLights;
+	for (int i = 0; i < lights.pointLightCount; i++)
+	{
+		glm::vec3 toLight = glm::vec3(pointLights[i].posRadius) - referencePos;
+		float dist = glm::length(toLight);
+		if (!projectPointLights || dist <= farDistance)
+		{
+			nearPointLights.push_back(i);
+			continue;
+		}
+
+		//Out of range lights are dropped like the forward path would cull them
+		float radius = pointLights[i].posRadius.w;
+		if (dist >= radius)
+		{
+			continue;
+		}
+
+		float ratio = dist / radius;
+		float window = 1.f - ratio * ratio * ratio * ratio;
+
+		DistantLight light;
+		light.dir = toLight / dist;
+		light.radiance = pointLights[i].colorIntensity.a * glm::vec3(pointLights[i].colorIntensity) * attenuation.GetFactor(dist) * window * window;
+		light.shadowIndex = -1;
+		light.pointLight = true;
+		distantLights.push_back(light);
+	}
+
+	for (int i = 0; i < 9; i++)
+	{
+		coefficients[i] = glm::vec3(0);
+		pointCoefficients[i] = glm::vec3(0);
+	}
+
+	float basis[9];
+	for (size_t i = 0; i < distantLights.size(); i++)
+	{
+		DistantLight& light = distantLights[i];
+		light.importance = glm::dot(light.radiance, glm::vec3(.2126f, .7152f, .0722f));
+
+		EvaluateBasis(light.dir, basis);
+		for (int c = 0; c < 9; c++)
+		{
+			int band = c == 0 ? 0 : (c < 4 ? 1 : 2);
+			glm::vec3 projected = light.radiance * (basis[c] * COSINE_LOBE[band]);
+			coefficients[c] += projected;
+			if (light.pointLight)
+			{
+				pointCoefficients[c] += projected;
+			}
+		}
+	}
+
+	//Brightest first, the first specularLights of them keep exact specular
+	int keep = std::min(std::min(specularLights, MAX_SPECULAR_LIGHTS), (int)distantLights.size());
+	std::partial_sort(distantLights.begin(), distantLights.begin() + keep, distantLights.end(),
+		[](const DistantLight& a, const DistantLight& b) { return a.importance > b.importance; });
+
+	projectedLights = (int)distantLights.size();
+	lastUpdateMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void DistantLightSH::Bind(Shader& shader)
+{
+	for (int i = 0; i < 9; i++)
+	{
+		shader.setVec3("_SHCoefficients[" + std::to_string(i) + "]", coefficients[i]);
+		shader.setVec3("_SHPointCoefficients[" + std::to_string(i) + "]", pointCoefficients[i]);
+	}
+
+	int keep = std::min(std::min(specularLights, MAX_SPECULAR_LIGHTS), (int)distantLights.size());
+	shader.setInt("_UsedSHSpecularLights", keep);
+	for (int i = 0; i < keep; i++)
+	{
+		shader.setVec3("_SHSpecularLights[" + std::to_string(i) + "].dir", distantLights[i].dir);
+		shader.setVec3("_SHSpecularLights[" + std::to_string(i) + "].color", distantLights[i].radiance);
+		shader.setInt("_SHSpecularLights[" + std::to_string(i) + "].shadowIndex", distantLights[i].shadowIndex);
+		shader.setInt("_SHSpecularLights[" + std::to_string(i) + "].pointLight", distantLights[i].pointLight);
+	}
+}
+
+void DistantLightSH::ExposeImGui()
+{
+	ImGui::Checkbox("Spherical Harmonics Distant Lights", &enabled);
+
+	if (enabled)
+	{
+		ImGui::Checkbox("Project Far Point Lights", &projectFarPointLights);
+		if (projectFarPointLights)
+		{
+			ImGui::SliderFloat("Far Distance", &farDistance, 1.f, 100.f);
+		}
+		ImGui::SliderInt("Exact Specular Lights", &specularLights, 0, MAX_SPECULAR_LIGHTS);
+		ImGui::Text("SH lights: %d projected in %.3f ms", projectedLights, lastUpdateMs);
+	}
+}
@@ -0,0 +1,60 @@
+#ifndef DISTANT_LIGHT_SH_H
+#define DISTANT_LIGHT_SH_H
+
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "Shader.h"
+#include "Attenuation.h"
+#include "LightSystem.h"
+
+//Projects the directional lights, and optionally point lights far from the camera, into L2 spherical harmonics.
+//defaultLit.frag then evaluates all of their diffuse light from 9 coefficients, and only the brightest few keep exact specular.
+class DistantLightSH
+{
+public:
+	//Size of _SHSpecularLights in defaultLit.frag
+	static const int MAX_SPECULAR_LIGHTS = 4;
+
+	bool enabled = false;
+	bool projectFarPointLights = false;
+	float farDistance = 15.f;
+	int specularLights = 2;
+
+	//Call after LightSystem::Pack. Point lights further than farDistance from referencePos are treated as
+	//directional lights with the intensity they have there, only when allowPointLights is set
+	void Update(const LightSystem& lights, const Attenuation& attenuation, const glm::vec3& referencePos, bool allowPointLights);
+
+	//Packed point lights that were not projected, in order, so the forward path still shades them
+	const std::vector<int>& GetNearPointLights() const { return nearPointLights; }
+
+	//Sets the coefficients and the exact specular lights. Lightmapped meshes already have the directional lights baked
+	//in, so the far point lights get a second set of coefficients of their own.
+	void Bind(Shader& shader);
+
+	void ExposeImGui();
+
+private:
+	struct DistantLight
+	{
+		glm::vec3 dir;	//Towards the light
+		glm::vec3 radiance;	//Color times intensity
+		int shadowIndex;	//Directional light shadow tile, -1 for none
+		bool pointLight;	//Projected from a far point light, which lightmaps don't bake
+		float importance;
+	};
+
+	//Irradiance coefficients, the cosine lobe convolution is already folded in
+	glm::vec3 coefficients[9];
+	//Only the far point lights' share of coefficients
+	glm::vec3 pointCoefficients[9];
+
+	std::vector<DistantLight> distantLights;
+	std::vector<int> nearPointLights;
+
+	int projectedLights = 0;
+	double lastUpdateMs = 0;
+};
+
+#endif
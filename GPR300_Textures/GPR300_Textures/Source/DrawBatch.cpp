@@ -0,0 +1,195 @@
+#include "DrawBatch.h"
+
+#include <algorithm>
+#include <tuple>
+
+DrawBatch::DrawBatch(ew::MeshPool* pool, FrameRingBuffer* ring)
+	: meshPool(pool), frameRing(ring)
+{
+}
+
+bool DrawBatch::IsSupported()
+{
+	return GLEW_ARB_shader_draw_parameters;
+}
+
+void DrawBatch::Clear()
+{
+	draws.clear();
+	transforms.clear();
+}
+
+void DrawBatch::PushTransform(const ew::Mesh& mesh, const glm::mat4& model)
+{
+	DrawTransform transform;
+	transform.model = model;
+	transform.normalMatrix = glm::transpose(glm::inverse(model));
+	const ew::VertexQuantization& quantization = mesh.getVertexQuantization();
+	transform.positionScale = glm::vec4(quantization.positionScale, 0.f);
+	transform.positionOffset = glm::vec4(quantization.positionOffset, 0.f);
+	transform.uvQuantization = glm::vec4(quantization.uvScale, quantization.uvOffset);
+	transforms.push_back(transform);
+}
+
+void DrawBatch::PushDraw(const ew::Mesh& mesh, int firstIndex, int count, int group)
+{
+	QueuedDraw draw;
+	draw.indexType = mesh.getIndexType();
+	draw.group = group;
+	draw.count = (GLuint)count;
+	draw.firstIndex = (GLuint)(mesh.getFirstIndex() + firstIndex);
+	draw.baseVertex = mesh.getBaseVertex();
+	draw.transform = (GLuint)(transforms.size() - 1);
+	draws.push_back(draw);
+}
+
+void DrawBatch::Add(const ew::Mesh& mesh, const glm::mat4& model, int group)
+{
+	if (mesh.getNumIndices() == 0)
+	{
+		return;
+	}
+
+	PushTransform(mesh, model);
+	PushDraw(mesh, 0, mesh.getNumIndices(), group);
+}
+
+void DrawBatch::AddRanges(const ew::Mesh& mesh, const std::vector<IndexRange>& ranges, const glm::mat4& model, int group)
+{
+	if (mesh.getNumIndices() == 0 || ranges.empty())
+	{
+		return;
+	}
+
+	PushTransform(mesh, model);
+	for (size_t i = 0; i < ranges.size(); i++)
+	{
+		PushDraw(mesh, ranges[i].firstIndex, ranges[i].count, group);
+	}
+}
+
+void DrawBatch::Upload()
+{
+	//Draws of the same range end up next to each other so they can share a command. Index type comes first so every
+	//group of one type is contiguous, which lets depth only passes submit them together. Stable so draws that can't
+	//share still keep the order they were added in.
+	std::stable_sort(draws.begin(), draws.end(), [](const QueuedDraw& a, const QueuedDraw& b)
+	{
+		return std::tie(a.indexType, a.group, a.baseVertex, a.firstIndex, a.count) < std::tie(b.indexType, b.group, b.baseVertex, b.firstIndex, b.count);
+	});
+
+	runs.clear();
+	commandCount = 0;
+	if (draws.empty())
+	{
+		return;
+	}
+
+	//Transforms are laid out in draw order, so objects drawing the same range sit next to each other and one
+	//instanced command reaches all of them through gl_BaseInstanceARB + gl_InstanceID
+	transformOrder.assign(transforms.size(), -1);
+	orderedTransforms.clear();
+
+	//Commands are written straight into the mapping, the indirect buffer offset only needs 4 byte alignment
+	commandAllocation = frameRing->Allocate(draws.size() * sizeof(DrawCommand), sizeof(GLuint));
+	DrawCommand* commands = (DrawCommand*)commandAllocation.data;
+	if (commands == nullptr)
+	{
+		draws.clear();
+		return;
+	}
+
+	for (size_t i = 0; i < draws.size(); i++)
+	{
+		const QueuedDraw& draw = draws[i];
+
+		bool firstUse = transformOrder[draw.transform] < 0;
+		if (firstUse)
+		{
+			transformOrder[draw.transform] = (int)orderedTransforms.size();
+			orderedTransforms.push_back(transforms[draw.transform]);
+		}
+		GLuint transform = (GLuint)transformOrder[draw.transform];
+
+		bool newRun = runs.empty() || runs.back().group != draw.group || runs.back().indexType != draw.indexType;
+		if (!newRun && firstUse && instancing)
+		{
+			DrawCommand& previous = commands[commandCount - 1];
+			if (previous.count == draw.count && previous.firstIndex == draw.firstIndex && previous.baseVertex == draw.baseVertex &&
+				previous.baseInstance + previous.instanceCount == transform)
+			{
+				previous.instanceCount++;
+				continue;
+			}
+		}
+
+		DrawCommand& command = commands[commandCount];
+		command.count = draw.count;
+		command.instanceCount = 1;
+		command.firstIndex = draw.firstIndex;
+		command.baseVertex = draw.baseVertex;
+		command.baseInstance = transform;
+
+		if (newRun)
+		{
+			CommandRun run;
+			run.group = draw.group;
+			run.indexType = draw.indexType;
+			run.first = commandCount;
+			run.count = 0;
+			runs.push_back(run);
+		}
+		runs.back().count++;
+		commandCount++;
+	}
+
+	transformAllocation = frameRing->UploadStorage(orderedTransforms.data(), orderedTransforms.size() * sizeof(DrawTransform));
+}
+
+void DrawBatch::Draw(Shader& shader, bool depthOnly, const std::function<void(int)>& setGroupState)
+{
+	lastSubmitCount = 0;
+	if (draws.empty())
+	{
+		return;
+	}
+
+	shader.setInt("_Batched", 1);
+
+	FrameRingBuffer::BindRange(GL_SHADER_STORAGE_BUFFER, DRAW_TRANSFORM_BINDING, transformAllocation);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandAllocation.buffer);
+
+	if (depthOnly)
+	{
+		meshPool->bindDepthVertexArray();
+	}
+	else
+	{
+		meshPool->bindVertexArray();
+	}
+
+	for (size_t i = 0; i < runs.size();)
+	{
+		//Depth only passes have no state to change between groups, so the runs of one index type go out together.
+		//Runs are laid out back to back, so their commands are already contiguous.
+		size_t end = i + 1;
+		int count = runs[i].count;
+		while (depthOnly && end < runs.size() && runs[end].indexType == runs[i].indexType)
+		{
+			count += runs[end].count;
+			end++;
+		}
+
+		if (!depthOnly)
+		{
+			setGroupState(runs[i].group);
+		}
+
+		glMultiDrawElementsIndirect(GL_TRIANGLES, runs[i].indexType, (const void*)(commandAllocation.offset + runs[i].first * sizeof(DrawCommand)), count, 0);
+		lastSubmitCount++;
+		i = end;
+	}
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	shader.setInt("_Batched", 0);
+}
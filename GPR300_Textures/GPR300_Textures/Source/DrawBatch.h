@@ -0,0 +1,122 @@
+#ifndef DRAW_BATCH_H
+#define DRAW_BATCH_H
+
+#include <functional>
+#include <vector>
+
+#include "GL/glew.h"
+#include "glm/glm.hpp"
+
+#include "Mesh.h"
+#include "Shader.h"
+#include "FrameRingBuffer.h"
+
+//Storage buffer binding of the per-draw transforms, read by defaultLit.vert when _Batched is set
+const GLuint DRAW_TRANSFORM_BINDING = 4;
+
+//Collects a frame's draws into an indirect buffer and a storage buffer of transforms, then submits them with
+//glMultiDrawElementsIndirect. Both are written into the frame ring each frame. Each command's base instance is the
+//index of its object's transform, which the vertex shader reads back through gl_BaseInstanceARB, so no per-draw
+//uniforms are set. Objects drawing the same range of the pool, like shapes shared through PrimitiveCache, are folded
+//into one instanced command.
+class DrawBatch
+{
+public:
+	bool enabled = true;
+	bool instancing = true;	//Fold draws of the same range into instanced commands
+
+	DrawBatch(ew::MeshPool* pool, FrameRingBuffer* ring);
+
+	//Batching needs ARB_shader_draw_parameters in the vertex shader
+	static bool IsSupported();
+
+	//Draws sharing a group go out in the same multi-draw, the group is whatever state has to change between them.
+	//Meshes with 16 and 32 bit indices can't share one either, so they split a group in two.
+	void Clear();
+	void Add(const ew::Mesh& mesh, const glm::mat4& model, int group);
+
+	//Part of a mesh's indices, relative to its first index
+	struct IndexRange
+	{
+		int firstIndex;
+		int count;
+	};
+
+	//Draws only the given ranges of the mesh, one command each, all sharing a single transform
+	void AddRanges(const ew::Mesh& mesh, const std::vector<IndexRange>& ranges, const glm::mat4& model, int group);
+
+	//Sorts the draws by index type and group and writes the commands and transforms into the ring, call once a frame after the last Add
+	void Upload();
+
+	//One multi-draw per group, setGroupState is called before each. Depth only passes ignore groups and go out in one
+	//call per index type.
+	void Draw(Shader& shader, bool depthOnly, const std::function<void(int)>& setGroupState);
+
+	int GetObjectCount() const { return (int)transforms.size(); }
+	int GetDrawCount() const { return (int)draws.size(); }
+	int GetCommandCount() const { return commandCount; }
+	int GetLastSubmitCount() const { return lastSubmitCount; }
+
+private:
+	//Layout glMultiDrawElementsIndirect reads
+	struct DrawCommand
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	//std430 layout of DrawTransform in defaultLit.vert
+	struct DrawTransform
+	{
+		glm::mat4 model;
+		glm::mat4 normalMatrix;
+		glm::vec4 positionScale;	//The mesh's VertexQuantization, w unused
+		glm::vec4 positionOffset;
+		glm::vec4 uvQuantization;	//Scale in xy, offset in zw
+	};
+
+	struct QueuedDraw
+	{
+		GLenum indexType;
+		int group;
+		GLuint count;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint transform;
+	};
+
+	ew::MeshPool* meshPool;
+	FrameRingBuffer* frameRing;
+
+	FrameRingBuffer::Allocation commandAllocation;
+	FrameRingBuffer::Allocation transformAllocation;
+
+	std::vector<QueuedDraw> draws;
+	std::vector<DrawTransform> transforms;
+
+	//Where each added transform lands in the uploaded array, which follows the sorted draws
+	std::vector<int> transformOrder;
+	std::vector<DrawTransform> orderedTransforms;
+	int commandCount = 0;
+
+	//Runs of commands sharing a group and index type
+	struct CommandRun
+	{
+		int group;
+		GLenum indexType;
+		int first;
+		int count;
+	};
+
+	std::vector<CommandRun> runs;
+
+	void PushTransform(const ew::Mesh& mesh, const glm::mat4& model);
+	void PushDraw(const ew::Mesh& mesh, int firstIndex, int count, int group);
+
+	int lastSubmitCount = 0;
+};
+
+#endif
@@ -0,0 +1,251 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdio.h>
+
+#include "imgui.h"
+
+//Texture unit the upscale pass reads the scene from, above the ones TextureManager hands out
+static const GLuint SCENE_UNIT = 26;
+
+//Over budget is acted on quickly, headroom has to last a while, so the scale doesn't bounce between two steps
+static const int OVER_BUDGET_FRAMES = 10;
+static const int UNDER_BUDGET_FRAMES = 60;
+static const float HEADROOM = .8f;	//Fraction of the budget the frame has to stay under before quality goes back up
+static const int COOLDOWN_FRAMES = 30;	//The averaged timings lag a few frames behind a change
+
+static const float SCALE_DOWN_STEP = .1f;
+static const float SCALE_UP_STEP = .05f;
+
+//Quality ladder, level 0 is full quality
+static const float LEVEL_ANISOTROPY[DynamicResolution::QUALITY_LEVELS] = { 16.f, 4.f, 1.f, 1.f };
+static const int LEVEL_MAX_LIGHTS[DynamicResolution::QUALITY_LEVELS] = { -1, -1, 256, 32 };
+
+DynamicResolution::DynamicResolution(ShaderManager* manager)
+{
+	upscaleShader = manager->Load("shaders/fullscreen.vert", "shaders/upscale.frag");
+	glCreateVertexArrays(1, &emptyVertexArray);
+}
+
+DynamicResolution::~DynamicResolution()
+{
+	DeleteTargets();
+	glDeleteVertexArrays(1, &emptyVertexArray);
+}
+
+void DynamicResolution::CreateTargets(int width, int height)
+{
+	DeleteTargets();
+
+	textureWidth = width;
+	textureHeight = height;
+
+	//Full screen size, the scale only changes how much of it gets rendered into
+	glCreateTextures(GL_TEXTURE_2D, 1, &colorTexture);
+	glTextureStorage2D(colorTexture, 1, GL_RGBA8, width, height);
+	glTextureParameteri(colorTexture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(colorTexture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(colorTexture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(colorTexture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	//Same depth format as the G-buffer so the deferred path can blit into it
+	glCreateTextures(GL_TEXTURE_2D, 1, &depthTexture);
+	glTextureStorage2D(depthTexture, 1, GL_DEPTH24_STENCIL8, width, height);
+
+	glCreateFramebuffers(1, &framebuffer);
+	glNamedFramebufferTexture(framebuffer, GL_COLOR_ATTACHMENT0, colorTexture, 0);
+	glNamedFramebufferTexture(framebuffer, GL_DEPTH_STENCIL_ATTACHMENT, depthTexture, 0);
+
+	if (glCheckNamedFramebufferStatus(framebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		printf("Dynamic resolution framebuffer is incomplete\n");
+	}
+}
+
+void DynamicResolution::DeleteTargets()
+{
+	if (framebuffer == 0)
+	{
+		return;
+	}
+
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteTextures(1, &colorTexture);
+	glDeleteTextures(1, &depthTexture);
+	framebuffer = 0;
+}
+
+void DynamicResolution::BeginScene(int width, int height, const glm::vec3& clearColor)
+{
+	screenWidth = width;
+	screenHeight = height;
+
+	sceneTimer.Begin();
+
+	if (!enabled)
+	{
+		renderWidth = screenWidth;
+		renderHeight = screenHeight;
+		return;
+	}
+
+	if (textureWidth != screenWidth || textureHeight != screenHeight)
+	{
+		CreateTargets(screenWidth, screenHeight);
+	}
+
+	renderWidth = std::max((int)(screenWidth * scale), 1);
+	renderHeight = std::max((int)(screenHeight * scale), 1);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, renderWidth, renderHeight);
+
+	float clear[4] = { clearColor.r, clearColor.g, clearColor.b, 1.f };
+	glClearNamedFramebufferfv(framebuffer, GL_COLOR, 0, clear);
+	glClearNamedFramebufferfi(framebuffer, GL_DEPTH_STENCIL, 0, 1.f, 0);
+}
+
+void DynamicResolution::EndScene()
+{
+	sceneTimer.End();
+
+	if (!enabled)
+	{
+		return;
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, screenWidth, screenHeight);
+
+	//Covers every pixel, nothing to test or blend against. Filled even in wireframe, which only applies to the scene.
+	GLint polygonMode[2];
+	glGetIntegerv(GL_POLYGON_MODE, polygonMode);
+	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
+
+	glBindTextureUnit(SCENE_UNIT, colorTexture);
+	upscaleShader->use();
+	upscaleShader->setInt("_Scene", SCENE_UNIT);
+	upscaleShader->setVec2("_UVScale", glm::vec2((float)renderWidth / textureWidth, (float)renderHeight / textureHeight));
+	upscaleShader->setVec2("_TexelSize", glm::vec2(1.f / textureWidth, 1.f / textureHeight));
+	upscaleShader->setFloat("_Sharpness", scale < 1.f ? sharpness : 0.f);
+
+	glBindVertexArray(emptyVertexArray);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	glPolygonMode(GL_FRONT_AND_BACK, polygonMode[0]);
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_BLEND);
+
+	Govern();
+}
+
+void DynamicResolution::Govern()
+{
+	if (cooldownFrames > 0)
+	{
+		cooldownFrames--;
+		return;
+	}
+
+	double frameMs = sceneTimer.GetAverageMilliseconds();
+	if (frameMs > budgetMs)
+	{
+		overBudgetFrames++;
+		underBudgetFrames = 0;
+	}
+	else if (frameMs < budgetMs * HEADROOM)
+	{
+		underBudgetFrames++;
+		overBudgetFrames = 0;
+	}
+	else
+	{
+		//Inside the dead band, hold still
+		overBudgetFrames = 0;
+		underBudgetFrames = 0;
+	}
+
+	bool changed = false;
+
+	//Resolution goes first, the quality ladder only once the scale is at its floor
+	if (overBudgetFrames >= OVER_BUDGET_FRAMES)
+	{
+		if (scale > minScale)
+		{
+			scale = std::max(scale - SCALE_DOWN_STEP, minScale);
+			changed = true;
+		}
+		else if (governQuality && qualityLevel < QUALITY_LEVELS - 1)
+		{
+			qualityLevel++;
+			changed = true;
+		}
+	}
+	//Coming back up the order is reversed
+	else if (underBudgetFrames >= UNDER_BUDGET_FRAMES)
+	{
+		if (qualityLevel > 0)
+		{
+			qualityLevel--;
+			changed = true;
+		}
+		else if (scale < 1.f)
+		{
+			scale = std::min(scale + SCALE_UP_STEP, 1.f);
+			changed = true;
+		}
+	}
+
+	if (changed)
+	{
+		overBudgetFrames = 0;
+		underBudgetFrames = 0;
+		cooldownFrames = COOLDOWN_FRAMES;
+	}
+}
+
+int DynamicResolution::GetMaxLights() const
+{
+	return enabled && governQuality ? LEVEL_MAX_LIGHTS[qualityLevel] : -1;
+}
+
+float DynamicResolution::GetAnisotropy() const
+{
+	return enabled && governQuality ? LEVEL_ANISOTROPY[qualityLevel] : LEVEL_ANISOTROPY[0];
+}
+
+void DynamicResolution::ExposeImGui()
+{
+	ImGui::Checkbox("Dynamic Resolution", &enabled);
+
+	if (enabled)
+	{
+		ImGui::SliderFloat("GPU Budget (ms)", &budgetMs, 1.f, 33.f);
+		ImGui::SliderFloat("Min Scale", &minScale, .25f, 1.f);
+		ImGui::SliderFloat("Upscale Sharpness", &sharpness, 0.f, 1.f);
+		ImGui::Checkbox("Govern Lights and Anisotropy", &governQuality);
+		if (!governQuality)
+		{
+			qualityLevel = 0;
+		}
+		scale = std::max(scale, minScale);
+
+		ImGui::Text("Scene: %.2f ms at %dx%d (%.0f%%)", sceneTimer.GetAverageMilliseconds(), renderWidth, renderHeight, scale * 100.f);
+		int maxLights = GetMaxLights();
+		if (maxLights < 0)
+		{
+			ImGui::Text("Quality level %d: %.0fx anisotropy, every light", qualityLevel, GetAnisotropy());
+		}
+		else
+		{
+			ImGui::Text("Quality level %d: %.0fx anisotropy, %d lights", qualityLevel, GetAnisotropy(), maxLights);
+		}
+	}
+	else
+	{
+		ImGui::Text("Scene: %.2f ms", sceneTimer.GetAverageMilliseconds());
+	}
+}
@@ -0,0 +1,76 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include "GL/glew.h"
+#include "glm/glm.hpp"
+
+#include "Shader.h"
+#include "ShaderManager.h"
+#include "GpuTimer.h"
+
+//Renders the scene into an offscreen target at a fraction of the screen size, then upscales it to the screen.
+//A governor compares the measured GPU time of the scene against a budget and trades resolution, then texture
+//anisotropy and the number of active lights, to stay inside it.
+class DynamicResolution
+{
+public:
+	//Rungs of the quality ladder the governor steps through once the resolution is as low as it may go
+	static const int QUALITY_LEVELS = 4;
+
+	bool enabled = false;
+	float budgetMs = 8.f;
+	float minScale = .5f;
+	float sharpness = .5f;	//0 upscales with plain bilinear filtering
+	bool governQuality = true;
+
+	DynamicResolution(ShaderManager* manager);
+	~DynamicResolution();
+
+	//Binds the scene target at the current scale and clears it, or the default framebuffer when disabled
+	void BeginScene(int screenWidth, int screenHeight, const glm::vec3& clearColor);
+
+	//Upscales the scene to the default framebuffer and lets the governor react to the frame's time
+	void EndScene();
+
+	//Size the scene is rendered at this frame, anything that maps gl_FragCoord needs this rather than the screen size
+	int GetWidth() const { return renderWidth; }
+	int GetHeight() const { return renderHeight; }
+	GLuint GetFramebuffer() const { return enabled ? framebuffer : 0; }
+
+	//Limits from the quality ladder, -1 lights means no limit
+	int GetMaxLights() const;
+	float GetAnisotropy() const;
+
+	void ExposeImGui();
+
+private:
+	Shader* upscaleShader;
+
+	GLuint framebuffer = 0;
+	GLuint colorTexture = 0;
+	GLuint depthTexture = 0;
+	GLuint emptyVertexArray = 0;
+	int textureWidth = 0;
+	int textureHeight = 0;
+
+	int screenWidth = 0;
+	int screenHeight = 0;
+	int renderWidth = 0;
+	int renderHeight = 0;
+
+	GpuTimer sceneTimer;
+
+	float scale = 1.f;
+	int qualityLevel = 0;
+
+	//Hysteresis, how many frames in a row the time has been over or under budget and how long to hold after a change
+	int overBudgetFrames = 0;
+	int underBudgetFrames = 0;
+	int cooldownFrames = 0;
+
+	void CreateTargets(int width, int height);
+	void DeleteTargets();
+	void Govern();
+};
+
+#endif
@@ -0,0 +1,167 @@
+#include "FrameRingBuffer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+#include "imgui.h"
+
+FrameRingBuffer::FrameRingBuffer(GLsizeiptr frameSize)
+	: frameSize(frameSize)
+{
+	GLint alignment = 0;
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	if (alignment > 0)
+	{
+		storageAlignment = alignment;
+	}
+
+	Create();
+}
+
+FrameRingBuffer::~FrameRingBuffer()
+{
+	DeleteFences();
+	for (size_t i = 0; i < retired.size(); i++)
+	{
+		glDeleteBuffers(1, &retired[i].buffer);
+	}
+
+	//Deleting the buffer unmaps it
+	glDeleteBuffers(1, &buffer);
+}
+
+void FrameRingBuffer::Create()
+{
+	//Coherent, so writes are visible to the GPU without flushing ranges
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glCreateBuffers(1, &buffer);
+	glNamedBufferStorage(buffer, frameSize * FRAME_COUNT, nullptr, flags);
+	mapping = (char*)glMapNamedBufferRange(buffer, 0, frameSize * FRAME_COUNT, flags);
+	if (mapping == nullptr)
+	{
+		printf("Frame ring buffer failed to map %d bytes\n", (int)(frameSize * FRAME_COUNT));
+	}
+}
+
+void FrameRingBuffer::DeleteFences()
+{
+	for (int i = 0; i < FRAME_COUNT; i++)
+	{
+		if (fences[i] != 0)
+		{
+			glDeleteSync(fences[i]);
+			fences[i] = 0;
+		}
+	}
+}
+
+void FrameRingBuffer::BeginFrame()
+{
+	frame = (frame + 1) % FRAME_COUNT;
+	frameOffset = 0;
+
+	//Only waits when the CPU is FRAME_COUNT frames ahead of the GPU
+	if (fences[frame] != 0)
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		GLenum result = glClientWaitSync(fences[frame], 0, 0);
+		if (result == GL_TIMEOUT_EXPIRED)
+		{
+			waits++;
+			glClientWaitSync(fences[frame], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+		}
+		lastWaitMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		glDeleteSync(fences[frame]);
+		fences[frame] = 0;
+	}
+}
+
+void FrameRingBuffer::EndFrame()
+{
+	fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	lastUsed = frameOffset;
+	peakUsed = std::max(peakUsed, frameOffset);
+
+	for (size_t i = 0; i < retired.size();)
+	{
+		if (--retired[i].framesLeft <= 0)
+		{
+			glDeleteBuffers(1, &retired[i].buffer);
+			retired.erase(retired.begin() + i);
+		}
+		else
+		{
+			i++;
+		}
+	}
+}
+
+FrameRingBuffer::Allocation FrameRingBuffer::Allocate(GLsizeiptr size, GLsizeiptr alignment)
+{
+	GLintptr start = (frameOffset + alignment - 1) & ~(alignment - 1);
+	if (start + size > frameSize)
+	{
+		//Ranges already bound this frame still point at the old buffer, so it stays alive until every frame that
+		//could be reading it has finished. The old fences guarded the old buffer, the new ring starts without any.
+		DeleteFences();
+
+		RetiredBuffer old;
+		old.buffer = buffer;
+		old.framesLeft = FRAME_COUNT + 1;
+		retired.push_back(old);
+
+		frameSize = std::max(frameSize * 2, size + alignment);
+		Create();
+		frameOffset = 0;
+		start = 0;
+	}
+
+	Allocation allocation;
+	allocation.buffer = buffer;
+	allocation.offset = frame * frameSize + start;
+	allocation.size = size;
+	allocation.data = mapping == nullptr ? nullptr : mapping + allocation.offset;
+
+	frameOffset = start + size;
+	return allocation;
+}
+
+FrameRingBuffer::Allocation FrameRingBuffer::AllocateStorage(GLsizeiptr size)
+{
+	return Allocate(std::max<GLsizeiptr>(size, 16), storageAlignment);
+}
+
+FrameRingBuffer::Allocation FrameRingBuffer::Upload(const void* data, GLsizeiptr size, GLsizeiptr alignment)
+{
+	Allocation allocation = Allocate(size, alignment);
+	if (allocation.data != nullptr && size > 0)
+	{
+		memcpy(allocation.data, data, size);
+	}
+	return allocation;
+}
+
+FrameRingBuffer::Allocation FrameRingBuffer::UploadStorage(const void* data, GLsizeiptr size)
+{
+	Allocation allocation = AllocateStorage(size);
+	if (allocation.data != nullptr && size > 0)
+	{
+		memcpy(allocation.data, data, size);
+	}
+	return allocation;
+}
+
+void FrameRingBuffer::BindRange(GLenum target, GLuint index, const Allocation& allocation)
+{
+	glBindBufferRange(target, index, allocation.buffer, allocation.offset, allocation.size);
+}
+
+void FrameRingBuffer::ExposeImGui()
+{
+	ImGui::Text("Frame ring: %.1f of %.1f KB used (peak %.1f KB)", lastUsed / 1024.f, frameSize / 1024.f, peakUsed / 1024.f);
+	ImGui::Text("Waited on the GPU %d times, last %.3f ms", waits, lastWaitMs);
+}
@@ -0,0 +1,78 @@
+#ifndef FRAME_RING_BUFFER_H
+#define FRAME_RING_BUFFER_H
+
+#include <vector>
+
+#include "GL/glew.h"
+
+//One persistently mapped buffer split into a slot per frame in flight. Per-frame data is written straight into the
+//mapping with a linear allocator and bound by range, and a fence on each slot keeps the CPU from writing over data
+//the GPU hasn't read yet, so uploads never make the driver synchronize or copy.
+class FrameRingBuffer
+{
+public:
+	static const int FRAME_COUNT = 3;
+
+	//Where an allocation landed, data points into the mapping. buffer can change between frames when the ring grows.
+	struct Allocation
+	{
+		void* data = nullptr;
+		GLuint buffer = 0;
+		GLintptr offset = 0;
+		GLsizeiptr size = 0;
+	};
+
+	FrameRingBuffer(GLsizeiptr frameSize);
+	~FrameRingBuffer();
+	FrameRingBuffer(const FrameRingBuffer&) = delete;
+	FrameRingBuffer& operator=(const FrameRingBuffer&) = delete;
+
+	//Waits for the GPU to be done with the oldest slot, then starts allocating from it
+	void BeginFrame();
+
+	//Fences the slot once every command reading it has been issued, call before swapping buffers
+	void EndFrame();
+
+	//alignment has to be a power of two. A frame that runs out of room moves to a ring twice the size.
+	Allocation Allocate(GLsizeiptr size, GLsizeiptr alignment);
+
+	//Aligned for storage buffer ranges, never empty so the range can always be bound
+	Allocation AllocateStorage(GLsizeiptr size);
+
+	//Copies size bytes in, for callers that already have the data in an array
+	Allocation Upload(const void* data, GLsizeiptr size, GLsizeiptr alignment);
+	Allocation UploadStorage(const void* data, GLsizeiptr size);
+
+	static void BindRange(GLenum target, GLuint index, const Allocation& allocation);
+
+	void ExposeImGui();
+
+private:
+	GLuint buffer = 0;
+	char* mapping = nullptr;
+	GLsizeiptr frameSize;
+	GLsizeiptr storageAlignment = 256;
+
+	GLsync fences[FRAME_COUNT] = {};
+	int frame = 0;
+	GLsizeiptr frameOffset = 0;
+
+	//Outgrown rings still bound or read by frames in flight, deleted once those frames are fenced
+	struct RetiredBuffer
+	{
+		GLuint buffer;
+		int framesLeft;
+	};
+	std::vector<RetiredBuffer> retired;
+
+	GLsizeiptr peakUsed = 0;
+	GLsizeiptr lastUsed = 0;
+	int waits = 0;
+	double lastWaitMs = 0;
+
+	void Create();
+	//Deletes and clears every frame's fence
+	void DeleteFences();
+};
+
+#endif
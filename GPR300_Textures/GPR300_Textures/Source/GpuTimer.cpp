@@ -0,0 +1,80 @@
+#include "GpuTimer.h"
+
+//Weight of each new measurement in the average
+static const double AVERAGE_WEIGHT = .1;
+
+GpuTimer::GpuTimer()
+{
+	glCreateQueries(GL_TIMESTAMP, QUERY_COUNT, startQueries);
+	glCreateQueries(GL_TIMESTAMP, QUERY_COUNT, endQueries);
+	for (int i = 0; i < QUERY_COUNT; i++)
+	{
+		pending[i] = false;
+	}
+}
+
+GpuTimer::~GpuTimer()
+{
+	glDeleteQueries(QUERY_COUNT, startQueries);
+	glDeleteQueries(QUERY_COUNT, endQueries);
+}
+
+void GpuTimer::CollectResults()
+{
+	//Oldest first, so the latest result ends up in lastMs
+	for (int offset = 1; offset <= QUERY_COUNT; offset++)
+	{
+		int i = (current + offset) % QUERY_COUNT;
+		if (!pending[i])
+		{
+			continue;
+		}
+
+		//The end stamp lands last
+		GLint available = 0;
+		glGetQueryObjectiv(endQueries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+		{
+			continue;
+		}
+
+		GLuint64 start = 0;
+		GLuint64 end = 0;
+		glGetQueryObjectui64v(startQueries[i], GL_QUERY_RESULT, &start);
+		glGetQueryObjectui64v(endQueries[i], GL_QUERY_RESULT, &end);
+		pending[i] = false;
+
+		lastMs = (end - start) / 1000000.0;
+		averageMs = hasResult ? averageMs + (lastMs - averageMs) * AVERAGE_WEIGHT : lastMs;
+		hasResult = true;
+	}
+}
+
+void GpuTimer::Begin()
+{
+	CollectResults();
+
+	//Every query is still in flight, skip this frame rather than wait on one
+	int next = (current + 1) % QUERY_COUNT;
+	if (pending[next])
+	{
+		timing = false;
+		return;
+	}
+
+	current = next;
+	glQueryCounter(startQueries[current], GL_TIMESTAMP);
+	timing = true;
+}
+
+void GpuTimer::End()
+{
+	if (!timing)
+	{
+		return;
+	}
+
+	glQueryCounter(endQueries[current], GL_TIMESTAMP);
+	pending[current] = true;
+	timing = false;
+}
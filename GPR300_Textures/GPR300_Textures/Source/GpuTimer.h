@@ -0,0 +1,38 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include "GL/glew.h"
+
+//Times a span of GPU work with a pair of GL_TIMESTAMP queries, so spans from different timers can nest.
+//Results are read a few frames late through a ring of queries, so reading them never stalls the pipeline.
+class GpuTimer
+{
+public:
+	GpuTimer();
+	~GpuTimer();
+
+	//Brackets the GL calls to time
+	void Begin();
+	void End();
+
+	//Latest finished measurement, and a smoothed average that is steadier to read or react to
+	double GetMilliseconds() const { return lastMs; }
+	double GetAverageMilliseconds() const { return averageMs; }
+
+private:
+	static const int QUERY_COUNT = 4;
+
+	GLuint startQueries[QUERY_COUNT];
+	GLuint endQueries[QUERY_COUNT];
+	bool pending[QUERY_COUNT];
+	int current = 0;
+	bool timing = false;
+
+	double lastMs = 0;
+	double averageMs = 0;
+	bool hasResult = false;
+
+	void CollectResults();
+};
+
+#endif
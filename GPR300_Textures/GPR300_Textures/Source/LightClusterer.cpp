@@ -0,0 +1,344 @@
+#include "LightClusterer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <emmintrin.h>
+
+#include "imgui.h"
+
+//Far enough that padded lanes never overlap a cluster, small enough that squaring it stays finite
+static const float PADDING_POSITION = 1e18f;
+
+LightClusterer::LightClusterer(ThreadPool* pool, FrameRingBuffer* ring) : threadPool(pool), frameRing(ring)
+{
+	clusterBounds.resize(CLUSTER_COUNT);
+	grid.resize(CLUSTER_COUNT);
+	slices.resize(CLUSTERS_Z);
+}
+
+void LightClusterer::BuildClusterBounds(Camera& camera)
+{
+	builtFov = camera.getFov();
+	builtAspect = camera.getAspectRatio();
+	builtNear = sliceNear;
+	builtFar = sliceFar;
+
+	float tanHalfFov = tanf(glm::radians(builtFov) * .5f);
+
+	for (int z = 0; z < CLUSTERS_Z; z++)
+	{
+		//Exponential slices, the outer two extend to the camera's own planes
+		float nearDepth = z == 0 ? cameraNear : sliceNear * powf(sliceFar / sliceNear, z / (float)CLUSTERS_Z);
+		float farDepth = z == CLUSTERS_Z - 1 ? cameraFar : sliceNear * powf(sliceFar / sliceNear, (z + 1) / (float)CLUSTERS_Z);
+
+		for (int y = 0; y < CLUSTERS_Y; y++)
+		{
+			float ndcY0 = -1.f + 2.f * y / CLUSTERS_Y;
+			float ndcY1 = -1.f + 2.f * (y + 1) / CLUSTERS_Y;
+
+			for (int x = 0; x < CLUSTERS_X; x++)
+			{
+				float ndcX0 = -1.f + 2.f * x / CLUSTERS_X;
+				float ndcX1 = -1.f + 2.f * (x + 1) / CLUSTERS_X;
+
+				ClusterBounds& bounds = clusterBounds[x + y * CLUSTERS_X + z * CLUSTERS_X * CLUSTERS_Y];
+				bounds.min = glm::vec3(INFINITY);
+				bounds.max = glm::vec3(-INFINITY);
+
+				//Corners of the tile on the slice's near and far planes, view space looks down -z
+				float depths[2] = { nearDepth, farDepth };
+				float ndcXs[2] = { ndcX0, ndcX1 };
+				float ndcYs[2] = { ndcY0, ndcY1 };
+				for (int d = 0; d < 2; d++)
+				{
+					for (int cx = 0; cx < 2; cx++)
+					{
+						for (int cy = 0; cy < 2; cy++)
+						{
+							glm::vec3 corner(ndcXs[cx] * depths[d] * tanHalfFov * builtAspect, ndcYs[cy] * depths[d] * tanHalfFov, -depths[d]);
+							bounds.min = glm::min(bounds.min, corner);
+							bounds.max = glm::max(bounds.max, corner);
+						}
+					}
+				}
+
+				bounds.center = (bounds.min + bounds.max) * .5f;
+				bounds.radius = glm::length(bounds.max - bounds.center);
+			}
+		}
+	}
+}
+
+void LightClusterer::Update(Camera& camera, const LightSystem& lights)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	cameraNear = camera.getNearPlane();
+	cameraFar = camera.getFarPlane();
+
+	if (camera.getFov() != builtFov || camera.getAspectRatio() != builtAspect || sliceNear != builtNear || sliceFar != builtFar)
+	{
+		BuildClusterBounds(camera);
+	}
+
+	glm::mat4 view = camera.getViewMatrix();
+
+	const std::vector<GPUPointLight>& gpuPointLights = lights.GetGPUPointLights();
+	const std::vector<GPUSpotLight>& gpuSpotLights = lights.GetGPUSpotlights();
+	int pointLightCount = (int)gpuPointLights.size();
+	int spotlightCount = (int)gpuSpotLights.size();
+
+	//Light volumes in view space
+	pointSpheres.resize(pointLightCount);
+	for (int i = 0; i < pointLightCount; i++)
+	{
+		const glm::vec4& posRadius = gpuPointLights[i].posRadius;
+		pointSpheres[i] = glm::vec4(glm::vec3(view * glm::vec4(glm::vec3(posRadius), 1)), posRadius.w);
+	}
+
+	spotSpheres.resize(spotlightCount);
+	spotCones.resize(spotlightCount);
+	for (int i = 0; i < spotlightCount; i++)
+	{
+		const GPUSpotLight& light = gpuSpotLights[i];
+
+		//The wider of the two angles has the smaller cosine
+		float outerAngle = acosf(glm::clamp(std::min(light.rangeAngles.y, light.rangeAngles.z), -1.f, 1.f));
+
+		spotSpheres[i] = glm::vec4(glm::vec3(view * glm::vec4(glm::vec3(light.posRadius), 1)), light.posRadius.w);
+		spotCones[i] = glm::vec4(glm::normalize(glm::vec3(view * glm::vec4(glm::vec3(light.dirFalloff), 0))), outerAngle);
+	}
+
+	//Each depth slice is independent, spread them over the workers
+	threadPool->ParallelFor(CLUSTERS_Z, [&](int slice) { AssignSlice(slice, pointLightCount, spotlightCount); });
+
+	//Stitch the per slice lists together
+	lightIndices.clear();
+	maxLightsPerCluster = 0;
+	for (int z = 0; z < CLUSTERS_Z; z++)
+	{
+		uint32_t base = (uint32_t)lightIndices.size();
+		lightIndices.insert(lightIndices.end(), slices[z].indices.begin(), slices[z].indices.end());
+
+		for (int i = 0; i < CLUSTERS_X * CLUSTERS_Y; i++)
+		{
+			glm::uvec4& cluster = grid[i + z * CLUSTERS_X * CLUSTERS_Y];
+			cluster.x += base;
+			cluster.z += base;
+			maxLightsPerCluster = std::max(maxLightsPerCluster, (int)(cluster.y + cluster.w));
+		}
+	}
+
+	Upload(lights);
+
+	lastUpdateMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void LightClusterer::AssignSlice(int slice, int pointCount, int spotCount)
+{
+	SliceScratch& scratch = slices[slice];
+	scratch.indices.clear();
+
+	const ClusterBounds& sliceBounds = clusterBounds[slice * CLUSTERS_X * CLUSTERS_Y];
+	float sliceMinZ = sliceBounds.min.z;
+	float sliceMaxZ = sliceBounds.max.z;
+
+	const __m128 zero = _mm_setzero_ps();
+
+	//Point lights overlapping this slice's depth range
+	scratch.x.clear(); scratch.y.clear(); scratch.z.clear(); scratch.radius.clear();
+	scratch.lightIndex.clear();
+	for (int i = 0; i < pointCount; i++)
+	{
+		const glm::vec4& sphere = pointSpheres[i];
+		if (sphere.z - sphere.w <= sliceMaxZ && sphere.z + sphere.w >= sliceMinZ)
+		{
+			scratch.x.push_back(sphere.x);
+			scratch.y.push_back(sphere.y);
+			scratch.z.push_back(sphere.z);
+			scratch.radius.push_back(sphere.w);
+			scratch.lightIndex.push_back((uint32_t)i);
+		}
+	}
+	int pointCandidates = (int)scratch.lightIndex.size();
+	while (scratch.x.size() % 4 != 0)
+	{
+		scratch.x.push_back(PADDING_POSITION);
+		scratch.y.push_back(PADDING_POSITION);
+		scratch.z.push_back(PADDING_POSITION);
+		scratch.radius.push_back(0);
+		scratch.lightIndex.push_back(0);
+	}
+	int paddedPoints = (int)scratch.x.size();
+
+	for (int tile = 0; tile < CLUSTERS_X * CLUSTERS_Y; tile++)
+	{
+		int clusterIndex = tile + slice * CLUSTERS_X * CLUSTERS_Y;
+		const ClusterBounds& bounds = clusterBounds[clusterIndex];
+		glm::uvec4& cluster = grid[clusterIndex];
+		cluster = glm::uvec4((uint32_t)scratch.indices.size(), 0, 0, 0);
+
+		if (pointCandidates == 0)
+		{
+			continue;
+		}
+
+		__m128 minX = _mm_set1_ps(bounds.min.x), minY = _mm_set1_ps(bounds.min.y), minZ = _mm_set1_ps(bounds.min.z);
+		__m128 maxX = _mm_set1_ps(bounds.max.x), maxY = _mm_set1_ps(bounds.max.y), maxZ = _mm_set1_ps(bounds.max.z);
+
+		//Sphere vs AABB, 4 lights at a time
+		for (int i = 0; i < paddedPoints; i += 4)
+		{
+			__m128 cx = _mm_loadu_ps(&scratch.x[i]);
+			__m128 cy = _mm_loadu_ps(&scratch.y[i]);
+			__m128 cz = _mm_loadu_ps(&scratch.z[i]);
+			__m128 r = _mm_loadu_ps(&scratch.radius[i]);
+
+			__m128 dx = _mm_add_ps(_mm_max_ps(_mm_sub_ps(minX, cx), zero), _mm_max_ps(_mm_sub_ps(cx, maxX), zero));
+			__m128 dy = _mm_add_ps(_mm_max_ps(_mm_sub_ps(minY, cy), zero), _mm_max_ps(_mm_sub_ps(cy, maxY), zero));
+			__m128 dz = _mm_add_ps(_mm_max_ps(_mm_sub_ps(minZ, cz), zero), _mm_max_ps(_mm_sub_ps(cz, maxZ), zero));
+			__m128 distSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+			int mask = _mm_movemask_ps(_mm_cmple_ps(distSq, _mm_mul_ps(r, r)));
+			for (int lane = 0; lane < 4; lane++)
+			{
+				if (mask & (1 << lane))
+				{
+					scratch.indices.push_back(scratch.lightIndex[i + lane]);
+				}
+			}
+		}
+
+		cluster.y = (uint32_t)scratch.indices.size() - cluster.x;
+	}
+
+	//Spotlights overlapping this slice's depth range
+	scratch.x.clear(); scratch.y.clear(); scratch.z.clear(); scratch.radius.clear();
+	scratch.dirX.clear(); scratch.dirY.clear(); scratch.dirZ.clear(); scratch.cosAngle.clear(); scratch.sinAngle.clear();
+	scratch.lightIndex.clear();
+	for (int i = 0; i < spotCount; i++)
+	{
+		const glm::vec4& sphere = spotSpheres[i];
+		if (sphere.z - sphere.w <= sliceMaxZ && sphere.z + sphere.w >= sliceMinZ)
+		{
+			const glm::vec4& cone = spotCones[i];
+			scratch.x.push_back(sphere.x);
+			scratch.y.push_back(sphere.y);
+			scratch.z.push_back(sphere.z);
+			scratch.radius.push_back(sphere.w);
+			scratch.dirX.push_back(cone.x);
+			scratch.dirY.push_back(cone.y);
+			scratch.dirZ.push_back(cone.z);
+			scratch.cosAngle.push_back(cosf(cone.w));
+			scratch.sinAngle.push_back(sinf(cone.w));
+			scratch.lightIndex.push_back((uint32_t)i);
+		}
+	}
+	int spotCandidates = (int)scratch.lightIndex.size();
+	while (scratch.x.size() % 4 != 0)
+	{
+		scratch.x.push_back(PADDING_POSITION);
+		scratch.y.push_back(PADDING_POSITION);
+		scratch.z.push_back(PADDING_POSITION);
+		scratch.radius.push_back(0);
+		scratch.dirX.push_back(0);
+		scratch.dirY.push_back(-1);
+		scratch.dirZ.push_back(0);
+		scratch.cosAngle.push_back(1);
+		scratch.sinAngle.push_back(0);
+		scratch.lightIndex.push_back(0);
+	}
+	int paddedSpots = (int)scratch.x.size();
+
+	for (int tile = 0; tile < CLUSTERS_X * CLUSTERS_Y; tile++)
+	{
+		int clusterIndex = tile + slice * CLUSTERS_X * CLUSTERS_Y;
+		const ClusterBounds& bounds = clusterBounds[clusterIndex];
+		glm::uvec4& cluster = grid[clusterIndex];
+		cluster.z = (uint32_t)scratch.indices.size();
+
+		if (spotCandidates == 0)
+		{
+			continue;
+		}
+
+		__m128 centerX = _mm_set1_ps(bounds.center.x), centerY = _mm_set1_ps(bounds.center.y), centerZ = _mm_set1_ps(bounds.center.z);
+		__m128 clusterRadius = _mm_set1_ps(bounds.radius);
+
+		//Cone vs the cluster's bounding sphere, 4 lights at a time
+		for (int i = 0; i < paddedSpots; i += 4)
+		{
+			__m128 vx = _mm_sub_ps(centerX, _mm_loadu_ps(&scratch.x[i]));
+			__m128 vy = _mm_sub_ps(centerY, _mm_loadu_ps(&scratch.y[i]));
+			__m128 vz = _mm_sub_ps(centerZ, _mm_loadu_ps(&scratch.z[i]));
+			__m128 range = _mm_loadu_ps(&scratch.radius[i]);
+
+			__m128 lengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz));
+			__m128 alongAxis = _mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(vx, _mm_loadu_ps(&scratch.dirX[i])),
+				_mm_mul_ps(vy, _mm_loadu_ps(&scratch.dirY[i]))),
+				_mm_mul_ps(vz, _mm_loadu_ps(&scratch.dirZ[i])));
+
+			//Distance from the sphere center to the cone's surface
+			__m128 fromAxis = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(lengthSq, _mm_mul_ps(alongAxis, alongAxis)), zero));
+			__m128 closest = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(&scratch.cosAngle[i]), fromAxis), _mm_mul_ps(alongAxis, _mm_loadu_ps(&scratch.sinAngle[i])));
+
+			__m128 reach = _mm_add_ps(range, clusterRadius);
+			__m128 culled = _mm_or_ps(
+				_mm_or_ps(_mm_cmpgt_ps(closest, clusterRadius), _mm_cmpgt_ps(lengthSq, _mm_mul_ps(reach, reach))),
+				_mm_cmplt_ps(alongAxis, _mm_sub_ps(zero, clusterRadius)));
+
+			//The cone's apex sits inside the cluster, the angle test above can't be trusted there
+			__m128 containsApex = _mm_cmple_ps(lengthSq, _mm_mul_ps(clusterRadius, clusterRadius));
+			culled = _mm_andnot_ps(containsApex, culled);
+
+			int mask = ~_mm_movemask_ps(culled) & 0xF;
+			for (int lane = 0; lane < 4; lane++)
+			{
+				if (mask & (1 << lane))
+				{
+					scratch.indices.push_back(scratch.lightIndex[i + lane]);
+				}
+			}
+		}
+
+		cluster.w = (uint32_t)scratch.indices.size() - cluster.z;
+	}
+}
+
+void LightClusterer::Upload(const LightSystem& lights)
+{
+	const std::vector<GPUPointLight>& gpuPointLights = lights.GetGPUPointLights();
+	const std::vector<GPUSpotLight>& gpuSpotLights = lights.GetGPUSpotlights();
+
+	//Fresh ranges of the ring every frame, so nothing waits on last frame's reads. Empty arrays still get a bindable range.
+	allocations[CLUSTER_POINT_LIGHT_BINDING] = frameRing->UploadStorage(gpuPointLights.data(), gpuPointLights.size() * sizeof(GPUPointLight));
+	allocations[CLUSTER_SPOTLIGHT_BINDING] = frameRing->UploadStorage(gpuSpotLights.data(), gpuSpotLights.size() * sizeof(GPUSpotLight));
+	allocations[CLUSTER_GRID_BINDING] = frameRing->UploadStorage(grid.data(), grid.size() * sizeof(glm::uvec4));
+	allocations[CLUSTER_INDEX_BINDING] = frameRing->UploadStorage(lightIndices.data(), lightIndices.size() * sizeof(uint32_t));
+}
+
+void LightClusterer::Bind(Shader& shader, int screenWidth, int screenHeight)
+{
+	for (GLuint i = 0; i < 4; i++)
+	{
+		FrameRingBuffer::BindRange(GL_SHADER_STORAGE_BUFFER, i, allocations[i]);
+	}
+
+	//slice = log(depth) * scale + bias, matching BuildClusterBounds
+	float logRange = logf(sliceFar / sliceNear);
+	shader.setVec2("_ClusterTileSize", glm::vec2(screenWidth / (float)CLUSTERS_X, screenHeight / (float)CLUSTERS_Y));
+	shader.setFloat("_ClusterScale", CLUSTERS_Z / logRange);
+	shader.setFloat("_ClusterBias", -CLUSTERS_Z * logf(sliceNear) / logRange);
+}
+
+void LightClusterer::ExposeImGui()
+{
+	ImGui::SliderFloat("Cluster Slice Near", &sliceNear, .01f, 10.f);
+	ImGui::SliderFloat("Cluster Slice Far", &sliceFar, sliceNear + 1.f, 1000.f);
+
+	ImGui::Text("Clusters: %dx%dx%d", CLUSTERS_X, CLUSTERS_Y, CLUSTERS_Z);
+	ImGui::Text("Light indices: %d, max per cluster: %d", (int)lightIndices.size(), maxLightsPerCluster);
+	ImGui::Text("CPU assignment: %.3f ms on %d threads", lastUpdateMs, threadPool->GetThreadCount());
+}
@@ -0,0 +1,95 @@
+#ifndef LIGHT_CLUSTERER_H
+#define LIGHT_CLUSTERER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "GL/glew.h"
+#include "glm/glm.hpp"
+
+#include "Camera.h"
+#include "Shader.h"
+#include "LightSystem.h"
+#include "ThreadPool.h"
+#include "FrameRingBuffer.h"
+
+//Storage buffer bindings shared with defaultLit.frag
+const GLuint CLUSTER_POINT_LIGHT_BINDING = 0;
+const GLuint CLUSTER_SPOTLIGHT_BINDING = 1;
+const GLuint CLUSTER_GRID_BINDING = 2;
+const GLuint CLUSTER_INDEX_BINDING = 3;
+
+//Splits the view frustum into a froxel grid and lists which point lights and spotlights touch each cell
+class LightClusterer
+{
+public:
+	//Grid resolution, x and y in screen tiles and z in exponential depth slices
+	static const int CLUSTERS_X = 16;
+	static const int CLUSTERS_Y = 9;
+	static const int CLUSTERS_Z = 24;
+	static const int CLUSTER_COUNT = CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z;
+
+	//Depth range the slices are spread across, the first and last slice stretch to the camera planes
+	float sliceNear = .1f;
+	float sliceFar = 100.f;
+
+	LightClusterer(ThreadPool* pool, FrameRingBuffer* ring);
+
+	//Reads the packed lights, call after LightSystem::Pack so the radii are current
+	void Update(Camera& camera, const LightSystem& lights);
+
+	//Binds the storage buffers and sets the uniforms defaultLit.frag needs to find its cluster
+	void Bind(Shader& shader, int screenWidth, int screenHeight);
+
+	void ExposeImGui();
+
+private:
+	struct ClusterBounds
+	{
+		glm::vec3 min;
+		glm::vec3 max;
+		glm::vec3 center;
+		float radius;
+	};
+
+	//Candidate lights of one slice, view space, structure of arrays padded to a multiple of 4
+	struct SliceScratch
+	{
+		std::vector<float> x, y, z, radius;
+		std::vector<float> dirX, dirY, dirZ, cosAngle, sinAngle;
+		std::vector<uint32_t> lightIndex;
+
+		std::vector<uint32_t> indices;
+		int spotStart = 0;
+	};
+
+	ThreadPool* threadPool;
+
+	std::vector<ClusterBounds> clusterBounds;
+	float builtFov = -1.f, builtAspect = -1.f, builtNear = -1.f, builtFar = -1.f;
+
+	//View space light volumes
+	std::vector<glm::vec4> pointSpheres;
+	std::vector<glm::vec4> spotSpheres;
+	std::vector<glm::vec4> spotCones;	//direction, outer angle
+
+	std::vector<SliceScratch> slices;
+
+	std::vector<glm::uvec4> grid;	//point offset, point count, spot offset, spot count
+	std::vector<uint32_t> lightIndices;
+
+	//This frame's ranges of the ring, indexed by binding
+	FrameRingBuffer* frameRing;
+	FrameRingBuffer::Allocation allocations[4];
+
+	float cameraNear = .001f;
+	float cameraFar = 1000.f;
+	int maxLightsPerCluster = 0;
+	double lastUpdateMs = 0;
+
+	void BuildClusterBounds(Camera& camera);
+	void AssignSlice(int slice, int pointCount, int spotCount);
+	void Upload(const LightSystem& lights);
+};
+
+#endif
@@ -0,0 +1,445 @@
+#include "LightSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "imgui.h"
+
+#include "SimdMath.h"
+
+static const float TWO_PI = 6.28318530718f;
+static const float DEG_TO_RAD = 0.0174532925f;
+
+//Room for the kernels to run over whole groups of 4 without a scalar tail
+static int PadToLanes(int count)
+{
+	return (count + 3) & ~3;
+}
+
+static void ResizeArrays(std::vector<float>* arrays[], int arrayCount, int size, float value)
+{
+	for (int i = 0; i < arrayCount; i++)
+	{
+		arrays[i]->resize(size, value);
+	}
+}
+
+//Bumps the version of every lane whose bit is set in changedMask, lanes past count are padding
+static void BumpVersions(std::vector<unsigned int>& versions, int i, int count, int changedMask)
+{
+	for (int lane = 0; lane < 4 && i + lane < count; lane++)
+	{
+		if (changedMask & (1 << lane))
+		{
+			versions[i + lane]++;
+		}
+	}
+}
+
+//Stores value over the 4 floats at destination and reports which lanes differed
+static int StoreChanged(float* destination, __m128 value)
+{
+	int changed = _mm_movemask_ps(_mm_cmpneq_ps(_mm_loadu_ps(destination), value));
+	_mm_storeu_ps(destination, value);
+	return changed;
+}
+
+static double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+//Light index of each lane as an angle around the circle
+static __m128 LaneAngles(int i, float step)
+{
+	return _mm_mul_ps(_mm_add_ps(_mm_set1_ps((float)i), _mm_set_ps(3.f, 2.f, 1.f, 0.f)), _mm_set1_ps(step));
+}
+
+LightSystem::LightSystem(int maxPointLights, int maxSpotlights, int maxDirectionalLights)
+	: maxPointLights(maxPointLights), maxSpotlights(maxSpotlights), maxDirectionalLights(maxDirectionalLights)
+{
+	PointLight defaultPoint;
+	SpotLight defaultSpot;
+	DirectionalLight defaultDirectional;
+
+	int paddedPoints = PadToLanes(maxPointLights);
+	std::vector<float>* pointArrays[] = { &points.posX, &points.posY, &points.posZ, &points.colorR, &points.colorG, &points.colorB, &points.intensity };
+	ResizeArrays(pointArrays, 7, paddedPoints, 0.f);
+
+	int paddedSpots = PadToLanes(maxSpotlights);
+	std::vector<float>* spotArrays[] = { &spots.posX, &spots.posY, &spots.posZ, &spots.dirX, &spots.dirY, &spots.dirZ, &spots.colorR, &spots.colorG, &spots.colorB,
+		&spots.intensity, &spots.range, &spots.innerAngle, &spots.outerAngle, &spots.angleFalloff };
+	ResizeArrays(spotArrays, 14, paddedSpots, 0.f);
+
+	int paddedDirectionals = PadToLanes(maxDirectionalLights);
+	std::vector<float>* directionalArrays[] = { &directionals.dirX, &directionals.dirY, &directionals.dirZ, &directionals.colorR, &directionals.colorG, &directionals.colorB, &directionals.intensity };
+	ResizeArrays(directionalArrays, 7, paddedDirectionals, 0.f);
+
+	spotVersions.resize(paddedSpots, 0);
+	directionalVersions.resize(paddedDirectionals, 0);
+
+	//Padding lanes keep the defaults too so nothing in them divides by zero
+	for (int i = 0; i < paddedPoints; i++)
+	{
+		SetPointLight(i, defaultPoint);
+	}
+	for (int i = 0; i < paddedSpots; i++)
+	{
+		SetSpotlight(i, defaultSpot);
+	}
+	for (int i = 0; i < paddedDirectionals; i++)
+	{
+		SetDirectionalLight(i, defaultDirectional);
+	}
+}
+
+PointLight LightSystem::GetPointLight(int i) const
+{
+	PointLight light;
+	light.pos = glm::vec3(points.posX[i], points.posY[i], points.posZ[i]);
+	light.color = glm::vec3(points.colorR[i], points.colorG[i], points.colorB[i]);
+	light.intensity = points.intensity[i];
+	return light;
+}
+
+void LightSystem::SetPointLight(int i, const PointLight& light)
+{
+	points.posX[i] = light.pos.x;
+	points.posY[i] = light.pos.y;
+	points.posZ[i] = light.pos.z;
+	points.colorR[i] = light.color.r;
+	points.colorG[i] = light.color.g;
+	points.colorB[i] = light.color.b;
+	points.intensity[i] = light.intensity;
+}
+
+SpotLight LightSystem::GetSpotlight(int i) const
+{
+	SpotLight light;
+	light.pos = glm::vec3(spots.posX[i], spots.posY[i], spots.posZ[i]);
+	light.dir = glm::vec3(spots.dirX[i], spots.dirY[i], spots.dirZ[i]);
+	light.color = glm::vec3(spots.colorR[i], spots.colorG[i], spots.colorB[i]);
+	light.intensity = spots.intensity[i];
+	light.range = spots.range[i];
+	light.innerAngle = spots.innerAngle[i];
+	light.outerAngle = spots.outerAngle[i];
+	light.angleFalloff = spots.angleFalloff[i];
+	return light;
+}
+
+void LightSystem::SetSpotlight(int i, const SpotLight& light)
+{
+	SpotLight old = GetSpotlight(i);
+	if (old.pos != light.pos || old.dir != light.dir || old.color != light.color || old.intensity != light.intensity || old.range != light.range
+		|| old.innerAngle != light.innerAngle || old.outerAngle != light.outerAngle || old.angleFalloff != light.angleFalloff)
+	{
+		spotVersions[i]++;
+	}
+
+	spots.posX[i] = light.pos.x;
+	spots.posY[i] = light.pos.y;
+	spots.posZ[i] = light.pos.z;
+	spots.dirX[i] = light.dir.x;
+	spots.dirY[i] = light.dir.y;
+	spots.dirZ[i] = light.dir.z;
+	spots.colorR[i] = light.color.r;
+	spots.colorG[i] = light.color.g;
+	spots.colorB[i] = light.color.b;
+	spots.intensity[i] = light.intensity;
+	spots.range[i] = light.range;
+	spots.innerAngle[i] = light.innerAngle;
+	spots.outerAngle[i] = light.outerAngle;
+	spots.angleFalloff[i] = light.angleFalloff;
+}
+
+DirectionalLight LightSystem::GetDirectionalLight(int i) const
+{
+	DirectionalLight light;
+	light.dir = glm::vec3(directionals.dirX[i], directionals.dirY[i], directionals.dirZ[i]);
+	light.color = glm::vec3(directionals.colorR[i], directionals.colorG[i], directionals.colorB[i]);
+	light.intensity = directionals.intensity[i];
+	return light;
+}
+
+void LightSystem::SetDirectionalLight(int i, const DirectionalLight& light)
+{
+	DirectionalLight old = GetDirectionalLight(i);
+	if (old.dir != light.dir || old.color != light.color || old.intensity != light.intensity)
+	{
+		directionalVersions[i]++;
+	}
+
+	directionals.dirX[i] = light.dir.x;
+	directionals.dirY[i] = light.dir.y;
+	directionals.dirZ[i] = light.dir.z;
+	directionals.colorR[i] = light.color.r;
+	directionals.colorG[i] = light.color.g;
+	directionals.colorB[i] = light.color.b;
+	directionals.intensity[i] = light.intensity;
+}
+
+void LightSystem::ArrangePointLights(float radius, float height)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	float step = pointLightCount > 0 ? TWO_PI / pointLightCount : 0.f;
+	__m128 radius4 = _mm_set1_ps(radius);
+	__m128 height4 = _mm_set1_ps(height);
+
+	for (int i = 0; i < pointLightCount; i += 4)
+	{
+		__m128 sin4, cos4;
+		SinCos4(LaneAngles(i, step), &sin4, &cos4);
+
+		_mm_storeu_ps(&points.posX[i], _mm_mul_ps(radius4, cos4));
+		_mm_storeu_ps(&points.posY[i], height4);
+		_mm_storeu_ps(&points.posZ[i], _mm_mul_ps(radius4, sin4));
+	}
+
+	arrangeMs += MillisecondsSince(start);
+}
+
+void LightSystem::ArrangeSpotlights(float radius, float height, float angle)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	float step = spotlightCount > 0 ? TWO_PI / spotlightCount : 0.f;
+	__m128 radius4 = _mm_set1_ps(radius);
+	__m128 height4 = _mm_set1_ps(height);
+	__m128 tilt4 = _mm_set1_ps(sinf(-angle * DEG_TO_RAD));
+	__m128 down4 = _mm_set1_ps(-1.f);
+
+	for (int i = 0; i < spotlightCount; i += 4)
+	{
+		__m128 sin4, cos4;
+		SinCos4(LaneAngles(i, step), &sin4, &cos4);
+
+		int changed = StoreChanged(&spots.posX[i], _mm_mul_ps(radius4, cos4));
+		changed |= StoreChanged(&spots.posY[i], height4);
+		changed |= StoreChanged(&spots.posZ[i], _mm_mul_ps(radius4, sin4));
+
+		changed |= StoreChanged(&spots.dirX[i], _mm_mul_ps(cos4, tilt4));
+		changed |= StoreChanged(&spots.dirY[i], down4);
+		changed |= StoreChanged(&spots.dirZ[i], _mm_mul_ps(sin4, tilt4));
+		BumpVersions(spotVersions, i, spotlightCount, changed);
+	}
+
+	arrangeMs += MillisecondsSince(start);
+}
+
+void LightSystem::ArrangeDirectionalLights(float angle)
+{
+	float step = directionalLightCount > 0 ? TWO_PI / directionalLightCount : 0.f;
+	__m128 tilt4 = _mm_set1_ps(sinf(-angle * DEG_TO_RAD));
+	__m128 up4 = _mm_set1_ps(1.f);
+
+	for (int i = 0; i < directionalLightCount; i += 4)
+	{
+		__m128 sin4, cos4;
+		SinCos4(LaneAngles(i, step), &sin4, &cos4);
+
+		int changed = StoreChanged(&directionals.dirX[i], _mm_mul_ps(cos4, tilt4));
+		changed |= StoreChanged(&directionals.dirY[i], up4);
+		changed |= StoreChanged(&directionals.dirZ[i], _mm_mul_ps(sin4, tilt4));
+		BumpVersions(directionalVersions, i, directionalLightCount, changed);
+	}
+}
+
+void LightSystem::Pack(const Attenuation& attenuation, float cutoff)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	//A purely linear falloff has no quadratic to solve, that rare case doesn't need to be fast
+	if (attenuation.quadratic <= 0.f)
+	{
+		PackScalar(attenuation, cutoff);
+		lastPackMs = MillisecondsSince(start);
+		lastArrangeMs = arrangeMs;
+		arrangeMs = 0;
+		return;
+	}
+
+	gpuPointLights.resize(pointLightCount);
+	gpuSpotLights.resize(spotlightCount);
+
+	//Radius solves quadratic * d^2 + linear * d + constant = brightness / cutoff, as in Attenuation::GetRadius
+	const __m128 zero = _mm_setzero_ps();
+	__m128 constant4 = _mm_set1_ps(attenuation.constant);
+	__m128 linearSq4 = _mm_set1_ps(attenuation.linear * attenuation.linear);
+	__m128 negLinear4 = _mm_set1_ps(-attenuation.linear);
+	__m128 fourQuadratic4 = _mm_set1_ps(4.f * attenuation.quadratic);
+	__m128 invTwoQuadratic4 = _mm_set1_ps(1.f / (2.f * attenuation.quadratic));
+	__m128 invCutoff4 = _mm_set1_ps(1.f / cutoff);
+
+	float radius[4];
+	for (int i = 0; i < pointLightCount; i += 4)
+	{
+		__m128 brightest = _mm_max_ps(_mm_loadu_ps(&points.colorR[i]), _mm_max_ps(_mm_loadu_ps(&points.colorG[i]), _mm_loadu_ps(&points.colorB[i])));
+		__m128 target = _mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(&points.intensity[i]), brightest), invCutoff4);
+		__m128 discriminant = _mm_add_ps(linearSq4, _mm_mul_ps(fourQuadratic4, _mm_sub_ps(target, constant4)));
+		__m128 radius4 = _mm_mul_ps(_mm_add_ps(negLinear4, _mm_sqrt_ps(_mm_max_ps(discriminant, zero))), invTwoQuadratic4);
+		_mm_storeu_ps(radius, _mm_and_ps(radius4, _mm_cmpgt_ps(target, constant4)));
+
+		int lanes = std::min(4, pointLightCount - i);
+		for (int lane = 0; lane < lanes; lane++)
+		{
+			int light = i + lane;
+			gpuPointLights[light].posRadius = glm::vec4(points.posX[light], points.posY[light], points.posZ[light], radius[lane]);
+			gpuPointLights[light].colorIntensity = glm::vec4(points.colorR[light], points.colorG[light], points.colorB[light], points.intensity[light]);
+		}
+	}
+
+	const __m128 degToRad4 = _mm_set1_ps(DEG_TO_RAD);
+	float dirX[4], dirY[4], dirZ[4], cosInner[4], cosOuter[4];
+	for (int i = 0; i < spotlightCount; i += 4)
+	{
+		__m128 brightest = _mm_max_ps(_mm_loadu_ps(&spots.colorR[i]), _mm_max_ps(_mm_loadu_ps(&spots.colorG[i]), _mm_loadu_ps(&spots.colorB[i])));
+		__m128 target = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(&spots.intensity[i]), _mm_loadu_ps(&spots.range[i])), brightest), invCutoff4);
+		__m128 discriminant = _mm_add_ps(linearSq4, _mm_mul_ps(fourQuadratic4, _mm_sub_ps(target, constant4)));
+		__m128 radius4 = _mm_mul_ps(_mm_add_ps(negLinear4, _mm_sqrt_ps(_mm_max_ps(discriminant, zero))), invTwoQuadratic4);
+		_mm_storeu_ps(radius, _mm_and_ps(radius4, _mm_cmpgt_ps(target, constant4)));
+
+		__m128 x = _mm_loadu_ps(&spots.dirX[i]);
+		__m128 y = _mm_loadu_ps(&spots.dirY[i]);
+		__m128 z = _mm_loadu_ps(&spots.dirZ[i]);
+		__m128 invLength = _mm_div_ps(_mm_set1_ps(1.f), _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z))));
+		_mm_storeu_ps(dirX, _mm_mul_ps(x, invLength));
+		_mm_storeu_ps(dirY, _mm_mul_ps(y, invLength));
+		_mm_storeu_ps(dirZ, _mm_mul_ps(z, invLength));
+
+		__m128 unusedSin, cos4;
+		SinCos4(_mm_mul_ps(_mm_loadu_ps(&spots.innerAngle[i]), degToRad4), &unusedSin, &cos4);
+		_mm_storeu_ps(cosInner, cos4);
+		SinCos4(_mm_mul_ps(_mm_loadu_ps(&spots.outerAngle[i]), degToRad4), &unusedSin, &cos4);
+		_mm_storeu_ps(cosOuter, cos4);
+
+		int lanes = std::min(4, spotlightCount - i);
+		for (int lane = 0; lane < lanes; lane++)
+		{
+			int light = i + lane;
+			GPUSpotLight& gpu = gpuSpotLights[light];
+			gpu.posRadius = glm::vec4(spots.posX[light], spots.posY[light], spots.posZ[light], radius[lane]);
+			gpu.dirFalloff = glm::vec4(dirX[lane], dirY[lane], dirZ[lane], spots.angleFalloff[light]);
+			gpu.colorIntensity = glm::vec4(spots.colorR[light], spots.colorG[light], spots.colorB[light], spots.intensity[light]);
+			gpu.rangeAngles = glm::vec4(spots.range[light], cosInner[lane], cosOuter[lane], 0);
+		}
+	}
+
+	lastPackMs = MillisecondsSince(start);
+	lastArrangeMs = arrangeMs;
+	arrangeMs = 0;
+}
+
+void LightSystem::ArrangePointLightsScalar(float radius, float height)
+{
+	for (int i = 0; i < pointLightCount; i++)
+	{
+		PointLight light = GetPointLight(i);
+		light.pos.x = radius * cosf(TWO_PI * (i / (float)pointLightCount));
+		light.pos.y = height;
+		light.pos.z = radius * sinf(TWO_PI * (i / (float)pointLightCount));
+		SetPointLight(i, light);
+	}
+}
+
+void LightSystem::ArrangeSpotlightsScalar(float radius, float height, float angle)
+{
+	for (int i = 0; i < spotlightCount; i++)
+	{
+		SpotLight light = GetSpotlight(i);
+		light.pos.x = radius * cosf(TWO_PI * (i / (float)spotlightCount));
+		light.pos.y = height;
+		light.pos.z = radius * sinf(TWO_PI * (i / (float)spotlightCount));
+		light.dir = glm::vec3(
+			cosf(TWO_PI * (i / (float)spotlightCount)) * sinf(-angle * DEG_TO_RAD),
+			-1,
+			sinf(TWO_PI * (i / (float)spotlightCount)) * sinf(-angle * DEG_TO_RAD)
+		);
+		SetSpotlight(i, light);
+	}
+}
+
+void LightSystem::PackScalar(const Attenuation& attenuation, float cutoff)
+{
+	gpuPointLights.resize(pointLightCount);
+	for (int i = 0; i < pointLightCount; i++)
+	{
+		PointLight light = GetPointLight(i);
+		gpuPointLights[i].posRadius = glm::vec4(light.pos, light.GetRadius(attenuation, cutoff));
+		gpuPointLights[i].colorIntensity = glm::vec4(light.color, light.intensity);
+	}
+
+	gpuSpotLights.resize(spotlightCount);
+	for (int i = 0; i < spotlightCount; i++)
+	{
+		SpotLight light = GetSpotlight(i);
+		gpuSpotLights[i].posRadius = glm::vec4(light.pos, light.GetRadius(attenuation, cutoff));
+		gpuSpotLights[i].dirFalloff = glm::vec4(glm::normalize(light.dir), light.angleFalloff);
+		gpuSpotLights[i].colorIntensity = glm::vec4(light.color, light.intensity);
+		gpuSpotLights[i].rangeAngles = glm::vec4(light.range, cosf(light.innerAngle * DEG_TO_RAD), cosf(light.outerAngle * DEG_TO_RAD), 0);
+	}
+}
+
+LightSystem::BenchmarkResult LightSystem::RunBenchmark(int lightCount, int iterations)
+{
+	LightSystem system(lightCount, lightCount, 0);
+	system.pointLightCount = lightCount;
+	system.spotlightCount = lightCount;
+
+	Attenuation attenuation;
+	float cutoff = 1.f / 256.f;
+
+	BenchmarkResult result;
+	result.lightCount = lightCount;
+	result.iterations = iterations;
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < iterations; i++)
+	{
+		system.ArrangePointLightsScalar(5.f + i, 5.f);
+		system.ArrangeSpotlightsScalar(5.f + i, 5.f, 10.f);
+	}
+	result.scalarArrangeMs = MillisecondsSince(start) / iterations;
+
+	start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < iterations; i++)
+	{
+		system.ArrangePointLights(5.f + i, 5.f);
+		system.ArrangeSpotlights(5.f + i, 5.f, 10.f);
+	}
+	result.batchArrangeMs = MillisecondsSince(start) / iterations;
+
+	start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < iterations; i++)
+	{
+		system.PackScalar(attenuation, cutoff);
+	}
+	result.scalarPackMs = MillisecondsSince(start) / iterations;
+
+	start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < iterations; i++)
+	{
+		system.Pack(attenuation, cutoff);
+	}
+	result.batchPackMs = MillisecondsSince(start) / iterations;
+
+	return result;
+}
+
+void LightSystem::ExposeImGui()
+{
+	ImGui::Text("Light arrange: %.3f ms, pack: %.3f ms", lastArrangeMs, lastPackMs);
+
+	if (ImGui::Button("Benchmark 16384 Lights"))
+	{
+		lastBenchmark = RunBenchmark(16384, 100);
+	}
+
+	if (lastBenchmark.lightCount > 0)
+	{
+		ImGui::Text("%d point lights + %d spotlights, average of %d runs", lastBenchmark.lightCount, lastBenchmark.lightCount, lastBenchmark.iterations);
+		ImGui::Text("Arrange: %.3f ms scalar, %.3f ms batched", lastBenchmark.scalarArrangeMs, lastBenchmark.batchArrangeMs);
+		ImGui::Text("Pack: %.3f ms scalar, %.3f ms batched", lastBenchmark.scalarPackMs, lastBenchmark.batchPackMs);
+	}
+}
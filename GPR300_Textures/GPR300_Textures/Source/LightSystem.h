@@ -0,0 +1,134 @@
+#ifndef LIGHT_SYSTEM_H
+#define LIGHT_SYSTEM_H
+
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "Attenuation.h"
+#include "PointLight.h"
+#include "DirectionalLight.h"
+#include "SpotLight.h"
+
+//std430 layouts of the light storage buffers
+struct GPUPointLight
+{
+	glm::vec4 posRadius;
+	glm::vec4 colorIntensity;
+};
+
+struct GPUSpotLight
+{
+	glm::vec4 posRadius;
+	glm::vec4 dirFalloff;
+	glm::vec4 colorIntensity;
+	glm::vec4 rangeAngles;	//range, cos inner angle, cos outer angle, unused
+};
+
+//Every light in the scene stored as structure of arrays, so per frame work runs over 4 lights at a time
+//The PointLight/SpotLight/DirectionalLight structs are only used to copy single lights in and out for editing
+class LightSystem
+{
+public:
+	struct PointLightArrays
+	{
+		std::vector<float> posX, posY, posZ;
+		std::vector<float> colorR, colorG, colorB;
+		std::vector<float> intensity;
+	};
+
+	struct SpotLightArrays
+	{
+		std::vector<float> posX, posY, posZ;
+		std::vector<float> dirX, dirY, dirZ;
+		std::vector<float> colorR, colorG, colorB;
+		std::vector<float> intensity;
+		std::vector<float> range, innerAngle, outerAngle, angleFalloff;
+	};
+
+	struct DirectionalLightArrays
+	{
+		std::vector<float> dirX, dirY, dirZ;
+		std::vector<float> colorR, colorG, colorB;
+		std::vector<float> intensity;
+	};
+
+	//Timings of the batch kernels against a light by light loop over the same data
+	struct BenchmarkResult
+	{
+		int lightCount = 0;
+		int iterations = 0;
+		double scalarArrangeMs = 0, batchArrangeMs = 0;
+		double scalarPackMs = 0, batchPackMs = 0;
+	};
+
+	int pointLightCount = 0;
+	int spotlightCount = 0;
+	int directionalLightCount = 0;
+
+	LightSystem(int maxPointLights, int maxSpotlights, int maxDirectionalLights);
+
+	int GetMaxPointLights() const { return maxPointLights; }
+	int GetMaxSpotlights() const { return maxSpotlights; }
+	int GetMaxDirectionalLights() const { return maxDirectionalLights; }
+
+	PointLight GetPointLight(int i) const;
+	void SetPointLight(int i, const PointLight& light);
+	SpotLight GetSpotlight(int i) const;
+	void SetSpotlight(int i, const SpotLight& light);
+	DirectionalLight GetDirectionalLight(int i) const;
+	void SetDirectionalLight(int i, const DirectionalLight& light);
+
+	//Go up whenever anything about the light changed, through Set* or the arrange kernels, so shadow maps know to re-render
+	unsigned int GetSpotlightVersion(int i) const { return spotVersions[i]; }
+	unsigned int GetDirectionalLightVersion(int i) const { return directionalVersions[i]; }
+
+	const PointLightArrays& GetPointLights() const { return points; }
+	const SpotLightArrays& GetSpotlights() const { return spots; }
+	const DirectionalLightArrays& GetDirectionalLights() const { return directionals; }
+
+	//Spread the lights evenly around a circle, angles are in degrees, 0 points straight down (or up for directional lights) and + tilts towards the center
+	void ArrangePointLights(float radius, float height);
+	void ArrangeSpotlights(float radius, float height, float angle);
+	void ArrangeDirectionalLights(float angle);
+
+	//Rebuilds the storage buffer layouts of every point light and spotlight, radii come from attenuation and cutoff
+	void Pack(const Attenuation& attenuation, float cutoff);
+
+	//Valid after Pack, one entry per light
+	const std::vector<GPUPointLight>& GetGPUPointLights() const { return gpuPointLights; }
+	const std::vector<GPUSpotLight>& GetGPUSpotlights() const { return gpuSpotLights; }
+
+	//Runs the arrange and pack kernels on a scratch system of lightCount point lights and spotlights
+	static BenchmarkResult RunBenchmark(int lightCount, int iterations);
+
+	void ExposeImGui();
+
+private:
+	int maxPointLights;
+	int maxSpotlights;
+	int maxDirectionalLights;
+
+	PointLightArrays points;
+	SpotLightArrays spots;
+	DirectionalLightArrays directionals;
+
+	std::vector<unsigned int> spotVersions;
+	std::vector<unsigned int> directionalVersions;
+
+	std::vector<GPUPointLight> gpuPointLights;
+	std::vector<GPUSpotLight> gpuSpotLights;
+
+	//Per frame timings
+	double lastArrangeMs = 0;
+	double lastPackMs = 0;
+	double arrangeMs = 0;
+
+	BenchmarkResult lastBenchmark;
+
+	void ArrangePointLightsScalar(float radius, float height);
+	void ArrangeSpotlightsScalar(float radius, float height, float angle);
+	void PackScalar(const Attenuation& attenuation, float cutoff);
+};
+
+#endif
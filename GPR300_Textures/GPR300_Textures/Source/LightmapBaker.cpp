@@ -0,0 +1,591 @@
+#include "LightmapBaker.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "imgui.h"
+
+//Rays start this far off the surface so they don't hit the triangle they left from
+static const float RAY_OFFSET = .005f;
+
+static const float PI = 3.14159265f;
+
+//Cheap per-row random numbers for the bounce rays
+static float NextRandom(unsigned int& state)
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return (state >> 8) * (1.f / 16777216.f);
+}
+
+//Same falloff window as calculateRadiusWindow in defaultLit.frag
+static float RadiusWindow(float dist, float radius)
+{
+	float ratio = dist / radius;
+	float window = std::min(std::max(1.f - ratio * ratio * ratio * ratio, 0.f), 1.f);
+	return window * window;
+}
+
+LightmapBaker::LightmapBaker(ThreadPool* pool)
+	: threadPool(pool)
+{
+}
+
+LightmapBaker::~LightmapBaker()
+{
+	for (size_t i = 0; i < targets.size(); i++)
+	{
+		glDeleteTextures(1, &targets[i].texture);
+	}
+}
+
+void LightmapBaker::GenerateLightmapUVs(ew::MeshData& meshData, int resolution)
+{
+	//Every triangle needs its own corners in the lightmap, so nothing can be shared
+	std::vector<ew::Vertex> vertices;
+	vertices.reserve(meshData.indices.size());
+	for (size_t i = 0; i < meshData.indices.size(); i++)
+	{
+		vertices.push_back(meshData.vertices[meshData.indices[i]]);
+		meshData.indices[i] = (unsigned int)i;
+	}
+	meshData.vertices = vertices;
+
+	int triangleCount = (int)meshData.indices.size() / 3;
+	int cellCount = (triangleCount + 1) / 2;
+	int cellsPerRow = std::max((int)std::ceil(std::sqrt((float)cellCount)), 1);
+	float cellSize = (float)resolution / cellsPerRow;
+	float pad = (float)TEXEL_PADDING;
+
+	meshData.lightmapUVs.resize(meshData.vertices.size());
+
+	for (int t = 0; t < triangleCount; t++)
+	{
+		int cell = t / 2;
+		glm::vec2 origin = glm::vec2(cell % cellsPerRow, cell / cellsPerRow) * cellSize;
+
+		//The right angle goes on the corner opposite the longest edge, which keeps the stretch down
+		const glm::vec3* corners[3] = { &meshData.vertices[t * 3].position, &meshData.vertices[t * 3 + 1].position, &meshData.vertices[t * 3 + 2].position };
+		float opposite[3] = {
+			glm::length(*corners[1] - *corners[2]),
+			glm::length(*corners[2] - *corners[0]),
+			glm::length(*corners[0] - *corners[1])
+		};
+		int a = opposite[0] >= opposite[1] ? (opposite[0] >= opposite[2] ? 0 : 2) : (opposite[1] >= opposite[2] ? 1 : 2);
+		int b = (a + 1) % 3;
+		int c = (a + 2) % 3;
+
+		//Even triangles take the lower left half of the cell, odd ones the upper right, with a gap along the diagonal
+		glm::vec2 cornerUVs[3];
+		if (t % 2 == 0)
+		{
+			cornerUVs[a] = origin + glm::vec2(pad, pad);
+			cornerUVs[b] = origin + glm::vec2(cellSize - pad * 2, pad);
+			cornerUVs[c] = origin + glm::vec2(pad, cellSize - pad * 2);
+		}
+		else
+		{
+			cornerUVs[a] = origin + glm::vec2(cellSize - pad, cellSize - pad);
+			cornerUVs[b] = origin + glm::vec2(pad * 2, cellSize - pad);
+			cornerUVs[c] = origin + glm::vec2(cellSize - pad, pad * 2);
+		}
+
+		for (int i = 0; i < 3; i++)
+		{
+			meshData.lightmapUVs[t * 3 + i] = cornerUVs[i] / (float)resolution;
+		}
+	}
+}
+
+int LightmapBaker::AddStaticMesh(ew::MeshData* meshData, ew::Transform* transform, int resolution)
+{
+	GenerateLightmapUVs(*meshData, resolution);
+
+	Target target;
+	target.meshData = meshData;
+	target.transform = transform;
+	target.resolution = resolution;
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &target.texture);
+	glTextureStorage2D(target.texture, 1, GL_RGB16F, resolution, resolution);
+	glTextureParameteri(target.texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(target.texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(target.texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(target.texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	Rasterize(target);
+
+	targets.push_back(target);
+	baked = false;
+	return (int)targets.size() - 1;
+}
+
+void LightmapBaker::Rasterize(Target& target)
+{
+	int resolution = target.resolution;
+	target.texelTriangles.assign(resolution * resolution, -1);
+	target.texelBarycentrics.assign(resolution * resolution, glm::vec2(0));
+
+	const std::vector<glm::vec2>& uvs = target.meshData->lightmapUVs;
+	int triangleCount = (int)uvs.size() / 3;
+
+	for (int t = 0; t < triangleCount; t++)
+	{
+		glm::vec2 a = uvs[t * 3] * (float)resolution;
+		glm::vec2 b = uvs[t * 3 + 1] * (float)resolution;
+		glm::vec2 c = uvs[t * 3 + 2] * (float)resolution;
+
+		glm::vec2 edge1 = b - a;
+		glm::vec2 edge2 = c - a;
+		float denominator = edge1.x * edge2.y - edge2.x * edge1.y;
+		if (fabsf(denominator) < 1e-8f)
+		{
+			continue;
+		}
+
+		glm::vec2 boundsMin = glm::min(a, glm::min(b, c));
+		glm::vec2 boundsMax = glm::max(a, glm::max(b, c));
+		int minX = std::max((int)std::floor(boundsMin.x), 0);
+		int minY = std::max((int)std::floor(boundsMin.y), 0);
+		int maxX = std::min((int)std::ceil(boundsMax.x), resolution - 1);
+		int maxY = std::min((int)std::ceil(boundsMax.y), resolution - 1);
+
+		//Every texel whose center is inside the triangle
+		for (int y = minY; y <= maxY; y++)
+		{
+			for (int x = minX; x <= maxX; x++)
+			{
+				glm::vec2 p = glm::vec2(x + .5f, y + .5f) - a;
+				float u = (p.x * edge2.y - edge2.x * p.y) / denominator;
+				float v = (edge1.x * p.y - p.x * edge1.y) / denominator;
+				if (u < 0.f || v < 0.f || u + v > 1.f)
+				{
+					continue;
+				}
+
+				target.texelTriangles[x + y * resolution] = t;
+				target.texelBarycentrics[x + y * resolution] = glm::vec2(u, v);
+			}
+		}
+	}
+}
+
+void LightmapBaker::BuildScene()
+{
+	scenePositions.clear();
+	triangleTargets.clear();
+
+	for (size_t i = 0; i < targets.size(); i++)
+	{
+		Target& target = targets[i];
+		target.model = target.transform->getModelMatrix();
+		target.normalMatrix = glm::transpose(glm::inverse(glm::mat3(target.model)));
+		target.firstTriangle = (int)triangleTargets.size();
+
+		const std::vector<ew::Vertex>& vertices = target.meshData->vertices;
+		for (size_t v = 0; v < vertices.size(); v++)
+		{
+			scenePositions.push_back(glm::vec3(target.model * glm::vec4(vertices[v].position, 1)));
+		}
+		triangleTargets.insert(triangleTargets.end(), vertices.size() / 3, (int)i);
+	}
+
+	bvh.Build(scenePositions);
+}
+
+void LightmapBaker::BakeDirect(Target& target, int row, const LightSystem& lights, const Attenuation& attenuation, long long& rays)
+{
+	const std::vector<ew::Vertex>& vertices = target.meshData->vertices;
+	const LightSystem::DirectionalLightArrays& directionals = lights.GetDirectionalLights();
+	const std::vector<GPUSpotLight>& spotlights = lights.GetGPUSpotlights();
+
+	for (int x = 0; x < target.resolution; x++)
+	{
+		int texel = x + row * target.resolution;
+		int triangle = target.texelTriangles[texel];
+		if (triangle < 0)
+		{
+			target.direct[texel] = glm::vec3(0);
+			continue;
+		}
+
+		//Interpolate the surface the same way the rasterizer would
+		glm::vec2 barycentric = target.texelBarycentrics[texel];
+		float w = 1.f - barycentric.x - barycentric.y;
+		const ew::Vertex& v0 = vertices[triangle * 3];
+		const ew::Vertex& v1 = vertices[triangle * 3 + 1];
+		const ew::Vertex& v2 = vertices[triangle * 3 + 2];
+
+		glm::vec3 localPosition = v0.position * w + v1.position * barycentric.x + v2.position * barycentric.y;
+		glm::vec3 localNormal = v0.normal * w + v1.normal * barycentric.x + v2.normal * barycentric.y;
+
+		glm::vec3 position = glm::vec3(target.model * glm::vec4(localPosition, 1));
+		glm::vec3 normal = glm::normalize(target.normalMatrix * localNormal);
+		target.texelPositions[texel] = position;
+		target.texelNormals[texel] = normal;
+
+		glm::vec3 origin = position + normal * RAY_OFFSET;
+		glm::vec3 light = glm::vec3(0);
+
+		for (int i = 0; i < lights.directionalLightCount; i++)
+		{
+			glm::vec3 lightDir = glm::normalize(glm::vec3(directionals.dirX[i], directionals.dirY[i], directionals.dirZ[i]));
+			float nDotL = glm::dot(normal, lightDir);
+			if (nDotL <= 0.f)
+			{
+				continue;
+			}
+
+			rays++;
+			if (bvh.Occluded(origin, lightDir, INFINITY))
+			{
+				continue;
+			}
+
+			light += nDotL * directionals.intensity[i] * glm::vec3(directionals.colorR[i], directionals.colorG[i], directionals.colorB[i]);
+		}
+
+		//Matches shadeSpotlight, including the radius window
+		for (int i = 0; i < lights.spotlightCount; i++)
+		{
+			const GPUSpotLight& spot = spotlights[i];
+			glm::vec3 toLight = glm::vec3(spot.posRadius) - position;
+			float dist = glm::length(toLight);
+			if (dist <= 0.f || dist >= spot.posRadius.w)
+			{
+				continue;
+			}
+
+			glm::vec3 lightDir = toLight / dist;
+			float nDotL = glm::dot(normal, lightDir);
+			if (nDotL <= 0.f)
+			{
+				continue;
+			}
+
+			float fragAngle = glm::dot(glm::vec3(spot.dirFalloff), -lightDir);
+			float cosInner = spot.rangeAngles.y;
+			float cosOuter = spot.rangeAngles.z;
+			float cone = cosInner > cosOuter ? std::min(std::max((fragAngle - cosOuter) / (cosInner - cosOuter), 0.f), 1.f) : (fragAngle >= cosOuter ? 1.f : 0.f);
+			float angular = powf(cone, spot.dirFalloff.w) * spot.rangeAngles.x;
+			if (angular <= 0.f)
+			{
+				continue;
+			}
+
+			rays++;
+			if (bvh.Occluded(origin, lightDir, dist - RAY_OFFSET))
+			{
+				continue;
+			}
+
+			float attenuationFactor = attenuation.GetFactor(dist) * RadiusWindow(dist, spot.posRadius.w);
+			light += nDotL * angular * attenuationFactor * spot.colorIntensity.a * glm::vec3(spot.colorIntensity);
+		}
+
+		target.direct[texel] = light;
+	}
+}
+
+glm::vec3 LightmapBaker::SampleDirect(int triangle, float u, float v)
+{
+	const Target& target = targets[triangleTargets[triangle]];
+	int local = triangle - target.firstTriangle;
+
+	const std::vector<glm::vec2>& uvs = target.meshData->lightmapUVs;
+	glm::vec2 uv = uvs[local * 3] * (1.f - u - v) + uvs[local * 3 + 1] * u + uvs[local * 3 + 2] * v;
+
+	int x = std::min(std::max((int)(uv.x * target.resolution), 0), target.resolution - 1);
+	int y = std::min(std::max((int)(uv.y * target.resolution), 0), target.resolution - 1);
+	return target.direct[x + y * target.resolution];
+}
+
+void LightmapBaker::BakeBounce(Target& target, int row, const glm::vec3& albedo, long long& rays)
+{
+	unsigned int random = (unsigned int)(row * 9781 + target.resolution * 6271 + target.firstTriangle * 26699) | 1;
+
+	for (int x = 0; x < target.resolution; x++)
+	{
+		int texel = x + row * target.resolution;
+		if (target.texelTriangles[texel] < 0)
+		{
+			target.result[texel] = target.direct[texel];
+			continue;
+		}
+
+		glm::vec3 position = target.texelPositions[texel];
+		glm::vec3 normal = target.texelNormals[texel];
+		glm::vec3 origin = position + normal * RAY_OFFSET;
+
+		glm::vec3 tangent = glm::normalize(glm::cross(fabsf(normal.y) < .99f ? glm::vec3(0, 1, 0) : glm::vec3(1, 0, 0), normal));
+		glm::vec3 bitangent = glm::cross(normal, tangent);
+
+		//Cosine weighted directions, so averaging what they see is the irradiance
+		glm::vec3 gathered = glm::vec3(0);
+		for (int i = 0; i < bounceSamples; i++)
+		{
+			float angle = 2.f * PI * NextRandom(random);
+			float r2 = NextRandom(random);
+			float r = sqrtf(r2);
+			glm::vec3 dir = tangent * (cosf(angle) * r) + bitangent * (sinf(angle) * r) + normal * sqrtf(1.f - r2);
+
+			rays++;
+			TriangleBVH::Hit hit;
+			if (!bvh.Intersect(origin, dir, INFINITY, hit))
+			{
+				continue;
+			}
+
+			//Only the front of a surface is lit
+			const glm::vec3* corners = &scenePositions[hit.triangle * 3];
+			if (glm::dot(glm::cross(corners[1] - corners[0], corners[2] - corners[0]), dir) >= 0.f)
+			{
+				continue;
+			}
+
+			gathered += SampleDirect(hit.triangle, hit.u, hit.v);
+		}
+
+		target.result[texel] = target.direct[texel] + albedo * gathered / (float)bounceSamples;
+	}
+}
+
+void LightmapBaker::Dilate(const Target& target, std::vector<glm::vec3>& texels)
+{
+	int resolution = target.resolution;
+	std::vector<char> filled(texels.size());
+	for (size_t i = 0; i < texels.size(); i++)
+	{
+		filled[i] = target.texelTriangles[i] >= 0;
+	}
+
+	//Grow every triangle out by the padding so bilinear filtering at its edges reads lit texels
+	std::vector<char> nextFilled;
+	for (int pass = 0; pass < TEXEL_PADDING; pass++)
+	{
+		nextFilled = filled;
+		for (int y = 0; y < resolution; y++)
+		{
+			for (int x = 0; x < resolution; x++)
+			{
+				int texel = x + y * resolution;
+				if (filled[texel])
+				{
+					continue;
+				}
+
+				glm::vec3 sum = glm::vec3(0);
+				int count = 0;
+				for (int dy = -1; dy <= 1; dy++)
+				{
+					for (int dx = -1; dx <= 1; dx++)
+					{
+						int nx = x + dx;
+						int ny = y + dy;
+						if (nx < 0 || ny < 0 || nx >= resolution || ny >= resolution || !filled[nx + ny * resolution])
+						{
+							continue;
+						}
+						sum += texels[nx + ny * resolution];
+						count++;
+					}
+				}
+
+				if (count > 0)
+				{
+					texels[texel] = sum / (float)count;
+					nextFilled[texel] = 1;
+				}
+			}
+		}
+		filled.swap(nextFilled);
+	}
+}
+
+void LightmapBaker::Bake(const LightSystem& lights, const Attenuation& attenuation, const Material& material)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	BuildScene();
+
+	//One job per lightmap row, across every target
+	std::vector<int> rowTargets;
+	std::vector<int> rowIndices;
+	lastTexelCount = 0;
+	for (size_t i = 0; i < targets.size(); i++)
+	{
+		Target& target = targets[i];
+		int texelCount = target.resolution * target.resolution;
+		target.texelPositions.resize(texelCount);
+		target.texelNormals.resize(texelCount);
+		target.direct.resize(texelCount);
+		target.result.resize(texelCount);
+		lastTexelCount += texelCount;
+
+		for (int row = 0; row < target.resolution; row++)
+		{
+			rowTargets.push_back((int)i);
+			rowIndices.push_back(row);
+		}
+	}
+
+	//Counted per row so the threads never share a counter
+	std::vector<long long> rowRays(rowTargets.size(), 0);
+
+	threadPool->ParallelFor((int)rowTargets.size(), [&](int job)
+	{
+		BakeDirect(targets[rowTargets[job]], rowIndices[job], lights, attenuation, rowRays[job]);
+	});
+
+	for (size_t i = 0; i < targets.size(); i++)
+	{
+		Dilate(targets[i], targets[i].direct);
+	}
+
+	if (bounce && bounceSamples > 0)
+	{
+		//Diffuse coefficient stands in for albedo, the same factor the shader scales diffuse light by
+		glm::vec3 albedo = material.diffuseK * material.color;
+		threadPool->ParallelFor((int)rowTargets.size(), [&](int job)
+		{
+			BakeBounce(targets[rowTargets[job]], rowIndices[job], albedo, rowRays[job]);
+		});
+	}
+	else
+	{
+		for (size_t i = 0; i < targets.size(); i++)
+		{
+			targets[i].result = targets[i].direct;
+		}
+	}
+
+	lastRayCount = 0;
+	for (size_t i = 0; i < rowRays.size(); i++)
+	{
+		lastRayCount += rowRays[i];
+	}
+
+	for (size_t i = 0; i < targets.size(); i++)
+	{
+		Target& target = targets[i];
+		Dilate(target, target.result);
+		glTextureSubImage2D(target.texture, 0, 0, 0, target.resolution, target.resolution, GL_RGB, GL_FLOAT, &target.result[0]);
+	}
+
+	CaptureState(lights, attenuation, material, bakedLightState);
+	bakedTransformVersions.resize(targets.size());
+	for (size_t i = 0; i < targets.size(); i++)
+	{
+		bakedTransformVersions[i] = targets[i].transform->getVersion();
+	}
+
+	baked = true;
+	stale = false;
+	lastBakeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void LightmapBaker::CaptureState(const LightSystem& lights, const Attenuation& attenuation, const Material& material, std::vector<float>& state)
+{
+	state.clear();
+	state.push_back((float)lights.directionalLightCount);
+	state.push_back((float)lights.spotlightCount);
+
+	const LightSystem::DirectionalLightArrays& directionals = lights.GetDirectionalLights();
+	for (int i = 0; i < lights.directionalLightCount; i++)
+	{
+		float values[7] = { directionals.dirX[i], directionals.dirY[i], directionals.dirZ[i],
+			directionals.colorR[i], directionals.colorG[i], directionals.colorB[i], directionals.intensity[i] };
+		state.insert(state.end(), values, values + 7);
+	}
+
+	//The packed spotlights already fold in attenuation and cutoff through their radius
+	const std::vector<GPUSpotLight>& spotlights = lights.GetGPUSpotlights();
+	for (int i = 0; i < lights.spotlightCount; i++)
+	{
+		const float* values = &spotlights[i].posRadius.x;
+		state.insert(state.end(), values, values + sizeof(GPUSpotLight) / sizeof(float));
+	}
+
+	state.push_back(attenuation.constant);
+	state.push_back(attenuation.linear);
+	state.push_back(attenuation.quadratic);
+
+	state.push_back(material.diffuseK);
+	state.push_back(material.color.r);
+	state.push_back(material.color.g);
+	state.push_back(material.color.b);
+
+	state.push_back(bounce ? (float)bounceSamples : 0.f);
+}
+
+bool LightmapBaker::IsStale(const LightSystem& lights, const Attenuation& attenuation, const Material& material)
+{
+	if (!baked || bakedTransformVersions.size() != targets.size())
+	{
+		return true;
+	}
+
+	for (size_t i = 0; i < targets.size(); i++)
+	{
+		if (targets[i].transform->getVersion() != bakedTransformVersions[i])
+		{
+			return true;
+		}
+	}
+
+	CaptureState(lights, attenuation, material, scratchLightState);
+	return scratchLightState != bakedLightState;
+}
+
+void LightmapBaker::Update(const LightSystem& lights, const Attenuation& attenuation, const Material& material)
+{
+	if (!enabled)
+	{
+		return;
+	}
+
+	stale = IsStale(lights, attenuation, material);
+	if (bakeRequested || (autoRebake && stale))
+	{
+		Bake(lights, attenuation, material);
+		bakeRequested = false;
+	}
+}
+
+void LightmapBaker::Bind(Shader& shader, int id)
+{
+	bool useLightmap = enabled && baked && id >= 0;
+	shader.setInt("_UseLightmap", useLightmap);
+
+	if (useLightmap)
+	{
+		glBindTextureUnit(LIGHTMAP_UNIT, targets[id].texture);
+		shader.setInt("_Lightmap", LIGHTMAP_UNIT);
+	}
+}
+
+void LightmapBaker::ExposeImGui()
+{
+	ImGui::Checkbox("Lightmaps", &enabled);
+
+	if (enabled)
+	{
+		ImGui::Checkbox("Bake Bounce Light", &bounce);
+		if (bounce)
+		{
+			ImGui::SliderInt("Bounce Samples", &bounceSamples, 1, 256);
+		}
+		ImGui::Checkbox("Auto Rebake", &autoRebake);
+
+		if (ImGui::Button("Bake Lightmaps"))
+		{
+			bakeRequested = true;
+		}
+
+		ImGui::Text("Lightmaps: %s", !baked ? "not baked" : (stale ? "out of date" : "up to date"));
+		ImGui::Text("Last bake: %.1f ms, %d texels, %lld rays", lastBakeMs, lastTexelCount, lastRayCount);
+		ImGui::Text("Bake BVH: %d triangles, %d nodes", bvh.GetTriangleCount(), bvh.GetNodeCount());
+	}
+}
@@ -0,0 +1,112 @@
+#ifndef LIGHTMAP_BAKER_H
+#define LIGHTMAP_BAKER_H
+
+#include <vector>
+
+#include "GL/glew.h"
+#include "glm/glm.hpp"
+
+#include "Mesh.h"
+#include "Shader.h"
+#include "Transform.h"
+#include "Material.h"
+#include "LightSystem.h"
+#include "ThreadPool.h"
+#include "TriangleBVH.h"
+
+//Texture unit the lit shader samples lightmaps from, above the ones TextureManager hands out
+const GLuint LIGHTMAP_UNIT = 27;
+
+//Bakes the directional lights and spotlights into a lightmap per static mesh by tracing rays on the CPU.
+//Baked meshes skip those lights in defaultLit.frag, point lights stay dynamic.
+class LightmapBaker
+{
+public:
+	//Texels left empty around every triangle so filtering never reads a neighbour
+	static const int TEXEL_PADDING = 2;
+
+	bool enabled = true;
+	bool bounce = true;
+	int bounceSamples = 32;
+	bool autoRebake = false;
+
+	LightmapBaker(ThreadPool* pool);
+	~LightmapBaker();
+
+	//Unindexes meshData and fills in its lightmap uvs, every pair of triangles gets its own square of the map
+	static void GenerateLightmapUVs(ew::MeshData& meshData, int resolution);
+
+	//Unwraps meshData, so call it before building the mesh's ew::Mesh. Returns the id to Bind with.
+	//The mesh's triangles also block light for every other static mesh.
+	int AddStaticMesh(ew::MeshData* meshData, ew::Transform* transform, int resolution);
+
+	//Bakes if asked to from the UI, or on its own once the lights or static meshes changed when autoRebake is on
+	void Update(const LightSystem& lights, const Attenuation& attenuation, const Material& material);
+
+	void Bake(const LightSystem& lights, const Attenuation& attenuation, const Material& material);
+
+	//True when the lights or static meshes changed since the last bake
+	bool IsStale(const LightSystem& lights, const Attenuation& attenuation, const Material& material);
+
+	//Binds the lightmap of a static mesh, -1 turns lightmapping off for meshes that aren't baked
+	void Bind(Shader& shader, int id);
+
+	//False when Bind turns lightmapping off whatever the id
+	bool IsActive() const { return enabled && baked; }
+
+	void ExposeImGui();
+
+private:
+	struct Target
+	{
+		ew::MeshData* meshData;
+		ew::Transform* transform;
+		int resolution;
+
+		GLuint texture = 0;
+
+		//Which triangle covers each texel and where, -1 for texels between triangles
+		std::vector<int> texelTriangles;
+		std::vector<glm::vec2> texelBarycentrics;
+
+		//Bake scratch, world space
+		std::vector<glm::vec3> texelPositions;
+		std::vector<glm::vec3> texelNormals;
+		std::vector<glm::vec3> direct;
+		std::vector<glm::vec3> result;
+
+		glm::mat4 model;
+		glm::mat3 normalMatrix;
+		int firstTriangle = 0;	//Offset into the BVH's triangles
+	};
+
+	ThreadPool* threadPool;
+
+	std::vector<Target> targets;
+	TriangleBVH bvh;
+	std::vector<glm::vec3> scenePositions;	//World space corners of every BVH triangle
+	std::vector<int> triangleTargets;	//Target of every BVH triangle
+
+	bool baked = false;
+	bool bakeRequested = false;
+	bool stale = true;
+
+	//What the last bake saw, compared to tell when it went stale
+	std::vector<float> bakedLightState;
+	std::vector<unsigned int> bakedTransformVersions;
+	std::vector<float> scratchLightState;
+
+	double lastBakeMs = 0;
+	int lastTexelCount = 0;
+	long long lastRayCount = 0;
+
+	void Rasterize(Target& target);
+	void BuildScene();
+	void BakeDirect(Target& target, int row, const LightSystem& lights, const Attenuation& attenuation, long long& rays);
+	void BakeBounce(Target& target, int row, const glm::vec3& albedo, long long& rays);
+	glm::vec3 SampleDirect(int triangle, float u, float v);
+	static void Dilate(const Target& target, std::vector<glm::vec3>& texels);
+	void CaptureState(const LightSystem& lights, const Attenuation& attenuation, const Material& material, std::vector<float>& state);
+};
+
+#endif
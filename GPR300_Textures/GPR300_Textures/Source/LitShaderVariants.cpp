@@ -0,0 +1,219 @@
+#include "LitShaderVariants.h"
+
+#include "imgui.h"
+
+//3 bits per light count, 7 stands for a dynamic count
+static const uint32_t COUNT_BITS = 3;
+static const uint32_t COUNT_MASK = (1 << COUNT_BITS) - 1;
+static const uint32_t DYNAMIC_COUNT_CODE = COUNT_MASK;
+
+static uint32_t PackCount(int count)
+{
+	return count < 0 ? DYNAMIC_COUNT_CODE : (uint32_t)count;
+}
+
+static int UnpackCount(uint32_t code)
+{
+	return code == DYNAMIC_COUNT_CODE ? DYNAMIC_LIGHT_COUNT : (int)code;
+}
+
+static int SelectCount(int count)
+{
+	if (count <= 0)
+	{
+		return 0;
+	}
+
+	return count <= MAX_UNROLLED_LIGHTS ? count : DYNAMIC_LIGHT_COUNT;
+}
+
+LitPermutationKey LitPermutationKey::Create(bool phong, bool textured, int pointLights, int directionalLights, int spotlights, bool clustered, bool perObjectLights, bool sphericalHarmonics)
+{
+	LitPermutationKey key;
+	key.blinnPhong = !phong;
+	key.textured = textured;
+	key.clustered = clustered;
+	key.perObjectLights = perObjectLights && !clustered;
+	key.sphericalHarmonics = sphericalHarmonics;
+
+	//Lists built outside the shader decide how many lights each fragment visits
+	bool listedLights = key.clustered || key.perObjectLights;
+	key.pointLights = listedLights ? DYNAMIC_LIGHT_COUNT : SelectCount(pointLights);
+	key.directionalLights = sphericalHarmonics ? 0 : SelectCount(directionalLights);
+	key.spotlights = listedLights ? DYNAMIC_LIGHT_COUNT : SelectCount(spotlights);
+	return key;
+}
+
+uint32_t LitPermutationKey::Pack() const
+{
+	uint32_t packed = 0;
+	packed |= blinnPhong ? 1 : 0;
+	packed |= (textured ? 1 : 0) << 1;
+	packed |= PackCount(pointLights) << 2;
+	packed |= PackCount(directionalLights) << (2 + COUNT_BITS);
+	packed |= PackCount(spotlights) << (2 + COUNT_BITS * 2);
+	packed |= (clustered ? 1 : 0) << (2 + COUNT_BITS * 3);
+	packed |= (perObjectLights ? 1 : 0) << (3 + COUNT_BITS * 3);
+	packed |= (sphericalHarmonics ? 1 : 0) << (4 + COUNT_BITS * 3);
+	return packed;
+}
+
+LitPermutationKey LitPermutationKey::Unpack(uint32_t packed)
+{
+	LitPermutationKey key;
+	key.blinnPhong = (packed & 1) != 0;
+	key.textured = (packed & 2) != 0;
+	key.pointLights = UnpackCount((packed >> 2) & COUNT_MASK);
+	key.directionalLights = UnpackCount((packed >> (2 + COUNT_BITS)) & COUNT_MASK);
+	key.spotlights = UnpackCount((packed >> (2 + COUNT_BITS * 2)) & COUNT_MASK);
+	key.clustered = ((packed >> (2 + COUNT_BITS * 3)) & 1) != 0;
+	key.perObjectLights = ((packed >> (3 + COUNT_BITS * 3)) & 1) != 0;
+	key.sphericalHarmonics = ((packed >> (4 + COUNT_BITS * 3)) & 1) != 0;
+	return key;
+}
+
+LitPermutationKey LitPermutationKey::Generalize() const
+{
+	LitPermutationKey general = *this;
+	general.pointLights = pointLights == 0 ? 0 : DYNAMIC_LIGHT_COUNT;
+	general.directionalLights = directionalLights == 0 ? 0 : DYNAMIC_LIGHT_COUNT;
+	general.spotlights = spotlights == 0 ? 0 : DYNAMIC_LIGHT_COUNT;
+	return general;
+}
+
+std::string LitPermutationKey::GetDefines() const
+{
+	std::string defines;
+	defines += blinnPhong ? "#define BLINN_PHONG\n" : "#define PHONG\n";
+	defines += "#define TEXTURED " + std::to_string(textured ? 1 : 0) + "\n";
+	defines += "#define POINT_LIGHT_COUNT " + std::to_string(pointLights) + "\n";
+	defines += "#define DIRECTIONAL_LIGHT_COUNT " + std::to_string(directionalLights) + "\n";
+	defines += "#define SPOTLIGHT_COUNT " + std::to_string(spotlights) + "\n";
+	if (clustered)
+	{
+		defines += "#define CLUSTERED\n";
+	}
+	if (perObjectLights)
+	{
+		defines += "#define PER_OBJECT_LIGHTS\n";
+	}
+	if (sphericalHarmonics)
+	{
+		defines += "#define SPHERICAL_HARMONICS\n";
+	}
+	return defines;
+}
+
+LitShaderVariants::LitShaderVariants(ShaderManager* manager, const std::string& vertex, const std::string& fragment)
+	: shaderManager(manager), vertexPath(vertex), fragmentPath(fragment)
+{
+}
+
+Shader* LitShaderVariants::Request(const LitPermutationKey& key)
+{
+	uint32_t packed = key.Pack();
+
+	std::unordered_map<uint32_t, Shader*>::iterator found = variants.find(packed);
+	if (found != variants.end())
+	{
+		return found->second;
+	}
+
+	Shader* shader = shaderManager->Load(vertexPath, fragmentPath, key.GetDefines());
+	variants[packed] = shader;
+	return shader;
+}
+
+void LitShaderVariants::Prewarm()
+{
+	//Every combination of specular model, texturing and light type presence, with dynamic counts
+	for (uint32_t flags = 0; flags < 32; flags++)
+	{
+		LitPermutationKey key;
+		key.blinnPhong = (flags & 1) != 0;
+		key.textured = (flags & 2) != 0;
+		key.pointLights = (flags & 4) ? DYNAMIC_LIGHT_COUNT : 0;
+		key.directionalLights = (flags & 8) ? DYNAMIC_LIGHT_COUNT : 0;
+		key.spotlights = (flags & 16) ? DYNAMIC_LIGHT_COUNT : 0;
+
+		Request(key);
+	}
+
+	//Clustered shading and per-object lists only vary by specular model, texturing and directional lights
+	for (uint32_t flags = 0; flags < 16; flags++)
+	{
+		LitPermutationKey key;
+		key.blinnPhong = (flags & 1) != 0;
+		key.textured = (flags & 2) != 0;
+		key.directionalLights = (flags & 4) ? DYNAMIC_LIGHT_COUNT : 0;
+		key.clustered = (flags & 8) != 0;
+		key.perObjectLights = !key.clustered;
+
+		Request(key);
+	}
+
+	//Spherical harmonics replace the directional lights in each of the three forward paths
+	for (uint32_t flags = 0; flags < 12; flags++)
+	{
+		LitPermutationKey key;
+		key.blinnPhong = (flags & 1) != 0;
+		key.textured = (flags & 2) != 0;
+		key.directionalLights = 0;
+		key.clustered = (flags >> 2) == 1;
+		key.perObjectLights = (flags >> 2) == 2;
+		key.sphericalHarmonics = true;
+
+		Request(key);
+	}
+}
+
+Shader* LitShaderVariants::Get(const LitPermutationKey& key)
+{
+	lastRequested = key.Pack();
+
+	Shader* exact = Request(key);
+	if (exact->isReady())
+	{
+		lastUsed = lastRequested;
+		return exact;
+	}
+
+	//Draw with a more general permutation while the exact one compiles
+	LitPermutationKey general = key.Generalize();
+	Shader* fallback = Request(general);
+	if (fallback->isReady())
+	{
+		lastUsed = general.Pack();
+		return fallback;
+	}
+
+	LitPermutationKey everyLight = general;
+	everyLight.pointLights = DYNAMIC_LIGHT_COUNT;
+	everyLight.directionalLights = DYNAMIC_LIGHT_COUNT;
+	everyLight.spotlights = DYNAMIC_LIGHT_COUNT;
+	fallback = Request(everyLight);
+	if (fallback->isReady())
+	{
+		lastUsed = everyLight.Pack();
+		return fallback;
+	}
+
+	//Nothing has linked yet, the shader draws with the manager's fallback program
+	lastUsed = lastRequested;
+	return exact;
+}
+
+void LitShaderVariants::ExposeImGui()
+{
+	int ready = 0;
+	for (std::unordered_map<uint32_t, Shader*>::iterator it = variants.begin(); it != variants.end(); it++)
+	{
+		if (it->second->isReady())
+		{
+			ready++;
+		}
+	}
+
+	ImGui::Text("Lit variants: %d / %d ready", ready, (int)variants.size());
+	ImGui::Text("Requested key: 0x%04X, drawing with: 0x%04X", lastRequested, lastUsed);
+}
@@ -0,0 +1,76 @@
+#ifndef LIT_SHADER_VARIANTS_H
+#define LIT_SHADER_VARIANTS_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include "ShaderManager.h"
+
+//Light counts up to this are compiled as fully unrolled fixed counts, above it the shader loops to the count uniform
+const int MAX_UNROLLED_LIGHTS = 4;
+const int DYNAMIC_LIGHT_COUNT = -1;
+
+//Selects one specialized build of defaultLit.frag
+struct LitPermutationKey
+{
+	bool blinnPhong = false;
+	bool textured = true;
+
+	//Point lights and spotlights come from LightClusterer, their counts are ignored
+	bool clustered = false;
+
+	//Point lights and spotlights are read through the per-draw index lists from ObjectLightCuller, their counts are ignored
+	bool perObjectLights = false;
+
+	//Directional light diffuse comes from DistantLightSH's coefficients, the directional count is ignored
+	bool sphericalHarmonics = false;
+
+	//0 strips the light type, 1 - MAX_UNROLLED_LIGHTS are unrolled, DYNAMIC_LIGHT_COUNT loops
+	int pointLights = DYNAMIC_LIGHT_COUNT;
+	int directionalLights = DYNAMIC_LIGHT_COUNT;
+	int spotlights = DYNAMIC_LIGHT_COUNT;
+
+	//Builds the key for the given light counts, falling back to a dynamic count past MAX_UNROLLED_LIGHTS
+	//Clustered shading takes priority over per-object lights
+	static LitPermutationKey Create(bool phong, bool textured, int pointLights, int directionalLights, int spotlights, bool clustered = false, bool perObjectLights = false, bool sphericalHarmonics = false);
+
+	//Packs into 14 bits: blinn | textured | 3 bits per light count (7 = dynamic) | clustered | per-object lights | spherical harmonics
+	uint32_t Pack() const;
+	static LitPermutationKey Unpack(uint32_t packed);
+
+	//Same key with every present light type switched to a dynamic count, which is always prewarmed
+	LitPermutationKey Generalize() const;
+
+	std::string GetDefines() const;
+};
+
+//Caches every compiled permutation of the lit shader
+class LitShaderVariants
+{
+private:
+	ShaderManager* shaderManager;
+
+	std::string vertexPath;
+	std::string fragmentPath;
+
+	std::unordered_map<uint32_t, Shader*> variants;
+
+	uint32_t lastRequested = 0;
+	uint32_t lastUsed = 0;
+
+	Shader* Request(const LitPermutationKey& key);
+
+public:
+	LitShaderVariants(ShaderManager* manager, const std::string& vertex, const std::string& fragment);
+
+	//Starts compiling every generalized permutation so Get always has something close to fall back to
+	void Prewarm();
+
+	//Returns the exact variant if it has linked, otherwise starts compiling it and returns the closest ready one
+	Shader* Get(const LitPermutationKey& key);
+
+	void ExposeImGui();
+};
+
+#endif
@@ -0,0 +1,582 @@
+#include "MeshImporter.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdio.h>
+#include <unordered_map>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "imgui.h"
+
+//Bump when the cache layout or what goes into it changes, older caches are then reparsed
+static const uint32_t CACHE_VERSION = 1;
+static const char CACHE_MAGIC[4] = { 'E', 'W', 'M', 'C' };
+
+//Chunks are at least this big so small files don't pay for the threads
+static const size_t MIN_CHUNK_BYTES = 256 * 1024;
+
+static const int MISSING_INDEX = INT32_MIN;
+
+struct CacheHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+};
+
+//Read only view of a whole file, released when it goes out of scope
+class MappedFile
+{
+public:
+	MappedFile(const std::string& path)
+	{
+#ifdef _WIN32
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return;
+		}
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+		{
+			return;
+		}
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping == NULL)
+		{
+			return;
+		}
+		data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		size = data != nullptr ? (size_t)fileSize.QuadPart : 0;
+#else
+		descriptor = open(path.c_str(), O_RDONLY);
+		if (descriptor < 0)
+		{
+			return;
+		}
+		struct stat info;
+		if (fstat(descriptor, &info) != 0 || info.st_size == 0)
+		{
+			return;
+		}
+		void* view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+		if (view == MAP_FAILED)
+		{
+			return;
+		}
+		data = (const char*)view;
+		size = (size_t)info.st_size;
+#endif
+	}
+
+	~MappedFile()
+	{
+#ifdef _WIN32
+		if (data != nullptr)
+		{
+			UnmapViewOfFile(data);
+		}
+		if (mapping != NULL)
+		{
+			CloseHandle(mapping);
+		}
+		if (file != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(file);
+		}
+#else
+		if (data != nullptr)
+		{
+			munmap((void*)data, size);
+		}
+		if (descriptor >= 0)
+		{
+			close(descriptor);
+		}
+#endif
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const char* data = nullptr;
+	size_t size = 0;
+
+private:
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = NULL;
+#else
+	int descriptor = -1;
+#endif
+};
+
+//One face corner, 0 based. Relative OBJ indices depend on how many elements came before the chunk, so those are
+//stored from the start of the chunk with their bit set in relative until the chunk's offset is known.
+//MISSING_INDEX when the corner left it out.
+struct Corner
+{
+	int position;
+	int uv;
+	int normal;
+	uint8_t relative;
+};
+
+static const uint8_t RELATIVE_POSITION = 1;
+static const uint8_t RELATIVE_UV = 2;
+static const uint8_t RELATIVE_NORMAL = 4;
+
+struct ParsedChunk
+{
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::vec3> normals;
+	std::vector<Corner> corners;	//Already fanned into triangles
+	bool failed = false;
+};
+
+static const char* SkipSpaces(const char* cursor, const char* end)
+{
+	while (cursor < end && (*cursor == ' ' || *cursor == '\t'))
+	{
+		cursor++;
+	}
+	return cursor;
+}
+
+static const char* ParseFloats(const char* cursor, const char* end, float* values, int count)
+{
+	for (int i = 0; i < count; i++)
+	{
+		cursor = SkipSpaces(cursor, end);
+		//from_chars doesn't take a leading plus
+		if (cursor < end && *cursor == '+')
+		{
+			cursor++;
+		}
+		std::from_chars_result parsed = std::from_chars(cursor, end, values[i]);
+		if (parsed.ec != std::errc())
+		{
+			return nullptr;
+		}
+		cursor = parsed.ptr;
+	}
+	return cursor;
+}
+
+//OBJ indices are 1 based, negative ones count back from the last element defined so far
+static int ResolveIndex(int objIndex, size_t definedInChunk, uint8_t relativeBit, uint8_t& relative)
+{
+	if (objIndex > 0)
+	{
+		return objIndex - 1;
+	}
+	if (objIndex < 0)
+	{
+		//Can land before the chunk, that's fine once the offset is added
+		relative |= relativeBit;
+		return (int)definedInChunk + objIndex;
+	}
+	return MISSING_INDEX;
+}
+
+static void ParseChunk(const char* cursor, const char* end, ParsedChunk& chunk)
+{
+	std::vector<Corner> polygon;
+
+	while (cursor < end)
+	{
+		const char* lineEnd = (const char*)memchr(cursor, '\n', end - cursor);
+		if (lineEnd == nullptr)
+		{
+			lineEnd = end;
+		}
+		const char* next = lineEnd < end ? lineEnd + 1 : end;
+		if (lineEnd > cursor && lineEnd[-1] == '\r')
+		{
+			lineEnd--;
+		}
+
+		cursor = SkipSpaces(cursor, lineEnd);
+		if (lineEnd - cursor >= 2 && cursor[0] == 'v' && (cursor[1] == ' ' || cursor[1] == '\t'))
+		{
+			float xyz[3];
+			if (ParseFloats(cursor + 2, lineEnd, xyz, 3) == nullptr)
+			{
+				chunk.failed = true;
+				return;
+			}
+			chunk.positions.push_back(glm::vec3(xyz[0], xyz[1], xyz[2]));
+		}
+		else if (lineEnd - cursor >= 3 && cursor[0] == 'v' && cursor[1] == 't' && (cursor[2] == ' ' || cursor[2] == '\t'))
+		{
+			float uv[2];
+			if (ParseFloats(cursor + 3, lineEnd, uv, 2) == nullptr)
+			{
+				chunk.failed = true;
+				return;
+			}
+			chunk.uvs.push_back(glm::vec2(uv[0], uv[1]));
+		}
+		else if (lineEnd - cursor >= 3 && cursor[0] == 'v' && cursor[1] == 'n' && (cursor[2] == ' ' || cursor[2] == '\t'))
+		{
+			float xyz[3];
+			if (ParseFloats(cursor + 3, lineEnd, xyz, 3) == nullptr)
+			{
+				chunk.failed = true;
+				return;
+			}
+			chunk.normals.push_back(glm::vec3(xyz[0], xyz[1], xyz[2]));
+		}
+		else if (lineEnd - cursor >= 2 && cursor[0] == 'f' && (cursor[1] == ' ' || cursor[1] == '\t'))
+		{
+			//Corners are v, v/vt, v//vn or v/vt/vn
+			polygon.clear();
+			const char* corner = cursor + 2;
+			while (true)
+			{
+				corner = SkipSpaces(corner, lineEnd);
+				if (corner >= lineEnd)
+				{
+					break;
+				}
+
+				int values[3] = { 0, 0, 0 };
+				for (int part = 0; part < 3 && corner < lineEnd && *corner != ' ' && *corner != '\t'; part++)
+				{
+					if (*corner != '/')
+					{
+						std::from_chars_result parsed = std::from_chars(corner, lineEnd, values[part]);
+						if (parsed.ec != std::errc())
+						{
+							chunk.failed = true;
+							return;
+						}
+						corner = parsed.ptr;
+					}
+					if (corner < lineEnd && *corner == '/')
+					{
+						corner++;
+					}
+				}
+
+				Corner resolved;
+				resolved.relative = 0;
+				resolved.position = ResolveIndex(values[0], chunk.positions.size(), RELATIVE_POSITION, resolved.relative);
+				resolved.uv = ResolveIndex(values[1], chunk.uvs.size(), RELATIVE_UV, resolved.relative);
+				resolved.normal = ResolveIndex(values[2], chunk.normals.size(), RELATIVE_NORMAL, resolved.relative);
+				if (resolved.position == MISSING_INDEX)
+				{
+					chunk.failed = true;
+					return;
+				}
+				polygon.push_back(resolved);
+			}
+
+			//Fan, polygons in OBJ are convex
+			for (size_t i = 2; i < polygon.size(); i++)
+			{
+				chunk.corners.push_back(polygon[0]);
+				chunk.corners.push_back(polygon[i - 1]);
+				chunk.corners.push_back(polygon[i]);
+			}
+		}
+		//Everything else, groups, materials, smoothing, comments, doesn't change the geometry
+
+		cursor = next;
+	}
+}
+
+static int MakeGlobal(int index, bool relative, size_t chunkOffset)
+{
+	return relative ? (int)chunkOffset + index : index;
+}
+
+struct CornerKey
+{
+	int position, uv, normal;
+
+	bool operator==(const CornerKey& other) const
+	{
+		return position == other.position && uv == other.uv && normal == other.normal;
+	}
+};
+
+struct CornerKeyHash
+{
+	size_t operator()(const CornerKey& key) const
+	{
+		//Mix each index in, a plain xor would collide on the common v/vt/vn = i/i/i files
+		uint64_t hash = (uint32_t)key.position;
+		hash = hash * 0x9E3779B97F4A7C15ull ^ (uint32_t)key.uv;
+		hash = hash * 0x9E3779B97F4A7C15ull ^ (uint32_t)key.normal;
+		hash ^= hash >> 29;
+		return (size_t)hash;
+	}
+};
+
+MeshImporter::MeshImporter(ThreadPool* pool, MeshOptimizer* optimizer)
+	: threadPool(pool), meshOptimizer(optimizer)
+{
+}
+
+bool MeshImporter::ParseOBJ(const char* text, size_t size, ew::MeshData& meshData)
+{
+	//Split at line breaks, a few chunks per thread so uneven ones balance out
+	size_t chunkCount = std::max<size_t>(std::min<size_t>(size / MIN_CHUNK_BYTES, (size_t)threadPool->GetThreadCount() * 4), 1);
+	std::vector<size_t> chunkStarts(chunkCount + 1, size);
+	chunkStarts[0] = 0;
+	for (size_t i = 1; i < chunkCount; i++)
+	{
+		size_t start = std::max(size * i / chunkCount, chunkStarts[i - 1]);
+		const char* lineBreak = (const char*)memchr(text + start, '\n', size - start);
+		chunkStarts[i] = lineBreak != nullptr ? (size_t)(lineBreak - text) + 1 : size;
+	}
+
+	std::vector<ParsedChunk> chunks(chunkCount);
+	threadPool->ParallelFor((int)chunkCount, [&](int i)
+	{
+		ParseChunk(text + chunkStarts[i], text + chunkStarts[i + 1], chunks[i]);
+	});
+
+	//Offsets of each chunk's elements in the whole file
+	std::vector<size_t> positionOffsets(chunkCount + 1, 0), uvOffsets(chunkCount + 1, 0), normalOffsets(chunkCount + 1, 0), cornerOffsets(chunkCount + 1, 0);
+	for (size_t i = 0; i < chunkCount; i++)
+	{
+		if (chunks[i].failed)
+		{
+			printf("Couldn't parse a line of the OBJ\n");
+			return false;
+		}
+		positionOffsets[i + 1] = positionOffsets[i] + chunks[i].positions.size();
+		uvOffsets[i + 1] = uvOffsets[i] + chunks[i].uvs.size();
+		normalOffsets[i + 1] = normalOffsets[i] + chunks[i].normals.size();
+		cornerOffsets[i + 1] = cornerOffsets[i] + chunks[i].corners.size();
+	}
+
+	std::vector<glm::vec3> positions(positionOffsets[chunkCount]);
+	std::vector<glm::vec2> uvs(uvOffsets[chunkCount]);
+	std::vector<glm::vec3> normals(normalOffsets[chunkCount]);
+	std::vector<Corner> corners(cornerOffsets[chunkCount]);
+	threadPool->ParallelFor((int)chunkCount, [&](int i)
+	{
+		const ParsedChunk& chunk = chunks[i];
+		std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + positionOffsets[i]);
+		std::copy(chunk.uvs.begin(), chunk.uvs.end(), uvs.begin() + uvOffsets[i]);
+		std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + normalOffsets[i]);
+		for (size_t c = 0; c < chunk.corners.size(); c++)
+		{
+			const Corner& local = chunk.corners[c];
+			Corner corner;
+			corner.position = MakeGlobal(local.position, (local.relative & RELATIVE_POSITION) != 0, positionOffsets[i]);
+			corner.uv = MakeGlobal(local.uv, (local.relative & RELATIVE_UV) != 0, uvOffsets[i]);
+			corner.normal = MakeGlobal(local.normal, (local.relative & RELATIVE_NORMAL) != 0, normalOffsets[i]);
+			corner.relative = 0;
+			corners[cornerOffsets[i] + c] = corner;
+		}
+	});
+	chunks.clear();
+
+	if (corners.empty())
+	{
+		printf("OBJ has no faces\n");
+		return false;
+	}
+
+	for (size_t c = 0; c < corners.size(); c++)
+	{
+		if (corners[c].position < 0 || corners[c].position >= (int)positions.size()
+			|| (corners[c].uv != MISSING_INDEX && (corners[c].uv < 0 || corners[c].uv >= (int)uvs.size()))
+			|| (corners[c].normal != MISSING_INDEX && (corners[c].normal < 0 || corners[c].normal >= (int)normals.size())))
+		{
+			printf("OBJ face refers to an element that doesn't exist\n");
+			return false;
+		}
+	}
+
+	//Smooth normals for corners that don't have one, area weighted around each position
+	std::vector<glm::vec3> generatedNormals;
+	for (size_t c = 0; c < corners.size(); c += 3)
+	{
+		if (corners[c].normal != MISSING_INDEX && corners[c + 1].normal != MISSING_INDEX && corners[c + 2].normal != MISSING_INDEX)
+		{
+			continue;
+		}
+		if (generatedNormals.empty())
+		{
+			generatedNormals.resize(positions.size(), glm::vec3(0));
+		}
+		const glm::vec3& p0 = positions[corners[c].position];
+		const glm::vec3& p1 = positions[corners[c + 1].position];
+		const glm::vec3& p2 = positions[corners[c + 2].position];
+		glm::vec3 faceNormal = glm::cross(p1 - p0, p2 - p0);
+		for (int k = 0; k < 3; k++)
+		{
+			generatedNormals[corners[c + k].position] += faceNormal;
+		}
+	}
+
+	//Weld corners that are the same vertex
+	std::unordered_map<CornerKey, unsigned int, CornerKeyHash> welded;
+	welded.reserve(corners.size());
+	meshData.vertices.clear();
+	meshData.lightmapUVs.clear();
+	meshData.indices.resize(corners.size());
+	for (size_t c = 0; c < corners.size(); c++)
+	{
+		CornerKey key = { corners[c].position, corners[c].uv, corners[c].normal };
+		std::pair<std::unordered_map<CornerKey, unsigned int, CornerKeyHash>::iterator, bool> inserted = welded.emplace(key, (unsigned int)meshData.vertices.size());
+		if (inserted.second)
+		{
+			glm::vec3 normal;
+			if (key.normal != MISSING_INDEX)
+			{
+				normal = normals[key.normal];
+			}
+			else
+			{
+				normal = generatedNormals[key.position];
+			}
+			float length = glm::length(normal);
+			normal = length > 0 ? normal / length : glm::vec3(0, 1, 0);
+
+			glm::vec2 uv = key.uv != MISSING_INDEX ? uvs[key.uv] : glm::vec2(0);
+			meshData.vertices.push_back(ew::Vertex(positions[key.position], normal, uv));
+		}
+		meshData.indices[c] = inserted.first->second;
+	}
+
+	lastCorners = corners.size();
+	lastChunks = (int)chunkCount;
+	return true;
+}
+
+bool MeshImporter::ReadCache(const std::string& cachePath, uint64_t sourceSize, int64_t sourceTime, ew::MeshData& meshData)
+{
+	MappedFile cache(cachePath);
+	if (cache.data == nullptr || cache.size < sizeof(CacheHeader))
+	{
+		return false;
+	}
+
+	CacheHeader header;
+	memcpy(&header, cache.data, sizeof(CacheHeader));
+	size_t expectedSize = sizeof(CacheHeader) + (size_t)header.vertexCount * sizeof(ew::Vertex) + (size_t)header.indexCount * sizeof(unsigned int);
+	if (memcmp(header.magic, CACHE_MAGIC, 4) != 0 || header.version != CACHE_VERSION
+		|| header.sourceSize != sourceSize || header.sourceTime != sourceTime || cache.size != expectedSize)
+	{
+		return false;
+	}
+
+	const char* cursor = cache.data + sizeof(CacheHeader);
+	meshData.vertices.resize(header.vertexCount, ew::Vertex(glm::vec3(0), glm::vec3(0), glm::vec2(0)));
+	memcpy(meshData.vertices.data(), cursor, header.vertexCount * sizeof(ew::Vertex));
+	cursor += header.vertexCount * sizeof(ew::Vertex);
+	meshData.indices.resize(header.indexCount);
+	memcpy(meshData.indices.data(), cursor, header.indexCount * sizeof(unsigned int));
+	meshData.lightmapUVs.clear();
+	return true;
+}
+
+void MeshImporter::WriteCache(const std::string& cachePath, uint64_t sourceSize, int64_t sourceTime, const ew::MeshData& meshData)
+{
+	CacheHeader header;
+	memcpy(header.magic, CACHE_MAGIC, 4);
+	header.version = CACHE_VERSION;
+	header.sourceSize = sourceSize;
+	header.sourceTime = sourceTime;
+	header.vertexCount = (uint32_t)meshData.vertices.size();
+	header.indexCount = (uint32_t)meshData.indices.size();
+
+	std::ofstream file(cachePath, std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		printf("Couldn't write mesh cache %s\n", cachePath.c_str());
+		return;
+	}
+	file.write((const char*)&header, sizeof(CacheHeader));
+	file.write((const char*)meshData.vertices.data(), meshData.vertices.size() * sizeof(ew::Vertex));
+	file.write((const char*)meshData.indices.data(), meshData.indices.size() * sizeof(unsigned int));
+}
+
+bool MeshImporter::Load(const std::string& path, ew::MeshData& meshData)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	std::error_code error;
+	uint64_t sourceSize = std::filesystem::file_size(path, error);
+	if (error)
+	{
+		printf("Couldn't open %s\n", path.c_str());
+		return false;
+	}
+	int64_t sourceTime = (int64_t)std::filesystem::last_write_time(path, error).time_since_epoch().count();
+
+	lastPath = path;
+	lastChunks = 0;
+	lastCorners = 0;
+
+	std::string cachePath = path + ".meshcache";
+	lastFromCache = useCache && ReadCache(cachePath, sourceSize, sourceTime, meshData);
+	if (!lastFromCache)
+	{
+		MappedFile source(path);
+		if (source.data == nullptr || !ParseOBJ(source.data, source.size, meshData))
+		{
+			printf("Couldn't import %s\n", path.c_str());
+			return false;
+		}
+
+		meshOptimizer->Optimize(meshData, std::filesystem::path(path).filename().string());
+
+		if (useCache)
+		{
+			WriteCache(cachePath, sourceSize, sourceTime, meshData);
+		}
+	}
+
+	meshData.bounds = ew::computeBounds(meshData.vertices);
+
+	lastVertices = meshData.vertices.size();
+	lastTriangles = meshData.indices.size() / 3;
+	lastLoadMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	return true;
+}
+
+void MeshImporter::ExposeImGui()
+{
+	ImGui::Checkbox("Use Mesh Cache", &useCache);
+
+	if (lastPath.empty())
+	{
+		return;
+	}
+
+	if (lastFromCache)
+	{
+		ImGui::Text("%s: cache, %.2f ms", lastPath.c_str(), lastLoadMs);
+	}
+	else
+	{
+		ImGui::Text("%s: parsed in %d chunks, %.2f ms", lastPath.c_str(), lastChunks, lastLoadMs);
+		ImGui::Text("%zu corners welded into %zu vertices", lastCorners, lastVertices);
+	}
+	ImGui::Text("%zu vertices, %zu triangles", lastVertices, lastTriangles);
+}
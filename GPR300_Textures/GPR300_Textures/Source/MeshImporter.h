@@ -0,0 +1,44 @@
+#ifndef MESH_IMPORTER_H
+#define MESH_IMPORTER_H
+
+#include <string>
+
+#include "Mesh.h"
+#include "ThreadPool.h"
+#include "MeshOptimizer.h"
+
+//Loads .obj files into ew::MeshData. The file is memory mapped and split into chunks at line breaks that are parsed
+//on the thread pool, then corners that share position, uv and normal are welded through a hash map.
+//The welded and optimized mesh is written to a .meshcache file next to the source, which later loads map and copy
+//straight into the MeshData as long as the source hasn't changed.
+class MeshImporter
+{
+public:
+	bool useCache = true;
+
+	MeshImporter(ThreadPool* pool, MeshOptimizer* optimizer);
+
+	//False, with the reason printed, when the file can't be read or has no faces
+	bool Load(const std::string& path, ew::MeshData& meshData);
+
+	void ExposeImGui();
+
+private:
+	ThreadPool* threadPool;
+	MeshOptimizer* meshOptimizer;
+
+	bool ParseOBJ(const char* text, size_t size, ew::MeshData& meshData);
+	bool ReadCache(const std::string& cachePath, uint64_t sourceSize, int64_t sourceTime, ew::MeshData& meshData);
+	void WriteCache(const std::string& cachePath, uint64_t sourceSize, int64_t sourceTime, const ew::MeshData& meshData);
+
+	//Stats of the last load
+	std::string lastPath;
+	bool lastFromCache = false;
+	double lastLoadMs = 0;
+	int lastChunks = 0;
+	size_t lastCorners = 0;
+	size_t lastVertices = 0;
+	size_t lastTriangles = 0;
+};
+
+#endif
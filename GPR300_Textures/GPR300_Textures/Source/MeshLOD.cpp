@@ -0,0 +1,130 @@
+#include "MeshLOD.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "imgui.h"
+#include "MeshSimplifier.h"
+
+//Each level aims for a quarter of the triangles of the one before, and may move the surface this much further, as a fraction of the bounding radius
+static const float LEVEL_ERRORS[MeshLOD::MAX_LEVELS] = { 0.f, .005f, .02f, .08f };
+
+//A level that can't get below this fraction of the previous one isn't worth keeping
+static const float MIN_REDUCTION = .75f;
+
+MeshLOD::MeshLOD(ew::MeshPool* pool, ew::Mesh* fullDetail, const ew::MeshData& meshData, const BoundingSphere& bounds, MeshOptimizer* optimizer, const std::string& name)
+	: name(name)
+{
+	levels.push_back(fullDetail);
+	triangleCounts.push_back((int)meshData.indices.size() / 3);
+	errors.push_back(0.f);
+
+	//Every level simplifies the full mesh, so errors don't stack up along the chain
+	std::vector<ew::MeshData> levelData;
+	for (int level = 1; level < MAX_LEVELS; level++)
+	{
+		int target = triangleCounts.back() / 4;
+		ew::MeshData data;
+		float error = MeshSimplifier::Simplify(meshData, target, LEVEL_ERRORS[level] * bounds.radius, data);
+
+		int triangles = (int)data.indices.size() / 3;
+		if (triangles == 0 || triangles > triangleCounts.back() * MIN_REDUCTION)
+		{
+			break;
+		}
+
+		optimizer->Optimize(data, name + " LOD" + std::to_string(level));
+		levelData.push_back(data);
+		triangleCounts.push_back(triangles);
+		errors.push_back(error);
+	}
+
+	//Handles only move, so the vector is filled before anything points into it
+	simplified.reserve(levelData.size());
+	for (size_t i = 0; i < levelData.size(); i++)
+	{
+		simplified.emplace_back(pool, &levelData[i]);
+	}
+	for (size_t i = 0; i < simplified.size(); i++)
+	{
+		levels.push_back(&simplified[i]);
+	}
+
+	selections.resize(levels.size(), 0);
+	lastSelections.resize(levels.size(), 0);
+}
+
+int MeshLOD::LevelForArea(float pixelArea) const
+{
+	//Finest level that still gets its pixelsPerTriangle
+	for (size_t level = 0; level < levels.size(); level++)
+	{
+		if (triangleCounts[level] * pixelsPerTriangle <= pixelArea)
+		{
+			return (int)level;
+		}
+	}
+	return (int)levels.size() - 1;
+}
+
+int MeshLOD::SelectLevel(Camera& camera, int screenHeight, const BoundingSphere& worldBounds, int currentLevel)
+{
+	int level = 0;
+	if (enabled)
+	{
+		//Radius of the bounds on screen, in pixels
+		float pixelRadius;
+		if (camera.isOrtho())
+		{
+			pixelRadius = worldBounds.radius / camera.getOrthoSize() * screenHeight;
+		}
+		else
+		{
+			float distance = glm::length(worldBounds.center - camera.getPosition());
+			float tanHalfFov = tanf(glm::radians(camera.getFov()) * .5f);
+			pixelRadius = distance > worldBounds.radius ? worldBounds.radius / (distance * tanHalfFov) * screenHeight * .5f : (float)screenHeight;
+		}
+		float pixelArea = 3.14159265f * pixelRadius * pixelRadius;
+
+		level = LevelForArea(pixelArea);
+
+		//Stay put while a little larger or smaller would still allow the current level
+		if (currentLevel >= 0 && currentLevel < (int)levels.size() && level != currentLevel)
+		{
+			int finest = LevelForArea(pixelArea * (1.f + hysteresis));
+			int coarsest = LevelForArea(pixelArea * (1.f - hysteresis));
+			if (currentLevel >= finest && currentLevel <= coarsest)
+			{
+				level = currentLevel;
+			}
+		}
+	}
+
+	selections[level]++;
+	return level;
+}
+
+void MeshLOD::BeginFrame()
+{
+	lastSelections = selections;
+	std::fill(selections.begin(), selections.end(), 0);
+}
+
+void MeshLOD::ExposeImGui()
+{
+	ImGui::Checkbox((name + " LODs").c_str(), &enabled);
+
+	if (enabled)
+	{
+		ImGui::SliderFloat((name + " Pixels Per Triangle").c_str(), &pixelsPerTriangle, 1.f, 256.f, "%.1f", ImGuiSliderFlags_Logarithmic);
+		ImGui::SliderFloat((name + " LOD Hysteresis").c_str(), &hysteresis, 0.f, .9f);
+	}
+
+	int drawnTriangles = 0;
+	for (size_t level = 0; level < levels.size(); level++)
+	{
+		ImGui::Text("LOD%d: %d tris, error %.4f, drawn %d times", (int)level, triangleCounts[level], errors[level], lastSelections[level]);
+		drawnTriangles += triangleCounts[level] * lastSelections[level];
+	}
+	ImGui::Text("%s triangles drawn: %d", name.c_str(), drawnTriangles);
+}
@@ -0,0 +1,54 @@
+#ifndef MESH_LOD_H
+#define MESH_LOD_H
+
+#include <string>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "Mesh.h"
+#include "Camera.h"
+#include "MeshOptimizer.h"
+#include "ObjectLightCuller.h"
+
+//A mesh and a chain of simplified copies of it, each draw picks one from how many pixels its bounds cover
+class MeshLOD
+{
+public:
+	//Full detail included
+	static const int MAX_LEVELS = 4;
+
+	bool enabled = true;
+	float pixelsPerTriangle = 16.f;	//A coarser level is picked once the finer one would put fewer pixels than this on each triangle
+	float hysteresis = .25f;	//How far past a threshold the projected area has to move before the level changes
+
+	//fullDetail is level 0 and stays owned by the caller, the simplified levels are optimized and go into pool
+	MeshLOD(ew::MeshPool* pool, ew::Mesh* fullDetail, const ew::MeshData& meshData, const BoundingSphere& bounds, MeshOptimizer* optimizer, const std::string& name);
+
+	//Level for world space bounds on a screenHeight pixel tall screen, it only moves away from currentLevel once the
+	//size is outside the hysteresis band, so objects sitting on a threshold don't flicker between levels
+	int SelectLevel(Camera& camera, int screenHeight, const BoundingSphere& worldBounds, int currentLevel);
+
+	ew::Mesh& GetLevel(int level) { return *levels[level]; }
+	int GetLevelCount() const { return (int)levels.size(); }
+
+	//Starts counting the levels picked this frame, for the UI
+	void BeginFrame();
+
+	void ExposeImGui();
+
+private:
+	std::string name;
+
+	std::vector<ew::Mesh> simplified;
+	std::vector<ew::Mesh*> levels;
+	std::vector<int> triangleCounts;
+	std::vector<float> errors;
+
+	std::vector<int> selections;
+	std::vector<int> lastSelections;
+
+	int LevelForArea(float pixelArea) const;
+};
+
+#endif
@@ -0,0 +1,313 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "imgui.h"
+
+int MeshOptimizer::CountCacheMisses(const ew::MeshData& meshData)
+{
+	//A FIFO cache, a vertex is still in it while fewer than CACHE_SIZE misses happened since it went in
+	std::vector<int> cacheTime(meshData.vertices.size(), 0);
+	int time = CACHE_SIZE + 1;
+	int misses = 0;
+	for (size_t i = 0; i < meshData.indices.size(); i++)
+	{
+		unsigned int vertex = meshData.indices[i];
+		if (time - cacheTime[vertex] > CACHE_SIZE)
+		{
+			cacheTime[vertex] = time;
+			time++;
+			misses++;
+		}
+	}
+	return misses;
+}
+
+float MeshOptimizer::ComputeACMR(const ew::MeshData& meshData)
+{
+	size_t triangleCount = meshData.indices.size() / 3;
+	return triangleCount == 0 ? 0.f : (float)CountCacheMisses(meshData) / triangleCount;
+}
+
+float MeshOptimizer::ComputeATVR(const ew::MeshData& meshData)
+{
+	return meshData.vertices.empty() ? 0.f : (float)CountCacheMisses(meshData) / meshData.vertices.size();
+}
+
+std::vector<unsigned int> MeshOptimizer::Tipsify(const ew::MeshData& meshData, std::vector<int>& clusterStarts)
+{
+	const std::vector<unsigned int>& indices = meshData.indices;
+	int vertexCount = (int)meshData.vertices.size();
+	int triangleCount = (int)indices.size() / 3;
+
+	//Triangles around each vertex, packed one vertex after the other
+	std::vector<int> liveTriangles(vertexCount, 0);
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		liveTriangles[indices[i]]++;
+	}
+
+	std::vector<int> adjacencyStart(vertexCount + 1, 0);
+	for (int v = 0; v < vertexCount; v++)
+	{
+		adjacencyStart[v + 1] = adjacencyStart[v] + liveTriangles[v];
+	}
+
+	std::vector<int> adjacency(indices.size());
+	std::vector<int> filled(adjacencyStart.begin(), adjacencyStart.end() - 1);
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		adjacency[filled[indices[i]]++] = (int)(i / 3);
+	}
+
+	std::vector<int> cacheTime(vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<unsigned int> deadEnds;
+	std::vector<unsigned int> candidates;
+
+	std::vector<unsigned int> order;
+	order.reserve(triangleCount);
+	clusterStarts.clear();
+	clusterStarts.push_back(0);
+
+	int time = CACHE_SIZE + 1;
+	int cursor = 0;
+	int fanning = vertexCount > 0 ? 0 : -1;
+
+	while (fanning >= 0)
+	{
+		//Emit every triangle left around the fanning vertex
+		candidates.clear();
+		for (int a = adjacencyStart[fanning]; a < adjacencyStart[fanning + 1]; a++)
+		{
+			int triangle = adjacency[a];
+			if (emitted[triangle])
+			{
+				continue;
+			}
+
+			for (int c = 0; c < 3; c++)
+			{
+				unsigned int vertex = indices[triangle * 3 + c];
+				deadEnds.push_back(vertex);
+				candidates.push_back(vertex);
+				liveTriangles[vertex]--;
+				if (time - cacheTime[vertex] > CACHE_SIZE)
+				{
+					cacheTime[vertex] = time;
+					time++;
+				}
+			}
+
+			emitted[triangle] = true;
+			order.push_back(triangle);
+		}
+
+		//Next fan around the vertex that has been in the cache longest but will still be there after its remaining triangles
+		int next = -1;
+		int bestPriority = -1;
+		for (size_t i = 0; i < candidates.size(); i++)
+		{
+			unsigned int vertex = candidates[i];
+			if (liveTriangles[vertex] <= 0)
+			{
+				continue;
+			}
+
+			int priority = 0;
+			if (time - cacheTime[vertex] + 2 * liveTriangles[vertex] <= CACHE_SIZE)
+			{
+				priority = time - cacheTime[vertex];
+			}
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				next = (int)vertex;
+			}
+		}
+
+		//Dead end, nothing useful is left in the cache so a new cluster can start here and be moved freely
+		if (next == -1)
+		{
+			while (!deadEnds.empty())
+			{
+				unsigned int vertex = deadEnds.back();
+				deadEnds.pop_back();
+				if (liveTriangles[vertex] > 0)
+				{
+					next = (int)vertex;
+					break;
+				}
+			}
+
+			while (next == -1 && cursor < vertexCount)
+			{
+				if (liveTriangles[cursor] > 0)
+				{
+					next = cursor;
+				}
+				cursor++;
+			}
+
+			if (next != -1 && (int)order.size() != clusterStarts.back())
+			{
+				clusterStarts.push_back((int)order.size());
+			}
+		}
+
+		fanning = next;
+	}
+
+	return order;
+}
+
+void MeshOptimizer::SortClusters(ew::MeshData& meshData, const std::vector<unsigned int>& order, std::vector<int>& clusterStarts)
+{
+	struct Cluster
+	{
+		int start;
+		int end;
+		float occlusion;
+	};
+
+	const std::vector<unsigned int>& indices = meshData.indices;
+
+	glm::vec3 meshCenter = glm::vec3(0);
+	for (size_t i = 0; i < meshData.vertices.size(); i++)
+	{
+		meshCenter += meshData.vertices[i].position;
+	}
+	meshCenter /= (float)std::max<size_t>(meshData.vertices.size(), 1);
+
+	std::vector<Cluster> clusters(clusterStarts.size());
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		clusters[c].start = clusterStarts[c];
+		clusters[c].end = c + 1 < clusterStarts.size() ? clusterStarts[c + 1] : (int)order.size();
+
+		//Area weighted center and facing of the cluster
+		glm::vec3 center = glm::vec3(0);
+		glm::vec3 normal = glm::vec3(0);
+		float area = 0;
+		for (int t = clusters[c].start; t < clusters[c].end; t++)
+		{
+			const glm::vec3& p0 = meshData.vertices[indices[order[t] * 3]].position;
+			const glm::vec3& p1 = meshData.vertices[indices[order[t] * 3 + 1]].position;
+			const glm::vec3& p2 = meshData.vertices[indices[order[t] * 3 + 2]].position;
+			glm::vec3 cross = glm::cross(p1 - p0, p2 - p0);
+			float triangleArea = glm::length(cross);
+			center += (p0 + p1 + p2) / 3.f * triangleArea;
+			normal += cross;
+			area += triangleArea;
+		}
+		center = area > 0 ? center / area : meshCenter;
+
+		//Clusters facing away from the middle of the mesh are the ones most likely to hide the rest
+		float normalLength = glm::length(normal);
+		clusters[c].occlusion = normalLength > 0 ? glm::dot(center - meshCenter, normal / normalLength) : 0.f;
+	}
+
+	std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) { return a.occlusion > b.occlusion; });
+
+	std::vector<unsigned int> sorted;
+	sorted.reserve(indices.size());
+	clusterStarts.clear();
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		clusterStarts.push_back((int)sorted.size() / 3);
+		for (int t = clusters[c].start; t < clusters[c].end; t++)
+		{
+			sorted.push_back(indices[order[t] * 3]);
+			sorted.push_back(indices[order[t] * 3 + 1]);
+			sorted.push_back(indices[order[t] * 3 + 2]);
+		}
+	}
+	meshData.indices = sorted;
+}
+
+void MeshOptimizer::ReorderVertices(ew::MeshData& meshData)
+{
+	//Number vertices in the order the indices first touch them, so fetches walk the buffer forwards
+	const unsigned int UNUSED = 0xFFFFFFFF;
+	std::vector<unsigned int> remap(meshData.vertices.size(), UNUSED);
+	unsigned int nextVertex = 0;
+	for (size_t i = 0; i < meshData.indices.size(); i++)
+	{
+		unsigned int& mapped = remap[meshData.indices[i]];
+		if (mapped == UNUSED)
+		{
+			mapped = nextVertex++;
+		}
+		meshData.indices[i] = mapped;
+	}
+
+	//Vertices no triangle uses go to the end
+	for (size_t v = 0; v < remap.size(); v++)
+	{
+		if (remap[v] == UNUSED)
+		{
+			remap[v] = nextVertex++;
+		}
+	}
+
+	std::vector<ew::Vertex> vertices(meshData.vertices);
+	for (size_t v = 0; v < remap.size(); v++)
+	{
+		vertices[remap[v]] = meshData.vertices[v];
+	}
+	meshData.vertices = vertices;
+
+	if (meshData.lightmapUVs.size() == remap.size())
+	{
+		std::vector<glm::vec2> lightmapUVs(meshData.lightmapUVs.size());
+		for (size_t v = 0; v < remap.size(); v++)
+		{
+			lightmapUVs[remap[v]] = meshData.lightmapUVs[v];
+		}
+		meshData.lightmapUVs = lightmapUVs;
+	}
+}
+
+void MeshOptimizer::Optimize(ew::MeshData& meshData, const std::string& name)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	Stats stat;
+	stat.name = name;
+	stat.triangles = (int)meshData.indices.size() / 3;
+	stat.acmrBefore = ComputeACMR(meshData);
+	stat.atvrBefore = ComputeATVR(meshData);
+
+	std::vector<int> clusterStarts;
+	std::vector<unsigned int> order = Tipsify(meshData, clusterStarts);
+	SortClusters(meshData, order, clusterStarts);
+	ReorderVertices(meshData);
+
+	stat.clusters = (int)clusterStarts.size();
+	stat.acmrAfter = ComputeACMR(meshData);
+	stat.atvrAfter = ComputeATVR(meshData);
+	stat.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	//One entry per name, re-imports and rebuilt cache entries replace their last run instead of adding rows
+	std::vector<Stats>::iterator existing = std::find_if(stats.begin(), stats.end(), [&](const Stats& other) { return other.name == name; });
+	if (existing != stats.end())
+	{
+		*existing = stat;
+	}
+	else
+	{
+		stats.push_back(stat);
+	}
+}
+
+void MeshOptimizer::ExposeImGui()
+{
+	ImGui::Text("Vertex cache (FIFO %d), misses per triangle / per vertex:", CACHE_SIZE);
+	for (size_t i = 0; i < stats.size(); i++)
+	{
+		const Stats& stat = stats[i];
+		ImGui::Text("%s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, %d tris in %d clusters, %.2f ms", stat.name.c_str(),
+			stat.acmrBefore, stat.acmrAfter, stat.atvrBefore, stat.atvrAfter, stat.triangles, stat.clusters, stat.milliseconds);
+	}
+}
@@ -0,0 +1,49 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <string>
+#include <vector>
+
+#include "Mesh.h"
+
+//Reorders a mesh's triangles for the post-transform vertex cache with Tipsify, sorts the resulting clusters so
+//outward facing ones draw first to cut overdraw, then renumbers the vertices in the order they are first used.
+//Run it before anything keeps triangle or vertex indices into the mesh, like LightmapBaker::AddStaticMesh.
+class MeshOptimizer
+{
+public:
+	//FIFO size Tipsify optimizes for and the statistics are simulated with
+	static const int CACHE_SIZE = 16;
+
+	void Optimize(ew::MeshData& meshData, const std::string& name);
+
+	//Average cache misses per triangle, 0.5 is the best a regular grid can do and 3 means nothing is reused
+	static float ComputeACMR(const ew::MeshData& meshData);
+	//Average cache misses per vertex, 1 means every vertex is transformed exactly once
+	static float ComputeATVR(const ew::MeshData& meshData);
+
+	void ExposeImGui();
+
+private:
+	struct Stats
+	{
+		std::string name;
+		int triangles;
+		int clusters;
+		float acmrBefore, acmrAfter;
+		float atvrBefore, atvrAfter;
+		double milliseconds;
+	};
+
+	//Latest run of each mesh name, in the order they were first optimized
+	std::vector<Stats> stats;
+
+	static int CountCacheMisses(const ew::MeshData& meshData);
+
+	//Returns the triangle order, and where each cluster starts in it
+	static std::vector<unsigned int> Tipsify(const ew::MeshData& meshData, std::vector<int>& clusterStarts);
+	static void SortClusters(ew::MeshData& meshData, const std::vector<unsigned int>& order, std::vector<int>& clusterStarts);
+	static void ReorderVertices(ew::MeshData& meshData);
+};
+
+#endif
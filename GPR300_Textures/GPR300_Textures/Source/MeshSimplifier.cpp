@@ -0,0 +1,288 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <utility>
+
+//How much a difference in normal or uv along an edge counts for, against the squared distance of the quadric
+static const double ATTRIBUTE_WEIGHT = 1.0;
+
+//Symmetric 4x4 matrix, the upper triangle row by row. Planes are weighted by area, and the total weight divides the
+//error back out so it reads as a squared distance.
+struct Quadric
+{
+	double m[10] = {};
+	double weight = 0;
+
+	void AddPlane(const glm::dvec3& normal, double d, double weight)
+	{
+		double plane[4] = { normal.x, normal.y, normal.z, d };
+		int k = 0;
+		for (int row = 0; row < 4; row++)
+		{
+			for (int column = row; column < 4; column++)
+			{
+				m[k++] += plane[row] * plane[column] * weight;
+			}
+		}
+		this->weight += weight;
+	}
+
+	void Add(const Quadric& other)
+	{
+		for (int i = 0; i < 10; i++)
+		{
+			m[i] += other.m[i];
+		}
+		weight += other.weight;
+	}
+
+	double Evaluate(const glm::dvec3& p) const
+	{
+		double v[4] = { p.x, p.y, p.z, 1.0 };
+		double error = 0;
+		int k = 0;
+		for (int row = 0; row < 4; row++)
+		{
+			for (int column = row; column < 4; column++)
+			{
+				error += m[k++] * v[row] * v[column] * (row == column ? 1.0 : 2.0);
+			}
+		}
+		return weight > 0 ? std::max(error, 0.0) / weight : 0.0;
+	}
+};
+
+struct Collapse
+{
+	unsigned int from;
+	unsigned int to;
+	double cost;
+};
+
+float MeshSimplifier::Simplify(const ew::MeshData& source, int targetTriangles, float maxError, ew::MeshData& result)
+{
+	double maxCost = (double)maxError * maxError;
+
+	const std::vector<ew::Vertex>& vertices = source.vertices;
+	size_t vertexCount = vertices.size();
+	std::vector<unsigned int> indices = source.indices;
+
+	//Every edge used by only one triangle is open, its vertices are locked
+	std::map<std::pair<unsigned int, unsigned int>, int> edgeUses;
+	for (size_t t = 0; t + 2 < indices.size(); t += 3)
+	{
+		for (int e = 0; e < 3; e++)
+		{
+			unsigned int a = indices[t + e];
+			unsigned int b = indices[t + (e + 1) % 3];
+			edgeUses[std::make_pair(std::min(a, b), std::max(a, b))]++;
+		}
+	}
+
+	std::vector<bool> locked(vertexCount, false);
+	for (std::map<std::pair<unsigned int, unsigned int>, int>::iterator it = edgeUses.begin(); it != edgeUses.end(); ++it)
+	{
+		if (it->second == 1)
+		{
+			locked[it->first.first] = true;
+			locked[it->first.second] = true;
+		}
+	}
+
+	//Area weighted planes of the triangles around each vertex
+	std::vector<Quadric> quadrics(vertexCount);
+	for (size_t t = 0; t + 2 < indices.size(); t += 3)
+	{
+		glm::dvec3 p0 = vertices[indices[t]].position;
+		glm::dvec3 p1 = vertices[indices[t + 1]].position;
+		glm::dvec3 p2 = vertices[indices[t + 2]].position;
+		glm::dvec3 cross = glm::cross(p1 - p0, p2 - p0);
+		double area = glm::length(cross);
+		if (area <= 0)
+		{
+			continue;
+		}
+
+		glm::dvec3 normal = cross / area;
+		double d = -glm::dot(normal, p0);
+		for (int c = 0; c < 3; c++)
+		{
+			quadrics[indices[t + c]].AddPlane(normal, d, area);
+		}
+	}
+
+	double largestCost = 0;
+	std::vector<unsigned int> remap(vertexCount);
+	std::vector<bool> touched(vertexCount);
+	std::vector<Collapse> collapses;
+	std::vector<int> adjacencyStart(vertexCount + 1);
+	std::vector<int> adjacency;
+
+	size_t triangleCount = indices.size() / 3;
+	while ((int)triangleCount > targetTriangles)
+	{
+		//Triangles around each vertex, rebuilt every pass
+		std::fill(adjacencyStart.begin(), adjacencyStart.end(), 0);
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			adjacencyStart[indices[i] + 1]++;
+		}
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			adjacencyStart[v + 1] += adjacencyStart[v];
+		}
+		adjacency.resize(indices.size());
+		std::vector<int> filled(adjacencyStart.begin(), adjacencyStart.end() - 1);
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			adjacency[filled[indices[i]]++] = (int)(i / 3);
+		}
+
+		//Each half edge is a candidate, from its first vertex onto its second
+		collapses.clear();
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			unsigned int from = indices[i];
+			unsigned int to = indices[i - i % 3 + (i + 1) % 3];
+			if (locked[from])
+			{
+				continue;
+			}
+
+			Quadric combined = quadrics[from];
+			combined.Add(quadrics[to]);
+
+			const ew::Vertex& a = vertices[from];
+			const ew::Vertex& b = vertices[to];
+			glm::dvec3 edge = glm::dvec3(b.position) - glm::dvec3(a.position);
+			glm::dvec3 normalDifference = glm::dvec3(b.normal) - glm::dvec3(a.normal);
+			glm::dvec2 uvDifference = glm::dvec2(b.uv) - glm::dvec2(a.uv);
+			double attributeError = (glm::dot(normalDifference, normalDifference) + glm::dot(uvDifference, uvDifference)) * glm::dot(edge, edge);
+
+			Collapse collapse;
+			collapse.from = from;
+			collapse.to = to;
+			collapse.cost = combined.Evaluate(b.position) + ATTRIBUTE_WEIGHT * attributeError;
+			collapses.push_back(collapse);
+		}
+
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			remap[v] = (unsigned int)v;
+		}
+		std::fill(touched.begin(), touched.end(), false);
+
+		//Cheapest first, each vertex's neighbourhood changes at most once a pass so the flip test below stays valid
+		size_t removable = triangleCount - targetTriangles;
+		size_t removed = 0;
+		int applied = 0;
+		for (size_t c = 0; c < collapses.size() && removed < removable; c++)
+		{
+			const Collapse& collapse = collapses[c];
+			if (collapse.cost > maxCost)
+			{
+				break;
+			}
+			if (touched[collapse.from] || touched[collapse.to])
+			{
+				continue;
+			}
+
+			//Triangles that keep existing must not turn over
+			bool flips = false;
+			size_t shared = 0;
+			glm::vec3 target = vertices[collapse.to].position;
+			for (int a = adjacencyStart[collapse.from]; a < adjacencyStart[collapse.from + 1] && !flips; a++)
+			{
+				int t = adjacency[a];
+				unsigned int corners[3] = { indices[t * 3], indices[t * 3 + 1], indices[t * 3 + 2] };
+				if (corners[0] == collapse.to || corners[1] == collapse.to || corners[2] == collapse.to)
+				{
+					shared++;
+					continue;
+				}
+
+				glm::vec3 before[3], after[3];
+				for (int k = 0; k < 3; k++)
+				{
+					before[k] = vertices[corners[k]].position;
+					after[k] = corners[k] == collapse.from ? target : before[k];
+				}
+				glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+				glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+				flips = glm::dot(normalBefore, normalAfter) <= 0;
+			}
+			if (flips)
+			{
+				continue;
+			}
+
+			remap[collapse.from] = collapse.to;
+			quadrics[collapse.to].Add(quadrics[collapse.from]);
+			largestCost = std::max(largestCost, collapse.cost);
+			removed += shared;
+			applied++;
+
+			//Lock the whole one ring for the rest of the pass
+			for (int a = adjacencyStart[collapse.from]; a < adjacencyStart[collapse.from + 1]; a++)
+			{
+				int t = adjacency[a];
+				touched[indices[t * 3]] = true;
+				touched[indices[t * 3 + 1]] = true;
+				touched[indices[t * 3 + 2]] = true;
+			}
+		}
+
+		if (applied == 0)
+		{
+			break;
+		}
+
+		//Apply the pass and drop the triangles that collapsed
+		size_t write = 0;
+		for (size_t t = 0; t + 2 < indices.size(); t += 3)
+		{
+			unsigned int a = remap[indices[t]];
+			unsigned int b = remap[indices[t + 1]];
+			unsigned int c = remap[indices[t + 2]];
+			if (a == b || b == c || a == c)
+			{
+				continue;
+			}
+			indices[write++] = a;
+			indices[write++] = b;
+			indices[write++] = c;
+		}
+		indices.resize(write);
+		triangleCount = indices.size() / 3;
+	}
+
+	//Keep only the vertices still referenced
+	const unsigned int UNUSED = 0xFFFFFFFF;
+	std::vector<unsigned int> compact(vertexCount, UNUSED);
+	result.vertices.clear();
+	result.lightmapUVs.clear();
+	result.indices.resize(indices.size());
+	bool hasLightmapUVs = source.lightmapUVs.size() == vertexCount;
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		unsigned int& mapped = compact[indices[i]];
+		if (mapped == UNUSED)
+		{
+			mapped = (unsigned int)result.vertices.size();
+			result.vertices.push_back(vertices[indices[i]]);
+			if (hasLightmapUVs)
+			{
+				result.lightmapUVs.push_back(source.lightmapUVs[indices[i]]);
+			}
+		}
+		result.indices[i] = mapped;
+	}
+	result.bounds = ew::computeBounds(result.vertices);
+
+	return (float)sqrt(largestCost);
+}
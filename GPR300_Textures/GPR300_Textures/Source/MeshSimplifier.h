@@ -0,0 +1,18 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include "Mesh.h"
+
+//Quadric error metric edge collapse (Garland and Heckbert). Edges only collapse onto one of their own vertices, so
+//every vertex left keeps its exact normal and uvs, and a penalty on how much those differ along the edge keeps
+//collapses away from creases. Vertices on open edges, which includes every uv and normal seam since ShapeGen splits
+//the mesh there, never move, so both sides of a seam stay matched.
+class MeshSimplifier
+{
+public:
+	//Collapses until result has about targetTriangles triangles, or nothing else can collapse without flipping a
+	//triangle or moving the surface further than maxError. Returns the largest error accepted, in world units.
+	static float Simplify(const ew::MeshData& source, int targetTriangles, float maxError, ew::MeshData& result);
+};
+
+#endif
@@ -0,0 +1,226 @@
+#include "MeshletCuller.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "imgui.h"
+#include "WorldBounds.h"
+
+//Scales further apart than this stretch the normals unevenly, so the cone no longer bounds them
+static const float MAX_SCALE_SKEW = .01f;
+
+static Meshlet FinishMeshlet(const ew::MeshData& meshData, int firstIndex, int indexCount, const std::vector<unsigned int>& vertices)
+{
+	Meshlet meshlet;
+	meshlet.firstIndex = firstIndex;
+	meshlet.indexCount = indexCount;
+
+	glm::vec3 min = meshData.vertices[vertices[0]].position;
+	glm::vec3 max = min;
+	for (size_t i = 1; i < vertices.size(); i++)
+	{
+		min = glm::min(min, meshData.vertices[vertices[i]].position);
+		max = glm::max(max, meshData.vertices[vertices[i]].position);
+	}
+
+	meshlet.bounds.center = (min + max) * .5f;
+	meshlet.bounds.radius = 0.f;
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		meshlet.bounds.radius = std::max(meshlet.bounds.radius, glm::length(meshData.vertices[vertices[i]].position - meshlet.bounds.center));
+	}
+
+	//Face normals from the winding, that is what back face culling goes by
+	std::vector<glm::vec3> normals;
+	glm::vec3 sum = glm::vec3(0);
+	for (int i = firstIndex; i < firstIndex + indexCount; i += 3)
+	{
+		const glm::vec3& a = meshData.vertices[meshData.indices[i]].position;
+		const glm::vec3& b = meshData.vertices[meshData.indices[i + 1]].position;
+		const glm::vec3& c = meshData.vertices[meshData.indices[i + 2]].position;
+		glm::vec3 normal = glm::cross(b - a, c - a);
+		float length = glm::length(normal);
+		if (length > 1e-12f)
+		{
+			normals.push_back(normal / length);
+			sum += normals.back();
+		}
+	}
+
+	meshlet.coneAxis = glm::vec3(0, 0, 1);
+	meshlet.coneCutoff = 1.f;
+
+	float sumLength = glm::length(sum);
+	if (normals.empty() || sumLength < 1e-6f)
+	{
+		return meshlet;
+	}
+
+	meshlet.coneAxis = sum / sumLength;
+	float minDot = 1.f;
+	for (size_t i = 0; i < normals.size(); i++)
+	{
+		minDot = std::min(minDot, glm::dot(meshlet.coneAxis, normals[i]));
+	}
+
+	//Normals spread over more than a hemisphere always have one facing the camera
+	if (minDot > 0.f)
+	{
+		meshlet.coneCutoff = sqrtf(1.f - minDot * minDot);
+	}
+	return meshlet;
+}
+
+void MeshletCuller::Build(const ew::MeshData& meshData, std::vector<Meshlet>& meshlets)
+{
+	meshlets.clear();
+	if (meshData.indices.empty())
+	{
+		return;
+	}
+
+	//Which meshlet each vertex was last added to, so membership checks don't need a set
+	std::vector<int> vertexMeshlet(meshData.vertices.size(), -1);
+	std::vector<unsigned int> vertices;
+	int firstIndex = 0;
+
+	for (int i = 0; i + 2 < (int)meshData.indices.size(); i += 3)
+	{
+		int current = (int)meshlets.size();
+		int newVertices = 0;
+		for (int corner = 0; corner < 3; corner++)
+		{
+			unsigned int index = meshData.indices[i + corner];
+			if (vertexMeshlet[index] != current && std::find(meshData.indices.begin() + i, meshData.indices.begin() + i + corner, index) == meshData.indices.begin() + i + corner)
+			{
+				newVertices++;
+			}
+		}
+
+		int triangles = (i - firstIndex) / 3;
+		if (triangles > 0 && (triangles + 1 > MAX_TRIANGLES || (int)vertices.size() + newVertices > MAX_VERTICES))
+		{
+			meshlets.push_back(FinishMeshlet(meshData, firstIndex, i - firstIndex, vertices));
+			vertices.clear();
+			firstIndex = i;
+			current++;
+		}
+
+		for (int corner = 0; corner < 3; corner++)
+		{
+			unsigned int index = meshData.indices[i + corner];
+			if (vertexMeshlet[index] != current)
+			{
+				vertexMeshlet[index] = current;
+				vertices.push_back(index);
+			}
+		}
+	}
+
+	int end = (int)meshData.indices.size() / 3 * 3;
+	meshlets.push_back(FinishMeshlet(meshData, firstIndex, end - firstIndex, vertices));
+}
+
+void MeshletCuller::BeginFrame(Camera& camera)
+{
+	lastTested = tested;
+	lastFrustumCulled = frustumCulled;
+	lastConeCulled = coneCulled;
+	lastRangeCount = rangeCount;
+	tested = frustumCulled = coneCulled = rangeCount = 0;
+
+	ExtractFrustumPlanes(camera.getProjectionMatrix() * camera.getViewMatrix(), frustumPlanes);
+
+	cameraPos = camera.getPosition();
+}
+
+void MeshletCuller::Cull(const std::vector<Meshlet>& meshlets, const glm::mat4& model, std::vector<DrawBatch::IndexRange>& ranges)
+{
+	if (meshlets.empty())
+	{
+		return;
+	}
+
+	//Switched off it hands back the whole mesh
+	if (!enabled)
+	{
+		DrawBatch::IndexRange range;
+		range.firstIndex = meshlets.front().firstIndex;
+		range.count = meshlets.back().firstIndex + meshlets.back().indexCount - range.firstIndex;
+		ranges.push_back(range);
+		return;
+	}
+
+	float scaleX = glm::length(glm::vec3(model[0]));
+	float scaleY = glm::length(glm::vec3(model[1]));
+	float scaleZ = glm::length(glm::vec3(model[2]));
+	float maxScale = std::max(scaleX, std::max(scaleY, scaleZ));
+	float minScale = std::min(scaleX, std::min(scaleY, scaleZ));
+	bool testCones = coneCulling && maxScale > 0.f && maxScale - minScale <= maxScale * MAX_SCALE_SKEW;
+
+	//Rotation only, the scale is uniform whenever the cones are tested
+	glm::mat3 rotation = testCones ? glm::mat3(model) / maxScale : glm::mat3(1);
+
+	size_t firstRange = ranges.size();
+	for (size_t i = 0; i < meshlets.size(); i++)
+	{
+		const Meshlet& meshlet = meshlets[i];
+		tested++;
+
+		glm::vec3 center = glm::vec3(model * glm::vec4(meshlet.bounds.center, 1));
+		float radius = meshlet.bounds.radius * maxScale;
+
+		bool visible = true;
+		for (int plane = 0; plane < 6; plane++)
+		{
+			if (glm::dot(glm::vec3(frustumPlanes[plane]), center) + frustumPlanes[plane].w < -radius)
+			{
+				visible = false;
+				break;
+			}
+		}
+		if (!visible)
+		{
+			frustumCulled++;
+			continue;
+		}
+
+		//Every triangle faces away once the view direction is inside the cone's back facing range, widened by the sphere
+		if (testCones && meshlet.coneCutoff < 1.f)
+		{
+			glm::vec3 toCenter = center - cameraPos;
+			glm::vec3 axis = rotation * meshlet.coneAxis;
+			if (glm::dot(toCenter, axis) >= meshlet.coneCutoff * glm::length(toCenter) + radius)
+			{
+				coneCulled++;
+				continue;
+			}
+		}
+
+		if (ranges.size() > firstRange && ranges.back().firstIndex + ranges.back().count == meshlet.firstIndex)
+		{
+			ranges.back().count += meshlet.indexCount;
+		}
+		else
+		{
+			DrawBatch::IndexRange range;
+			range.firstIndex = meshlet.firstIndex;
+			range.count = meshlet.indexCount;
+			ranges.push_back(range);
+		}
+	}
+
+	rangeCount += (int)(ranges.size() - firstRange);
+}
+
+void MeshletCuller::ExposeImGui()
+{
+	ImGui::Checkbox("Meshlet Culling", &enabled);
+
+	if (enabled)
+	{
+		ImGui::Checkbox("Normal Cone Culling", &coneCulling);
+		ImGui::Text("Meshlets: %d tested, %d off screen, %d back facing", lastTested, lastFrustumCulled, lastConeCulled);
+		ImGui::Text("%d drawn as %d index ranges", lastTested - lastFrustumCulled - lastConeCulled, lastRangeCount);
+	}
+}
@@ -0,0 +1,64 @@
+#ifndef MESHLET_CULLER_H
+#define MESHLET_CULLER_H
+
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "Mesh.h"
+#include "Camera.h"
+#include "DrawBatch.h"
+#include "ObjectLightCuller.h"
+
+//A run of a mesh's triangles, small enough that its bounds and the spread of its normals are tight
+struct Meshlet
+{
+	int firstIndex;	//Relative to the mesh's first index
+	int indexCount;
+	BoundingSphere bounds;
+	glm::vec3 coneAxis;	//Average facing of the triangles
+	float coneCutoff;	//Sine of the widest angle a triangle faces away from the axis, 1 when the cone can't cull
+};
+
+//Splits dense meshes into meshlets and rejects the ones outside the view or facing away from the camera each frame.
+//The survivors go into the draw batch as index ranges, so a mesh that is mostly off screen or seen from one side
+//only submits the triangles that can end up on screen.
+class MeshletCuller
+{
+public:
+	static const int MAX_VERTICES = 64;
+	static const int MAX_TRIANGLES = 124;
+
+	bool enabled = true;
+	bool coneCulling = true;
+
+	//Cuts the index buffer into meshlets in the order it is in, so each one is a contiguous range of it.
+	//Run it on the same optimized data the mesh was made from, the vertex cache order keeps the runs compact.
+	static void Build(const ew::MeshData& meshData, std::vector<Meshlet>& meshlets);
+
+	//Takes the camera's frustum and position for this frame's Cull calls
+	void BeginFrame(Camera& camera);
+
+	//Appends the ranges of meshlets that survive to ranges, neighbours that both survive are merged into one range.
+	//Disabled, the whole mesh is appended as one range.
+	void Cull(const std::vector<Meshlet>& meshlets, const glm::mat4& model, std::vector<DrawBatch::IndexRange>& ranges);
+
+	void ExposeImGui();
+
+private:
+	glm::vec4 frustumPlanes[6];
+	glm::vec3 cameraPos;
+
+	//Kept over the frame for the stats
+	int tested = 0;
+	int frustumCulled = 0;
+	int coneCulled = 0;
+	int rangeCount = 0;
+
+	int lastTested = 0;
+	int lastFrustumCulled = 0;
+	int lastConeCulled = 0;
+	int lastRangeCount = 0;
+};
+
+#endif
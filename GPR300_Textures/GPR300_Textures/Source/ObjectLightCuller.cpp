@@ -0,0 +1,110 @@
+#include "ObjectLightCuller.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+#include "imgui.h"
+
+BoundingSphere TransformBoundingSphere(const BoundingSphere& local, const glm::mat4& model)
+{
+	float scaleX = glm::length(glm::vec3(model[0]));
+	float scaleY = glm::length(glm::vec3(model[1]));
+	float scaleZ = glm::length(glm::vec3(model[2]));
+
+	BoundingSphere world;
+	world.center = glm::vec3(model * glm::vec4(local.center, 1));
+	world.radius = local.radius * std::max(scaleX, std::max(scaleY, scaleZ));
+	return world;
+}
+
+void ObjectLightCuller::SetLights(const LightSystem& lights, const std::vector<int>& pointLightIndices, int pointLightCount, int spotlightCount)
+{
+	lastDraws = draws;
+	lastTested = lightsTested;
+	lastKept = lightsKept;
+	draws = lightsTested = lightsKept = 0;
+
+	pointLightCount = std::min(pointLightCount, MAX_OBJECT_LIGHTS);
+	spotlightCount = std::min(spotlightCount, MAX_OBJECT_LIGHTS);
+
+	const std::vector<GPUPointLight>& gpuPointLights = lights.GetGPUPointLights();
+	const std::vector<GPUSpotLight>& gpuSpotLights = lights.GetGPUSpotlights();
+	pointLightCount = std::min(pointLightCount, (int)pointLightIndices.size());
+	spotlightCount = std::min(spotlightCount, (int)gpuSpotLights.size());
+
+	pointSpheres.resize(pointLightCount);
+	for (int i = 0; i < pointLightCount; i++)
+	{
+		pointSpheres[i] = gpuPointLights[pointLightIndices[i]].posRadius;
+	}
+
+	spotSpheres.resize(spotlightCount);
+	spotCones.resize(spotlightCount);
+	for (int i = 0; i < spotlightCount; i++)
+	{
+		const GPUSpotLight& light = gpuSpotLights[i];
+		spotSpheres[i] = light.posRadius;
+		spotCones[i] = glm::vec4(glm::vec3(light.dirFalloff), acosf(glm::clamp(std::min(light.rangeAngles.y, light.rangeAngles.z), -1.f, 1.f)));
+	}
+}
+
+void ObjectLightCuller::Apply(Shader& shader, const BoundingSphere& worldBounds)
+{
+	draws++;
+
+	int usedPointLights = 0;
+	for (int i = 0; i < (int)pointSpheres.size(); i++)
+	{
+		float reach = pointSpheres[i].w + worldBounds.radius;
+		glm::vec3 toObject = worldBounds.center - glm::vec3(pointSpheres[i]);
+		if (glm::dot(toObject, toObject) > reach * reach)
+		{
+			continue;
+		}
+
+		shader.setInt("_PointLightIndices[" + std::to_string(usedPointLights) + "]", i);
+		usedPointLights++;
+	}
+
+	int usedSpotlights = 0;
+	for (int i = 0; i < (int)spotSpheres.size(); i++)
+	{
+		glm::vec3 toObject = worldBounds.center - glm::vec3(spotSpheres[i]);
+		float lengthSq = glm::dot(toObject, toObject);
+
+		//Apex inside the object always lights it
+		if (lengthSq > worldBounds.radius * worldBounds.radius)
+		{
+			float reach = spotSpheres[i].w + worldBounds.radius;
+			if (lengthSq > reach * reach)
+			{
+				continue;
+			}
+
+			//Distance from the sphere center to the cone's surface, and whether it sits behind the apex
+			glm::vec3 dir = glm::vec3(spotCones[i]);
+			float alongAxis = glm::dot(toObject, dir);
+			float fromAxis = sqrtf(std::max(lengthSq - alongAxis * alongAxis, 0.f));
+			float closest = cosf(spotCones[i].w) * fromAxis - sinf(spotCones[i].w) * alongAxis;
+			if (closest > worldBounds.radius || alongAxis < -worldBounds.radius)
+			{
+				continue;
+			}
+		}
+
+		shader.setInt("_SpotlightIndices[" + std::to_string(usedSpotlights) + "]", i);
+		usedSpotlights++;
+	}
+
+	shader.setInt("_UsedPointLights", usedPointLights);
+	shader.setInt("_UsedSpotlights", usedSpotlights);
+
+	lightsTested += (int)pointSpheres.size() + (int)spotSpheres.size();
+	lightsKept += usedPointLights + usedSpotlights;
+}
+
+void ObjectLightCuller::ExposeImGui()
+{
+	ImGui::Text("Per-object lights: %d / %d over %d draws", lastKept, lastTested, lastDraws);
+}
@@ -0,0 +1,52 @@
+#ifndef OBJECT_LIGHT_CULLER_H
+#define OBJECT_LIGHT_CULLER_H
+
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "Mesh.h"
+#include "Shader.h"
+#include "LightSystem.h"
+
+struct BoundingSphere
+{
+	glm::vec3 center = glm::vec3(0);
+	float radius = 0.f;
+};
+
+//Moves a local sphere into world space, the radius grows by the largest axis scale so it stays conservative
+BoundingSphere TransformBoundingSphere(const BoundingSphere& local, const glm::mat4& model);
+
+//Builds the short list of forward lights that can reach each draw, so the shader skips lights that are out of range
+class ObjectLightCuller
+{
+public:
+	//Same size as the light uniform arrays in defaultLit.frag
+	static const int MAX_OBJECT_LIGHTS = 8;
+
+	//Light volumes of the forward lights, call once a frame after LightSystem::Pack and before any Apply.
+	//The forward point lights are the packed ones listed in the first pointLightCount pointLightIndices, spotlights are the first spotlightCount packed ones.
+	void SetLights(const LightSystem& lights, const std::vector<int>& pointLightIndices, int pointLightCount, int spotlightCount);
+
+	//Sets _UsedPointLights/_UsedSpotlights and the index arrays to the lights touching worldBounds
+	void Apply(Shader& shader, const BoundingSphere& worldBounds);
+
+	void ExposeImGui();
+
+private:
+	std::vector<glm::vec4> pointSpheres;
+	std::vector<glm::vec4> spotSpheres;
+	std::vector<glm::vec4> spotCones;	//direction, outer angle in radians
+
+	//Kept over the frame for the stats
+	int draws = 0;
+	int lightsTested = 0;
+	int lightsKept = 0;
+
+	int lastDraws = 0;
+	int lastTested = 0;
+	int lastKept = 0;
+};
+
+#endif
@@ -2,6 +2,8 @@
 
 #include "imgui.h"
 
+#include <algorithm>
+
 void PointLight::ExposeImGui(bool canMove)
 {
 	if (canMove)
@@ -12,4 +14,9 @@ void PointLight::ExposeImGui(bool canMove)
 	ImGui::SliderFloat("Light Intensity", &intensity, 0.f, 1.f);
 
 	ImGui::ColorEdit3("Light Color", &color.x);
+}
+
+float PointLight::GetRadius(const Attenuation& attenuation, float cutoff) const
+{
+	return attenuation.GetRadius(intensity * std::max(color.r, std::max(color.g, color.b)), cutoff);
 }
\ No newline at end of file
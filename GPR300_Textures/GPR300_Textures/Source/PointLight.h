@@ -3,6 +3,8 @@
 
 #include "glm/glm.hpp"
 
+#include "Attenuation.h"
+
 struct PointLight
 {
 	float intensity = 1.f;
@@ -12,6 +14,9 @@ struct PointLight
 	glm::vec3 pos = glm::vec3(0, 5, 0);
 
 	void ExposeImGui(bool canMove);
+
+	//Distance past which this light's contribution is below cutoff
+	float GetRadius(const Attenuation& attenuation, float cutoff) const;
 };
 
 #endif
@@ -0,0 +1,89 @@
+#include "PrimitiveCache.h"
+
+#include <tuple>
+
+#include "imgui.h"
+#include "ShapeGen.h"
+
+static const char* GENERATOR_NAMES[] = { "Cube", "Sphere", "Cylinder", "Plane" };
+
+CachedPrimitive::CachedPrimitive(ew::MeshPool* pool, ew::MeshData&& data)
+	: meshData(std::move(data)), mesh(pool, &meshData)
+{
+}
+
+bool PrimitiveCache::Key::operator<(const Key& other) const
+{
+	return std::tie(generator, params[0], params[1], params[2], segments) < std::tie(other.generator, other.params[0], other.params[1], other.params[2], other.segments);
+}
+
+PrimitiveCache::PrimitiveCache(ew::MeshPool* pool, MeshOptimizer* optimizer, ThreadPool* threadPool)
+	: meshPool(pool), meshOptimizer(optimizer), threadPool(threadPool)
+{
+}
+
+template<typename Generate>
+std::shared_ptr<CachedPrimitive> PrimitiveCache::Get(const Key& key, const std::string& name, Generate generate)
+{
+	std::weak_ptr<CachedPrimitive>& entry = entries[key];
+	std::shared_ptr<CachedPrimitive> primitive = entry.lock();
+	if (primitive)
+	{
+		hits++;
+		return primitive;
+	}
+
+	misses++;
+	ew::MeshData meshData;
+	generate(meshData);
+	meshOptimizer->Optimize(meshData, name);
+
+	primitive = std::make_shared<CachedPrimitive>(meshPool, std::move(meshData));
+	entry = primitive;
+	return primitive;
+}
+
+std::shared_ptr<CachedPrimitive> PrimitiveCache::GetCube(float width, float height, float depth)
+{
+	Key key = { Generator::Cube, { width, height, depth }, 0 };
+	return Get(key, "Cached Cube", [&](ew::MeshData& meshData) { ew::createCube(width, height, depth, meshData); });
+}
+
+std::shared_ptr<CachedPrimitive> PrimitiveCache::GetSphere(float radius, int numSegments)
+{
+	Key key = { Generator::Sphere, { radius, 0.f, 0.f }, numSegments };
+	return Get(key, "Cached Sphere", [&](ew::MeshData& meshData) { ew::createSphere(radius, numSegments, meshData, threadPool); });
+}
+
+std::shared_ptr<CachedPrimitive> PrimitiveCache::GetCylinder(float height, float radius, int numSegments)
+{
+	Key key = { Generator::Cylinder, { height, radius, 0.f }, numSegments };
+	return Get(key, "Cached Cylinder", [&](ew::MeshData& meshData) { ew::createCylinder(height, radius, numSegments, meshData); });
+}
+
+std::shared_ptr<CachedPrimitive> PrimitiveCache::GetPlane(float width, float height)
+{
+	Key key = { Generator::Plane, { width, height, 0.f }, 0 };
+	return Get(key, "Cached Plane", [&](ew::MeshData& meshData) { ew::createPlane(width, height, meshData); });
+}
+
+void PrimitiveCache::ExposeImGui()
+{
+	ImGui::Text("Primitive cache: %d hits, %d generated", hits, misses);
+
+	for (std::map<Key, std::weak_ptr<CachedPrimitive>>::iterator it = entries.begin(); it != entries.end();)
+	{
+		//Released entries are only pruned here, a lookup for the same key would rebuild them anyway
+		long users = it->second.use_count();
+		if (users == 0)
+		{
+			it = entries.erase(it);
+			continue;
+		}
+
+		std::shared_ptr<CachedPrimitive> primitive = it->second.lock();
+		ImGui::Text("  %s (%g, %g, %g, %d): %ld users, %d vertices", GENERATOR_NAMES[(int)it->first.generator], it->first.params[0], it->first.params[1],
+			it->first.params[2], it->first.segments, users, (int)primitive->meshData.vertices.size());
+		++it;
+	}
+}
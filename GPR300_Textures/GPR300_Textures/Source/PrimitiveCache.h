@@ -0,0 +1,70 @@
+#ifndef PRIMITIVE_CACHE_H
+#define PRIMITIVE_CACHE_H
+
+#include <map>
+#include <memory>
+#include <string>
+
+#include "Mesh.h"
+#include "MeshOptimizer.h"
+#include "ThreadPool.h"
+
+//A generated shape and its range of the mesh pool, shared by everything that asked for the same shape
+struct CachedPrimitive
+{
+	ew::MeshData meshData;
+	ew::Mesh mesh;
+
+	CachedPrimitive(ew::MeshPool* pool, ew::MeshData&& data);
+};
+
+//Hands out generated shapes by generator and parameters, so every object asking for the same cylinder shares one
+//copy of its vertices and one range of the pool. Its draws then carry the same base vertex and first index, which is
+//what lets DrawBatch fold them into a single instanced command. Entries are reference counted, the range goes back
+//to the pool once the last user lets go.
+//Shapes that get modified per object, like lightmap unwraps, shouldn't come from here.
+class PrimitiveCache
+{
+public:
+	PrimitiveCache(ew::MeshPool* pool, MeshOptimizer* optimizer, ThreadPool* threadPool);
+
+	std::shared_ptr<CachedPrimitive> GetCube(float width, float height, float depth);
+	std::shared_ptr<CachedPrimitive> GetSphere(float radius, int numSegments);
+	std::shared_ptr<CachedPrimitive> GetCylinder(float height, float radius, int numSegments);
+	std::shared_ptr<CachedPrimitive> GetPlane(float width, float height);
+
+	void ExposeImGui();
+
+private:
+	enum class Generator
+	{
+		Cube,
+		Sphere,
+		Cylinder,
+		Plane
+	};
+
+	struct Key
+	{
+		Generator generator;
+		float params[3];
+		int segments;
+
+		bool operator<(const Key& other) const;
+	};
+
+	ew::MeshPool* meshPool;
+	MeshOptimizer* meshOptimizer;
+	ThreadPool* threadPool;
+
+	std::map<Key, std::weak_ptr<CachedPrimitive>> entries;
+
+	int hits = 0;
+	int misses = 0;
+
+	//Finds a live entry or builds one with generate
+	template<typename Generate>
+	std::shared_ptr<CachedPrimitive> Get(const Key& key, const std::string& name, Generate generate);
+};
+
+#endif
@@ -0,0 +1,174 @@
+#include "ShaderManager.h"
+
+#include "imgui.h"
+
+//Kept tiny so it links instantly, uses the same uniform names as defaultLit.vert
+static const char* FALLBACK_VERTEX_SOURCE =
+	"#version 450\n"
+	"layout (location = 0) in vec3 vPos;\n"
+	"uniform mat4 _Model;\n"
+	"uniform mat4 _View;\n"
+	"uniform mat4 _Projection;\n"
+	"void main(){\n"
+	"    gl_Position = _Projection * _View * _Model * vec4(vPos, 1);\n"
+	"}\n";
+
+static const char* FALLBACK_FRAGMENT_SOURCE =
+	"#version 450\n"
+	"out vec4 FragColor;\n"
+	"void main(){\n"
+	"    FragColor = vec4(0.5, 0.5, 0.5, 1.0);\n"
+	"}\n";
+
+ShaderManager::ShaderManager()
+{
+	//Let the driver pick how many threads to compile on
+	if (GLEW_KHR_parallel_shader_compile)
+	{
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+	}
+
+	GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
+	glShaderSource(vertexShader, 1, &FALLBACK_VERTEX_SOURCE, NULL);
+	glCompileShader(vertexShader);
+
+	GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+	glShaderSource(fragmentShader, 1, &FALLBACK_FRAGMENT_SOURCE, NULL);
+	glCompileShader(fragmentShader);
+
+	fallbackProgram = glCreateProgram();
+	glAttachShader(fallbackProgram, vertexShader);
+	glAttachShader(fallbackProgram, fragmentShader);
+	glLinkProgram(fallbackProgram);
+
+	glDeleteShader(vertexShader);
+	glDeleteShader(fragmentShader);
+
+	Shader::setFallbackProgram(fallbackProgram);
+}
+
+ShaderManager::~ShaderManager()
+{
+	shaders.clear();
+
+	Shader::setFallbackProgram(0);
+	glDeleteProgram(fallbackProgram);
+}
+
+std::filesystem::file_time_type ShaderManager::GetWriteTime(const std::string& path)
+{
+	//Editors can briefly remove the file while saving, treat that as unchanged
+	std::error_code error;
+	std::filesystem::file_time_type time = std::filesystem::last_write_time(path, error);
+	return error ? std::filesystem::file_time_type::min() : time;
+}
+
+Shader* ShaderManager::Load(const std::string& vertexPath, const std::string& fragmentPath, const std::string& defines)
+{
+	WatchedShader watched;
+	watched.vertexWriteTime = GetWriteTime(vertexPath);
+	watched.fragmentWriteTime = GetWriteTime(fragmentPath);
+	watched.shader = std::make_unique<Shader>(vertexPath, fragmentPath, true, defines);
+
+	shaders.push_back(std::move(watched));
+
+	return shaders.back().shader.get();
+}
+
+void ShaderManager::Update(float time)
+{
+	Shader::endUniformFrame();
+
+	for (size_t i = 0; i < shaders.size(); i++)
+	{
+		shaders[i].shader->poll();
+	}
+
+	if (!hotReload || time - lastWatchTime < watchInterval)
+	{
+		return;
+	}
+
+	lastWatchTime = time;
+
+	for (size_t i = 0; i < shaders.size(); i++)
+	{
+		WatchedShader& watched = shaders[i];
+
+		std::filesystem::file_time_type vertexTime = GetWriteTime(watched.shader->getVertexPath());
+		std::filesystem::file_time_type fragmentTime = GetWriteTime(watched.shader->getFragmentPath());
+
+		if (vertexTime == std::filesystem::file_time_type::min() || fragmentTime == std::filesystem::file_time_type::min())
+		{
+			continue;
+		}
+
+		if (vertexTime != watched.vertexWriteTime || fragmentTime != watched.fragmentWriteTime)
+		{
+			watched.vertexWriteTime = vertexTime;
+			watched.fragmentWriteTime = fragmentTime;
+			watched.shader->reload();
+		}
+	}
+}
+
+void ShaderManager::ReloadAll()
+{
+	for (size_t i = 0; i < shaders.size(); i++)
+	{
+		shaders[i].shader->reload();
+	}
+}
+
+bool ShaderManager::IsCompiling()
+{
+	for (size_t i = 0; i < shaders.size(); i++)
+	{
+		if (shaders[i].shader->isCompiling())
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void ShaderManager::ExposeImGui()
+{
+	ImGui::SetNextWindowSize(ImVec2(0, 0), ImGuiCond_FirstUseEver);	//Size to fit content
+	ImGui::Begin("Shaders");
+
+	ImGui::Checkbox("Hot Reload", &hotReload);
+	ImGui::Text(GLEW_KHR_parallel_shader_compile ? "Parallel compile: supported" : "Parallel compile: unsupported");
+
+	if (ImGui::Button("Reload All"))
+	{
+		ReloadAll();
+	}
+
+	const UniformStats& uniformStats = Shader::getLastFrameUniformStats();
+	ImGui::Text("Uniform uploads last frame: %d issued, %d skipped", uniformStats.issued, uniformStats.skipped);
+
+	if (ImGui::CollapsingHeader(("Programs (" + std::to_string(shaders.size()) + ")").c_str()))
+	{
+		for (size_t i = 0; i < shaders.size(); i++)
+		{
+			Shader* shader = shaders[i].shader.get();
+
+			const char* status = shader->isCompiling() ? "compiling" : (shader->isReady() ? "ready" : "fallback");
+			ImGui::Text("%s + %s: %s", shader->getVertexPath().c_str(), shader->getFragmentPath().c_str(), status);
+
+			if (!shader->getDefines().empty() && ImGui::IsItemHovered())
+			{
+				ImGui::SetTooltip("%s", shader->getDefines().c_str());
+			}
+
+			if (!shader->getLastError().empty())
+			{
+				ImGui::TextColored(ImVec4(1, .4f, .4f, 1), "%s", shader->getLastError().c_str());
+			}
+		}
+	}
+
+	ImGui::End();
+}
@@ -0,0 +1,53 @@
+#ifndef SHADER_MANAGER_H
+#define SHADER_MANAGER_H
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "GL/glew.h"
+
+#include "Shader.h"
+
+//Owns every shader program, compiles them in the background and relinks them when their source files change
+class ShaderManager
+{
+private:
+	struct WatchedShader
+	{
+		std::unique_ptr<Shader> shader;
+		std::filesystem::file_time_type vertexWriteTime;
+		std::filesystem::file_time_type fragmentWriteTime;
+	};
+
+	std::vector<WatchedShader> shaders;
+
+	//Flat shaded program drawn with until a shader's first link finishes
+	GLuint fallbackProgram = 0;
+
+	float lastWatchTime = 0.f;
+
+	std::filesystem::file_time_type GetWriteTime(const std::string& path);
+
+public:
+	bool hotReload = true;
+	float watchInterval = .5f;	//Seconds between checks of the shader files
+
+	ShaderManager();
+	~ShaderManager();
+
+	//Starts compiling the program, the returned shader draws with the fallback program until it is ready
+	Shader* Load(const std::string& vertexPath, const std::string& fragmentPath, const std::string& defines = "");
+
+	//Polls pending compiles and, every watchInterval seconds, relinks shaders whose files changed
+	void Update(float time);
+
+	void ReloadAll();
+
+	bool IsCompiling();
+
+	void ExposeImGui();
+};
+
+#endif
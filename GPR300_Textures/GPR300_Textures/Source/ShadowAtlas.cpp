@@ -0,0 +1,300 @@
+#include "ShadowAtlas.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <string>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "imgui.h"
+#include "WorldBounds.h"
+
+//Directional tiles come first in the atlas, then spotlight tiles
+static const int SPOT_TILE_START = ShadowAtlas::MAX_SHADOWED_DIRECTIONAL_LIGHTS;
+
+static bool SphereInFrustum(const glm::vec4 planes[6], const BoundingSphere& sphere)
+{
+	for (int i = 0; i < 6; i++)
+	{
+		if (glm::dot(glm::vec3(planes[i]), sphere.center) + planes[i].w < -sphere.radius)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+//Up vector that can't be parallel to dir
+static glm::vec3 PickUp(const glm::vec3& dir)
+{
+	return fabsf(dir.y) < .99f ? glm::vec3(0, 1, 0) : glm::vec3(1, 0, 0);
+}
+
+ShadowAtlas::ShadowAtlas(ShaderManager* manager)
+{
+	depthShader = manager->Load("shaders/depthOnly.vert", "shaders/depthOnly.frag");
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &depthTexture);
+	glTextureStorage2D(depthTexture, 1, GL_DEPTH_COMPONENT32F, ATLAS_SIZE, ATLAS_SIZE);
+	glTextureParameteri(depthTexture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(depthTexture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(depthTexture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(depthTexture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	//Hardware depth compare, linear filtering then blends the results of neighbouring texels
+	glTextureParameteri(depthTexture, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTextureParameteri(depthTexture, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+	glCreateFramebuffers(1, &framebuffer);
+	glNamedFramebufferTexture(framebuffer, GL_DEPTH_ATTACHMENT, depthTexture, 0);
+	glNamedFramebufferDrawBuffer(framebuffer, GL_NONE);
+	glNamedFramebufferReadBuffer(framebuffer, GL_NONE);
+
+	if (glCheckNamedFramebufferStatus(framebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		printf("Shadow atlas framebuffer is incomplete\n");
+	}
+}
+
+ShadowAtlas::~ShadowAtlas()
+{
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteTextures(1, &depthTexture);
+}
+
+void ShadowAtlas::Invalidate()
+{
+	for (int i = 0; i < MAX_SHADOWED_DIRECTIONAL_LIGHTS; i++)
+	{
+		directionalTiles[i].dirty = true;
+	}
+	for (int i = 0; i < MAX_SHADOWED_SPOTLIGHTS; i++)
+	{
+		spotTiles[i].dirty = true;
+	}
+}
+
+void ShadowAtlas::SetTileMatrix(Tile& tile, const glm::mat4& viewProjection)
+{
+	if (viewProjection != tile.viewProjection)
+	{
+		tile.dirty = true;
+	}
+	tile.viewProjection = viewProjection;
+
+	ExtractFrustumPlanes(viewProjection, tile.frustumPlanes);
+}
+
+void ShadowAtlas::Update(const LightSystem& lights, std::vector<ShadowCaster>& casters, ew::MeshPool& meshPool)
+{
+	renderedLastFrame = 0;
+	cachedLastFrame = 0;
+
+	if (!enabled)
+	{
+		return;
+	}
+
+	//Casters that moved dirty every tile that could see them, where they were or where they are now
+	casterStates.resize(casters.size());
+	BoundingSphere newSceneBounds;
+	glm::vec3 boundsMin(INFINITY), boundsMax(-INFINITY);
+	for (size_t i = 0; i < casters.size(); i++)
+	{
+		CasterState& state = casterStates[i];
+		unsigned int version = casters[i].transform->getVersion();
+		BoundingSphere worldBounds = TransformBoundingSphere(casters[i].localBounds, casters[i].transform->getModelMatrix());
+
+		if (version != state.version)
+		{
+			for (int t = 0; t < MAX_SHADOWED_DIRECTIONAL_LIGHTS + MAX_SHADOWED_SPOTLIGHTS; t++)
+			{
+				Tile& tile = t < SPOT_TILE_START ? directionalTiles[t] : spotTiles[t - SPOT_TILE_START];
+				if (tile.used && (SphereInFrustum(tile.frustumPlanes, state.worldBounds) || SphereInFrustum(tile.frustumPlanes, worldBounds)))
+				{
+					tile.dirty = true;
+				}
+			}
+
+			state.version = version;
+			state.worldBounds = worldBounds;
+		}
+
+		boundsMin = glm::min(boundsMin, worldBounds.center - glm::vec3(worldBounds.radius));
+		boundsMax = glm::max(boundsMax, worldBounds.center + glm::vec3(worldBounds.radius));
+	}
+
+	//Directional shadows cover a box around every caster
+	if (!casters.empty())
+	{
+		newSceneBounds.center = (boundsMin + boundsMax) * .5f;
+		newSceneBounds.radius = glm::length(boundsMax - newSceneBounds.center);
+	}
+	bool sceneBoundsChanged = newSceneBounds.center != sceneBounds.center || newSceneBounds.radius != sceneBounds.radius;
+	sceneBounds = newSceneBounds;
+
+	const LightSystem::DirectionalLightArrays& directionalLights = lights.GetDirectionalLights();
+	for (int i = 0; i < MAX_SHADOWED_DIRECTIONAL_LIGHTS; i++)
+	{
+		Tile& tile = directionalTiles[i];
+		bool wasUsed = tile.used;
+		tile.used = i < lights.directionalLightCount;
+		if (!tile.used)
+		{
+			continue;
+		}
+
+		//Casters could have moved while nothing was tracking this tile
+		tile.dirty |= !wasUsed;
+
+		unsigned int version = lights.GetDirectionalLightVersion(i);
+		if (version != tile.lightVersion || sceneBoundsChanged || tile.dirty)
+		{
+			tile.lightVersion = version;
+
+			//dir points towards the light
+			glm::vec3 toLight = glm::normalize(glm::vec3(directionalLights.dirX[i], directionalLights.dirY[i], directionalLights.dirZ[i]));
+			float radius = std::max(sceneBounds.radius, .01f);
+			glm::mat4 view = glm::lookAt(sceneBounds.center + toLight * radius * 2.f, sceneBounds.center, PickUp(toLight));
+			glm::mat4 projection = glm::ortho(-radius, radius, -radius, radius, radius, radius * 3.f);
+			SetTileMatrix(tile, projection * view);
+		}
+	}
+
+	const std::vector<GPUSpotLight>& gpuSpotLights = lights.GetGPUSpotlights();
+	for (int i = 0; i < MAX_SHADOWED_SPOTLIGHTS; i++)
+	{
+		Tile& tile = spotTiles[i];
+		bool wasUsed = tile.used;
+		tile.used = i < (int)gpuSpotLights.size();
+		if (!tile.used)
+		{
+			continue;
+		}
+
+		tile.dirty |= !wasUsed;
+
+		//The radius also moves with attenuation and cutoff, which aren't part of the light's version
+		const GPUSpotLight& light = gpuSpotLights[i];
+		unsigned int version = lights.GetSpotlightVersion(i);
+		if (version != tile.lightVersion || light.posRadius.w != tile.lightRadius || tile.dirty)
+		{
+			tile.lightVersion = version;
+			tile.lightRadius = light.posRadius.w;
+
+			glm::vec3 pos = glm::vec3(light.posRadius);
+			glm::vec3 dir = glm::vec3(light.dirFalloff);
+			float outerAngle = acosf(glm::clamp(std::min(light.rangeAngles.y, light.rangeAngles.z), -1.f, 1.f));
+
+			glm::mat4 view = glm::lookAt(pos, pos + dir, PickUp(dir));
+			glm::mat4 projection = glm::perspective(std::min(outerAngle * 2.f, glm::radians(170.f)), 1.f, .05f, std::max(light.posRadius.w, .1f));
+			SetTileMatrix(tile, projection * view);
+		}
+	}
+
+	//Render whatever went stale, each tile sets its own viewport
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glEnable(GL_SCISSOR_TEST);
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(2.f, 4.f);
+
+	//Shared by every tile and caster
+	meshPool.bindDepthVertexArray();
+
+	for (int t = 0; t < MAX_SHADOWED_DIRECTIONAL_LIGHTS + MAX_SHADOWED_SPOTLIGHTS; t++)
+	{
+		Tile& tile = t < SPOT_TILE_START ? directionalTiles[t] : spotTiles[t - SPOT_TILE_START];
+		if (!tile.used)
+		{
+			continue;
+		}
+
+		if (tile.dirty)
+		{
+			RenderTile(t, tile, casters);
+			renderedLastFrame++;
+		}
+		else
+		{
+			cachedLastFrame++;
+		}
+	}
+
+	glDisable(GL_POLYGON_OFFSET_FILL);
+	glDisable(GL_SCISSOR_TEST);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+void ShadowAtlas::RenderTile(int tileIndex, Tile& tile, std::vector<ShadowCaster>& casters)
+{
+	int x = (tileIndex % TILES_PER_ROW) * TILE_SIZE;
+	int y = (tileIndex / TILES_PER_ROW) * TILE_SIZE;
+	glViewport(x, y, TILE_SIZE, TILE_SIZE);
+	glScissor(x, y, TILE_SIZE, TILE_SIZE);
+	glClear(GL_DEPTH_BUFFER_BIT);
+
+	depthShader->use();
+	depthShader->setMat4("_ViewProjection", tile.viewProjection);
+
+	for (size_t i = 0; i < casters.size(); i++)
+	{
+		if (!SphereInFrustum(tile.frustumPlanes, casterStates[i].worldBounds))
+		{
+			continue;
+		}
+
+		depthShader->setMat4("_Model", casters[i].transform->getModelMatrix());
+		casters[i].mesh->drawDepthOnly();
+	}
+
+	tile.dirty = false;
+}
+
+glm::vec4 ShadowAtlas::GetTileRect(int tileIndex)
+{
+	float scale = TILE_SIZE / (float)ATLAS_SIZE;
+	return glm::vec4((tileIndex % TILES_PER_ROW) * scale, (tileIndex / TILES_PER_ROW) * scale, scale, scale);
+}
+
+void ShadowAtlas::Bind(Shader& shader)
+{
+	glBindTextureUnit(SHADOW_ATLAS_UNIT, depthTexture);
+	shader.setInt("_ShadowAtlas", SHADOW_ATLAS_UNIT);
+	shader.setVec2("_ShadowTexelSize", glm::vec2(1.f / ATLAS_SIZE));
+
+	for (int i = 0; i < MAX_SHADOWED_DIRECTIONAL_LIGHTS; i++)
+	{
+		bool shadowed = enabled && directionalTiles[i].used;
+		shader.setMat4("_DirectionalShadowMatrix[" + std::to_string(i) + "]", directionalTiles[i].viewProjection);
+		shader.setVec4("_DirectionalShadowRect[" + std::to_string(i) + "]", shadowed ? GetTileRect(i) : glm::vec4(0));
+	}
+
+	for (int i = 0; i < MAX_SHADOWED_SPOTLIGHTS; i++)
+	{
+		bool shadowed = enabled && spotTiles[i].used;
+		shader.setMat4("_SpotlightShadowMatrix[" + std::to_string(i) + "]", spotTiles[i].viewProjection);
+		shader.setVec4("_SpotlightShadowRect[" + std::to_string(i) + "]", shadowed ? GetTileRect(SPOT_TILE_START + i) : glm::vec4(0));
+	}
+}
+
+void ShadowAtlas::ExposeImGui()
+{
+	if (ImGui::Checkbox("Shadows", &enabled) && enabled)
+	{
+		//Nothing was kept up to date while shadows were off
+		Invalidate();
+	}
+
+	if (enabled)
+	{
+		ImGui::Text("Shadow tiles: %d rendered, %d cached", renderedLastFrame, cachedLastFrame);
+		if (ImGui::Button("Re-render Shadows"))
+		{
+			Invalidate();
+		}
+	}
+}
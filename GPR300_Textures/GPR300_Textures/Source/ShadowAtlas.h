@@ -0,0 +1,91 @@
+#ifndef SHADOW_ATLAS_H
+#define SHADOW_ATLAS_H
+
+#include <vector>
+
+#include "GL/glew.h"
+#include "glm/glm.hpp"
+
+#include "Mesh.h"
+#include "Shader.h"
+#include "ShaderManager.h"
+#include "Transform.h"
+#include "LightSystem.h"
+#include "ObjectLightCuller.h"
+
+//Texture unit the lit shaders sample the atlas from, above the ones TextureManager hands out
+const GLuint SHADOW_ATLAS_UNIT = 28;
+
+//Anything that can block light
+struct ShadowCaster
+{
+	ew::Mesh* mesh;
+	ew::Transform* transform;
+	BoundingSphere localBounds;
+};
+
+//One depth texture split into tiles, a tile per shadowed directional light and spotlight.
+//A tile is only re-rendered when its light changed or a caster inside its frustum moved.
+class ShadowAtlas
+{
+public:
+	static const int ATLAS_SIZE = 4096;
+	static const int TILE_SIZE = 1024;
+	static const int TILES_PER_ROW = ATLAS_SIZE / TILE_SIZE;
+
+	//The first this many of each light type get a tile, the same as the forward light arrays
+	static const int MAX_SHADOWED_DIRECTIONAL_LIGHTS = 8;
+	static const int MAX_SHADOWED_SPOTLIGHTS = 8;
+
+	bool enabled = true;
+
+	ShadowAtlas(ShaderManager* manager);
+	~ShadowAtlas();
+
+	//Re-renders the tiles that went stale, call after LightSystem::Pack. Every caster has to live in meshPool.
+	void Update(const LightSystem& lights, std::vector<ShadowCaster>& casters, ew::MeshPool& meshPool);
+
+	//Binds the atlas and sets the shadow matrices and tile rects, lights without a tile get an empty rect
+	void Bind(Shader& shader);
+
+	//Forgets every cached tile
+	void Invalidate();
+
+	void ExposeImGui();
+
+private:
+	struct Tile
+	{
+		bool used = false;
+		bool dirty = true;
+		unsigned int lightVersion = 0;
+		float lightRadius = 0.f;
+		glm::mat4 viewProjection = glm::mat4(1);
+		glm::vec4 frustumPlanes[6];
+	};
+
+	struct CasterState
+	{
+		unsigned int version = 0;
+		BoundingSphere worldBounds;
+	};
+
+	Shader* depthShader;
+
+	GLuint framebuffer = 0;
+	GLuint depthTexture = 0;
+
+	Tile directionalTiles[MAX_SHADOWED_DIRECTIONAL_LIGHTS];
+	Tile spotTiles[MAX_SHADOWED_SPOTLIGHTS];
+	std::vector<CasterState> casterStates;
+	BoundingSphere sceneBounds;
+
+	int renderedLastFrame = 0;
+	int cachedLastFrame = 0;
+
+	void SetTileMatrix(Tile& tile, const glm::mat4& viewProjection);
+	void RenderTile(int tileIndex, Tile& tile, std::vector<ShadowCaster>& casters);
+	glm::vec4 GetTileRect(int tileIndex);
+};
+
+#endif
@@ -0,0 +1,80 @@
+#include "ShapeGenBenchmark.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "imgui.h"
+#include "ShapeGen.h"
+
+static double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+ShapeGenBenchmark::ShapeGenBenchmark(ThreadPool* threadPool)
+	: threadPool(threadPool)
+{
+}
+
+void ShapeGenBenchmark::Run()
+{
+	results.clear();
+
+	for (int segments = MIN_SEGMENTS; segments <= MAX_SEGMENTS; segments *= 2)
+	{
+		Result result;
+		result.segments = segments;
+		result.sphereMs = 1e30;
+		result.cylinderMs = 1e30;
+		result.sphereVertices = 2 + (std::size_t)(segments - 1) * (segments + 1);
+		result.skipped = false;
+
+		//Same counts createSphere sizes its arrays to
+		std::size_t sphereIndices = (std::size_t)segments * 3 + (std::size_t)(segments - 2) * segments * 6 + (std::size_t)(segments + 1) * 3;
+		result.sphereBytes = result.sphereVertices * sizeof(ew::Vertex) + sphereIndices * sizeof(unsigned int);
+		if (sizeof(void*) == 4 && result.sphereBytes > MAX_32BIT_SPHERE_BYTES)
+		{
+			result.skipped = true;
+			results.push_back(result);
+			continue;
+		}
+
+		for (int i = 0; i < repeats; i++)
+		{
+			//Fresh data every run, so the exact reservation is part of what's timed
+			ew::MeshData sphere;
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			ew::createSphere(.5f, segments, sphere, threadPool);
+			result.sphereMs = std::min(result.sphereMs, MillisecondsSince(start));
+			result.sphereVertices = sphere.vertices.size();
+
+			ew::MeshData cylinder;
+			start = std::chrono::high_resolution_clock::now();
+			ew::createCylinder(1.f, .5f, segments, cylinder);
+			result.cylinderMs = std::min(result.cylinderMs, MillisecondsSince(start));
+		}
+
+		results.push_back(result);
+	}
+}
+
+void ShapeGenBenchmark::ExposeImGui()
+{
+	ImGui::SliderInt("Benchmark Repeats", &repeats, 1, 10);
+	if (ImGui::Button("Benchmark Shape Generation"))
+	{
+		Run();
+	}
+
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const Result& result = results[i];
+		if (result.skipped)
+		{
+			ImGui::Text("%4d segments: skipped, a %.0f MB sphere is too large for a 32 bit build", result.segments, result.sphereBytes / (1024.0 * 1024.0));
+			continue;
+		}
+		ImGui::Text("%4d segments: sphere %.2f ms (%.1f M vertices/s), cylinder %.3f ms", result.segments, result.sphereMs,
+			result.sphereVertices / (result.sphereMs * 1000.0), result.cylinderMs);
+	}
+}
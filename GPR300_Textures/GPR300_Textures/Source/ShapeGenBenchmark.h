@@ -0,0 +1,45 @@
+#ifndef SHAPE_GEN_BENCHMARK_H
+#define SHAPE_GEN_BENCHMARK_H
+
+#include <cstddef>
+#include <vector>
+
+#include "ThreadPool.h"
+
+//Times ShapeGen's sphere and cylinder at every power of two segment count from 64 to 4096, on demand from the UI.
+//The largest sphere is close to a gigabyte of vertices and indices, so it only runs when asked, and 32 bit builds
+//skip every size that wouldn't fit comfortably in their address space.
+class ShapeGenBenchmark
+{
+public:
+	static const int MIN_SEGMENTS = 64;
+	static const int MAX_SEGMENTS = 4096;
+	//Largest sphere a 32 bit build will try, a bigger block is likely to fail to allocate
+	static const std::size_t MAX_32BIT_SPHERE_BYTES = 128u << 20;
+
+	int repeats = 3;	//Best of this many runs per size
+
+	//Spheres split their rows across threadPool, like they do everywhere else
+	ShapeGenBenchmark(ThreadPool* threadPool);
+
+	//Blocks until every size has been timed
+	void Run();
+
+	void ExposeImGui();
+
+private:
+	struct Result
+	{
+		int segments;
+		double sphereMs;
+		double cylinderMs;
+		std::size_t sphereVertices;
+		std::size_t sphereBytes;
+		bool skipped;
+	};
+
+	ThreadPool* threadPool;
+	std::vector<Result> results;
+};
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef SIMD_MATH_H
+#define SIMD_MATH_H
+
+#include <emmintrin.h>
+
+//Sine and cosine of 4 floats at once, Cephes polynomials after reducing to [-pi/4, pi/4]
+//Accurate to about 1e-7 for |x| below 8192
+inline void SinCos4(__m128 x, __m128* sinOut, __m128* cosOut)
+{
+	const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+
+	//sin(-x) = -sin(x), cos(-x) = cos(x), so work on |x|
+	__m128 sinSign = _mm_and_ps(x, signMask);
+	x = _mm_andnot_ps(signMask, x);
+
+	//Octant, rounded up to even so the remainder lands in [-pi/4, pi/4]
+	__m128i octant = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(1.27323954473516f)));
+	octant = _mm_and_si128(_mm_add_epi32(octant, _mm_set1_epi32(1)), _mm_set1_epi32(~1));
+	__m128 y = _mm_cvtepi32_ps(octant);
+
+	__m128 swapSinSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(octant, _mm_set1_epi32(4)), 29));
+	__m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_andnot_si128(_mm_sub_epi32(octant, _mm_set1_epi32(2)), _mm_set1_epi32(4)), 29));
+	__m128 useSinPoly = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(octant, _mm_set1_epi32(2)), _mm_setzero_si128()));
+	sinSign = _mm_xor_ps(sinSign, swapSinSign);
+
+	//x - y * pi/4 in three parts to keep the precision
+	x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(-0.78515625f)));
+	x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(-2.4187564849853515625e-4f)));
+	x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(-3.77489497744594108e-8f)));
+
+	__m128 z = _mm_mul_ps(x, x);
+
+	__m128 cosPoly = _mm_set1_ps(2.443315711809948e-5f);
+	cosPoly = _mm_add_ps(_mm_mul_ps(cosPoly, z), _mm_set1_ps(-1.388731625493765e-3f));
+	cosPoly = _mm_add_ps(_mm_mul_ps(cosPoly, z), _mm_set1_ps(4.166664568298827e-2f));
+	cosPoly = _mm_mul_ps(_mm_mul_ps(cosPoly, z), z);
+	cosPoly = _mm_add_ps(_mm_sub_ps(cosPoly, _mm_mul_ps(z, _mm_set1_ps(.5f))), _mm_set1_ps(1.f));
+
+	__m128 sinPoly = _mm_set1_ps(-1.9515295891e-4f);
+	sinPoly = _mm_add_ps(_mm_mul_ps(sinPoly, z), _mm_set1_ps(8.3321608736e-3f));
+	sinPoly = _mm_add_ps(_mm_mul_ps(sinPoly, z), _mm_set1_ps(-1.6666654611e-1f));
+	sinPoly = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(sinPoly, z), x), x);
+
+	//Odd octant pairs swap which polynomial is the sine
+	__m128 sinValue = _mm_or_ps(_mm_and_ps(useSinPoly, sinPoly), _mm_andnot_ps(useSinPoly, cosPoly));
+	__m128 cosValue = _mm_or_ps(_mm_and_ps(useSinPoly, cosPoly), _mm_andnot_ps(useSinPoly, sinPoly));
+
+	*sinOut = _mm_xor_ps(sinValue, sinSign);
+	*cosOut = _mm_xor_ps(cosValue, cosSign);
+}
+
+#endif
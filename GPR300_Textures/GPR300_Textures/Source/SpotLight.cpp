@@ -2,6 +2,8 @@
 
 #include "imgui.h"
 
+#include <algorithm>
+
 void SpotLight::ExposeImGui(bool manuallyMove)
 {
 	if (manuallyMove)
@@ -17,4 +19,9 @@ void SpotLight::ExposeImGui(bool manuallyMove)
 	ImGui::SliderFloat("Spotlight Inner Angle", &innerAngle, 10.f, 60.f);
 	ImGui::SliderFloat("Spotlight Outer Angle", &outerAngle, 10.f, 60.f);
 	ImGui::SliderFloat("Spotlight Angle Falloff", &angleFalloff, 0.f, 6.f);
+}
+
+float SpotLight::GetRadius(const Attenuation& attenuation, float cutoff) const
+{
+	return attenuation.GetRadius(intensity * range * std::max(color.r, std::max(color.g, color.b)), cutoff);
 }
\ No newline at end of file
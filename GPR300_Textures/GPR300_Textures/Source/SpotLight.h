@@ -3,6 +3,8 @@
 
 #include "glm/glm.hpp"
 
+#include "Attenuation.h"
+
 struct SpotLight
 {
 	glm::vec3 pos = glm::vec3(0, 5, 0);
@@ -17,6 +19,9 @@ struct SpotLight
 	float angleFalloff = 2;
 
 	void ExposeImGui(bool manuallyMove);
+
+	//Distance along the cone past which this light's contribution is below cutoff, range scales the light like intensity does
+	float GetRadius(const Attenuation& attenuation, float cutoff) const;
 };
 
 #endif
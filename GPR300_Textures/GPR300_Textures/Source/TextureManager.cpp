@@ -18,4 +18,28 @@ Texture TextureManager::AddTexture(const char* filePath)
 	textureCount++;
 
 	return textures[textureCount - 1];
+}
+
+void TextureManager::SetAnisotropy(float anisotropy)
+{
+	if (!GLEW_ARB_texture_filter_anisotropic && !GLEW_EXT_texture_filter_anisotropic)
+	{
+		return;
+	}
+
+	float maxAnisotropy = 1.f;
+	glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &maxAnisotropy);
+	anisotropy = glm::clamp(anisotropy, 1.f, maxAnisotropy);
+
+	//Called every frame by the quality governor, only touch the textures when it changes
+	if (anisotropy == currentAnisotropy)
+	{
+		return;
+	}
+	currentAnisotropy = anisotropy;
+
+	for (int i = 0; i < textureCount; i++)
+	{
+		glTextureParameterf(textures[i].GetTexture(), GL_TEXTURE_MAX_ANISOTROPY, anisotropy);
+	}
 }
\ No newline at end of file
@@ -3,7 +3,8 @@
 
 #include "Texture.h"
 
-const int MAX_TEXTURES = 32;
+//Matches the _Textures arrays in the shaders, the units above are kept for G-buffer and shadow map samplers
+const int MAX_TEXTURES = 16;
 
 class TextureManager
 {
@@ -14,6 +15,12 @@ public:
 	TextureManager();
 
 	Texture AddTexture(const char* filePath);
+
+	//Max anisotropic filtering of every texture, clamped to what the driver supports
+	void SetAnisotropy(float anisotropy);
+
+private:
+	float currentAnisotropy = 1.f;
 };
 
 #endif
\ No newline at end of file
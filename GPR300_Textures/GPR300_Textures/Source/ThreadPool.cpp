@@ -0,0 +1,108 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(int threadCount)
+{
+	nextIndex = 0;
+
+	if (threadCount <= 0)
+	{
+		int hardwareThreads = (int)std::thread::hardware_concurrency();
+		threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+	}
+
+	for (int i = 0; i < threadCount; i++)
+	{
+		workers.emplace_back(&ThreadPool::WorkerLoop, this);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	wake.notify_all();
+
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		workers[i].join();
+	}
+}
+
+void ThreadPool::RunJob(const std::function<void(int)>& currentJob, int count)
+{
+	int index;
+	while ((index = nextIndex.fetch_add(1)) < count)
+	{
+		currentJob(index);
+	}
+}
+
+void ThreadPool::WorkerLoop()
+{
+	unsigned int seenGeneration = 0;
+
+	while (true)
+	{
+		const std::function<void(int)>* currentJob;
+		int count;
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&] { return quit || generation != seenGeneration; });
+
+			if (quit)
+			{
+				return;
+			}
+
+			seenGeneration = generation;
+			currentJob = job;
+			count = jobCount;
+		}
+
+		RunJob(*currentJob, count);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			busyWorkers--;
+		}
+		finished.notify_one();
+	}
+}
+
+void ThreadPool::ParallelFor(int count, const std::function<void(int)>& currentJob)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+
+	//Not worth waking anyone up
+	if (workers.empty() || count == 1)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			currentJob(i);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		job = &currentJob;
+		jobCount = count;
+		nextIndex = 0;
+		busyWorkers = (int)workers.size();
+		generation++;
+	}
+	wake.notify_all();
+
+	//The calling thread takes indices too instead of idling
+	RunJob(currentJob, count);
+
+	std::unique_lock<std::mutex> lock(mutex);
+	finished.wait(lock, [&] { return busyWorkers == 0; });
+	job = nullptr;
+}
@@ -0,0 +1,44 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//Fixed set of worker threads that split index ranges between themselves and the calling thread
+class ThreadPool
+{
+private:
+	std::vector<std::thread> workers;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable finished;
+
+	const std::function<void(int)>* job = nullptr;
+	int jobCount = 0;
+	std::atomic<int> nextIndex;
+	int busyWorkers = 0;
+	unsigned int generation = 0;
+	bool quit = false;
+
+	void WorkerLoop();
+	void RunJob(const std::function<void(int)>& currentJob, int count);
+
+public:
+	//0 uses one worker per hardware thread, minus the calling thread
+	ThreadPool(int threadCount = 0);
+	~ThreadPool();
+
+	//Calls job(i) for every i in [0, count) across the workers and blocks until all are done.
+	//Not reentrant, only call from one thread at a time.
+	void ParallelFor(int count, const std::function<void(int)>& job);
+
+	//Worker threads plus the calling thread
+	int GetThreadCount() { return (int)workers.size() + 1; }
+};
+
+#endif
@@ -0,0 +1,218 @@
+#include "TriangleBVH.h"
+
+#include <algorithm>
+#include <cmath>
+
+//Slab test, entry is where the ray enters the box
+static bool RayHitsBox(const glm::vec3& min, const glm::vec3& max, const glm::vec3& origin, const glm::vec3& invDir, float maxDistance, float& entry)
+{
+	glm::vec3 t0 = (min - origin) * invDir;
+	glm::vec3 t1 = (max - origin) * invDir;
+	glm::vec3 tNear = glm::min(t0, t1);
+	glm::vec3 tFar = glm::max(t0, t1);
+
+	entry = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.f));
+	float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+	return entry <= exit;
+}
+
+void TriangleBVH::Build(const std::vector<glm::vec3>& positions)
+{
+	int triangleCount = (int)positions.size() / 3;
+
+	nodes.clear();
+	triangles.clear();
+	triangleIndices.resize(triangleCount);
+
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	std::vector<glm::vec3> centroids(triangleCount);
+	for (int i = 0; i < triangleCount; i++)
+	{
+		triangleIndices[i] = i;
+		centroids[i] = (positions[i * 3] + positions[i * 3 + 1] + positions[i * 3 + 2]) / 3.f;
+	}
+
+	//A binary tree over n leaves never needs more than 2n - 1 nodes, reserving keeps indices stable while building
+	nodes.reserve(triangleCount * 2);
+	nodes.push_back(Node());
+	BuildNode(0, centroids, positions, 0, triangleCount, 0);
+
+	//Store the triangles in leaf order so a leaf reads one contiguous run
+	triangles.resize(triangleCount);
+	for (int i = 0; i < triangleCount; i++)
+	{
+		const glm::vec3* corners = &positions[triangleIndices[i] * 3];
+		triangles[i].v0 = corners[0];
+		triangles[i].edge1 = corners[1] - corners[0];
+		triangles[i].edge2 = corners[2] - corners[0];
+	}
+}
+
+void TriangleBVH::BuildNode(int nodeIndex, const std::vector<glm::vec3>& centroids, const std::vector<glm::vec3>& positions, int start, int count, int depth)
+{
+	glm::vec3 boundsMin = glm::vec3(INFINITY);
+	glm::vec3 boundsMax = glm::vec3(-INFINITY);
+	glm::vec3 centroidMin = glm::vec3(INFINITY);
+	glm::vec3 centroidMax = glm::vec3(-INFINITY);
+
+	for (int i = start; i < start + count; i++)
+	{
+		int triangle = triangleIndices[i];
+		for (int corner = 0; corner < 3; corner++)
+		{
+			boundsMin = glm::min(boundsMin, positions[triangle * 3 + corner]);
+			boundsMax = glm::max(boundsMax, positions[triangle * 3 + corner]);
+		}
+		centroidMin = glm::min(centroidMin, centroids[triangle]);
+		centroidMax = glm::max(centroidMax, centroids[triangle]);
+	}
+
+	nodes[nodeIndex].min = boundsMin;
+	nodes[nodeIndex].max = boundsMax;
+
+	//Split the widest axis of the centroids at the median
+	glm::vec3 extent = centroidMax - centroidMin;
+	int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+	if (count <= MAX_LEAF_TRIANGLES || depth >= MAX_DEPTH - 1 || extent[axis] <= 0.f)
+	{
+		nodes[nodeIndex].start = start;
+		nodes[nodeIndex].count = count;
+		return;
+	}
+
+	int middle = start + count / 2;
+	std::nth_element(triangleIndices.begin() + start, triangleIndices.begin() + middle, triangleIndices.begin() + start + count,
+		[&](int a, int b) { return centroids[a][axis] < centroids[b][axis]; });
+
+	int firstChild = (int)nodes.size();
+	nodes.push_back(Node());
+	nodes.push_back(Node());
+
+	nodes[nodeIndex].start = firstChild;
+	nodes[nodeIndex].count = 0;
+
+	BuildNode(firstChild, centroids, positions, start, middle - start, depth + 1);
+	BuildNode(firstChild + 1, centroids, positions, middle, start + count - middle, depth + 1);
+}
+
+template<bool ANY_HIT>
+bool TriangleBVH::Trace(const glm::vec3& origin, const glm::vec3& dir, float maxDistance, Hit& hit) const
+{
+	if (nodes.empty())
+	{
+		return false;
+	}
+
+	glm::vec3 invDir = 1.f / dir;
+	float closest = maxDistance;
+	bool found = false;
+
+	float entry;
+	if (!RayHitsBox(nodes[0].min, nodes[0].max, origin, invDir, closest, entry))
+	{
+		return false;
+	}
+
+	int stack[MAX_DEPTH];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while (stackSize > 0)
+	{
+		const Node& node = nodes[stack[--stackSize]];
+
+		if (node.count > 0)
+		{
+			//Moller-Trumbore against every triangle in the leaf
+			for (int i = node.start; i < node.start + node.count; i++)
+			{
+				const Triangle& triangle = triangles[i];
+
+				glm::vec3 p = glm::cross(dir, triangle.edge2);
+				float determinant = glm::dot(triangle.edge1, p);
+				if (fabsf(determinant) < 1e-12f)
+				{
+					continue;
+				}
+				float invDeterminant = 1.f / determinant;
+
+				glm::vec3 s = origin - triangle.v0;
+				float u = glm::dot(s, p) * invDeterminant;
+				if (u < 0.f || u > 1.f)
+				{
+					continue;
+				}
+
+				glm::vec3 q = glm::cross(s, triangle.edge1);
+				float v = glm::dot(dir, q) * invDeterminant;
+				if (v < 0.f || u + v > 1.f)
+				{
+					continue;
+				}
+
+				float t = glm::dot(triangle.edge2, q) * invDeterminant;
+				if (t <= 0.f || t >= closest)
+				{
+					continue;
+				}
+
+				if (ANY_HIT)
+				{
+					return true;
+				}
+
+				closest = t;
+				found = true;
+				hit.distance = t;
+				hit.triangle = triangleIndices[i];
+				hit.u = u;
+				hit.v = v;
+			}
+			continue;
+		}
+
+		//Visit the nearer child first so the closest hit shrinks the search early
+		float nearEntry, farEntry;
+		int nearChild = node.start;
+		int farChild = node.start + 1;
+		bool nearHit = RayHitsBox(nodes[nearChild].min, nodes[nearChild].max, origin, invDir, closest, nearEntry);
+		bool farHit = RayHitsBox(nodes[farChild].min, nodes[farChild].max, origin, invDir, closest, farEntry);
+
+		if (nearHit && farHit && farEntry < nearEntry)
+		{
+			std::swap(nearChild, farChild);
+		}
+
+		if (farHit && nearHit)
+		{
+			stack[stackSize++] = farChild;
+			stack[stackSize++] = nearChild;
+		}
+		else if (nearHit)
+		{
+			stack[stackSize++] = nearChild;
+		}
+		else if (farHit)
+		{
+			stack[stackSize++] = farChild;
+		}
+	}
+
+	return found;
+}
+
+bool TriangleBVH::Intersect(const glm::vec3& origin, const glm::vec3& dir, float maxDistance, Hit& hit) const
+{
+	return Trace<false>(origin, dir, maxDistance, hit);
+}
+
+bool TriangleBVH::Occluded(const glm::vec3& origin, const glm::vec3& dir, float maxDistance) const
+{
+	Hit unused;
+	return Trace<true>(origin, dir, maxDistance, unused);
+}
@@ -0,0 +1,63 @@
+#ifndef TRIANGLE_BVH_H
+#define TRIANGLE_BVH_H
+
+#include <vector>
+
+#include "glm/glm.hpp"
+
+//Bounding volume hierarchy over a triangle soup, for tracing rays on the CPU.
+//Read only once built, so any number of threads can trace against it at once.
+class TriangleBVH
+{
+public:
+	struct Hit
+	{
+		float distance = 0.f;
+		int triangle = -1;	//Index into the positions given to Build
+		float u = 0.f, v = 0.f;	//Barycentrics of the second and third corner
+	};
+
+	//Three positions per triangle
+	void Build(const std::vector<glm::vec3>& positions);
+
+	//Closest hit along the ray closer than maxDistance, dir does not need to be normalized but distance is in its units
+	bool Intersect(const glm::vec3& origin, const glm::vec3& dir, float maxDistance, Hit& hit) const;
+
+	//Stops at the first hit, for shadow rays
+	bool Occluded(const glm::vec3& origin, const glm::vec3& dir, float maxDistance) const;
+
+	int GetTriangleCount() const { return (int)triangleIndices.size(); }
+	int GetNodeCount() const { return (int)nodes.size(); }
+
+private:
+	static const int MAX_LEAF_TRIANGLES = 4;
+	static const int MAX_DEPTH = 64;
+
+	//Leaves have a count, inner nodes store their first child at start and the second right after it
+	struct Node
+	{
+		glm::vec3 min;
+		int start;
+		glm::vec3 max;
+		int count;
+	};
+
+	//Corner and the two edges leaving it, reordered to match the leaves
+	struct Triangle
+	{
+		glm::vec3 v0;
+		glm::vec3 edge1;
+		glm::vec3 edge2;
+	};
+
+	std::vector<Node> nodes;
+	std::vector<Triangle> triangles;
+	std::vector<int> triangleIndices;
+
+	void BuildNode(int nodeIndex, const std::vector<glm::vec3>& centroids, const std::vector<glm::vec3>& positions, int start, int count, int depth);
+
+	template<bool ANY_HIT>
+	bool Trace(const glm::vec3& origin, const glm::vec3& dir, float maxDistance, Hit& hit) const;
+};
+
+#endif
@@ -0,0 +1,95 @@
+#include "WorldBounds.h"
+
+#include <algorithm>
+#include <cmath>
+#include <emmintrin.h>
+
+#include <glm/gtc/type_ptr.hpp>
+
+BoundingSphere GetBoundingSphere(const ew::MeshData& meshData)
+{
+	BoundingSphere sphere;
+	sphere.center = meshData.bounds.center;
+	sphere.radius = meshData.bounds.radius;
+	return sphere;
+}
+
+void TransformBounds(const ew::Bounds* const* localBounds, ew::Transform* const* transforms, int count, WorldBounds* worldBounds)
+{
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+
+	for (int i = 0; i < count; i++)
+	{
+		const ew::Bounds& local = *localBounds[i];
+		glm::mat4 model = transforms[i]->getModelMatrix();
+
+		//Columns of the model matrix, the first three have w = 0
+		const float* m = glm::value_ptr(model);
+		__m128 column0 = _mm_loadu_ps(m);
+		__m128 column1 = _mm_loadu_ps(m + 4);
+		__m128 column2 = _mm_loadu_ps(m + 8);
+		__m128 column3 = _mm_loadu_ps(m + 12);
+
+		//Arvo's method, the box's center moves like a point and its half extents through the absolute matrix
+		glm::vec3 localCenter = (local.min + local.max) * .5f;
+		glm::vec3 localExtent = (local.max - local.min) * .5f;
+
+		__m128 center = _mm_add_ps(column3, _mm_add_ps(_mm_mul_ps(column0, _mm_set1_ps(localCenter.x)),
+			_mm_add_ps(_mm_mul_ps(column1, _mm_set1_ps(localCenter.y)), _mm_mul_ps(column2, _mm_set1_ps(localCenter.z)))));
+		__m128 extent = _mm_add_ps(_mm_mul_ps(_mm_and_ps(column0, absMask), _mm_set1_ps(localExtent.x)),
+			_mm_add_ps(_mm_mul_ps(_mm_and_ps(column1, absMask), _mm_set1_ps(localExtent.y)), _mm_mul_ps(_mm_and_ps(column2, absMask), _mm_set1_ps(localExtent.z))));
+
+		__m128 sphereCenter = _mm_add_ps(column3, _mm_add_ps(_mm_mul_ps(column0, _mm_set1_ps(local.center.x)),
+			_mm_add_ps(_mm_mul_ps(column1, _mm_set1_ps(local.center.y)), _mm_mul_ps(column2, _mm_set1_ps(local.center.z)))));
+
+		//Squared axis scales, transposed so lane n sums column n
+		__m128 square0 = _mm_mul_ps(column0, column0);
+		__m128 square1 = _mm_mul_ps(column1, column1);
+		__m128 square2 = _mm_mul_ps(column2, column2);
+		__m128 square3 = _mm_setzero_ps();
+		_MM_TRANSPOSE4_PS(square0, square1, square2, square3);
+		__m128 scaleSq = _mm_add_ps(_mm_add_ps(square0, square1), _mm_add_ps(square2, square3));
+
+		alignas(16) float minOut[4], maxOut[4], sphereOut[4], scaleOut[4];
+		_mm_store_ps(minOut, _mm_sub_ps(center, extent));
+		_mm_store_ps(maxOut, _mm_add_ps(center, extent));
+		_mm_store_ps(sphereOut, sphereCenter);
+		_mm_store_ps(scaleOut, scaleSq);
+
+		WorldBounds& world = worldBounds[i];
+		world.min = glm::vec3(minOut[0], minOut[1], minOut[2]);
+		world.max = glm::vec3(maxOut[0], maxOut[1], maxOut[2]);
+		world.sphere.center = glm::vec3(sphereOut[0], sphereOut[1], sphereOut[2]);
+		world.sphere.radius = local.radius * sqrtf(std::max(scaleOut[0], std::max(scaleOut[1], scaleOut[2])));
+	}
+}
+
+void ExtractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6])
+{
+	glm::mat4 m = glm::transpose(viewProjection);
+	planes[0] = m[3] + m[0];
+	planes[1] = m[3] - m[0];
+	planes[2] = m[3] + m[1];
+	planes[3] = m[3] - m[1];
+	planes[4] = m[3] + m[2];
+	planes[5] = m[3] - m[2];
+	for (int i = 0; i < 6; i++)
+	{
+		planes[i] /= glm::length(glm::vec3(planes[i]));
+	}
+}
+
+bool BoxInFrustum(const glm::vec4 planes[6], const WorldBounds& bounds)
+{
+	for (int i = 0; i < 6; i++)
+	{
+		//Corner furthest along the plane's normal
+		glm::vec3 normal = glm::vec3(planes[i]);
+		glm::vec3 corner = glm::vec3(normal.x >= 0 ? bounds.max.x : bounds.min.x, normal.y >= 0 ? bounds.max.y : bounds.min.y, normal.z >= 0 ? bounds.max.z : bounds.min.z);
+		if (glm::dot(normal, corner) + planes[i].w < 0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,31 @@
+#ifndef WORLD_BOUNDS_H
+#define WORLD_BOUNDS_H
+
+#include "glm/glm.hpp"
+
+#include "Mesh.h"
+#include "Transform.h"
+#include "ObjectLightCuller.h"
+
+//A mesh's local bounds moved into world space, the box for culling and the sphere for light assignment and LOD
+struct WorldBounds
+{
+	glm::vec3 min = glm::vec3(0);
+	glm::vec3 max = glm::vec3(0);
+	BoundingSphere sphere;
+};
+
+//Sphere stored with the mesh's data by its generator or importer
+BoundingSphere GetBoundingSphere(const ew::MeshData& meshData);
+
+//Transforms count local bounds by their transforms' model matrices with SSE. Boxes are the tight box around the
+//transformed box, spheres grow by the largest axis scale so they stay conservative.
+void TransformBounds(const ew::Bounds* const* localBounds, ew::Transform* const* transforms, int count, WorldBounds* worldBounds);
+
+//Gribb-Hartmann plane extraction, normalized so bounds can be tested by distance
+void ExtractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6]);
+
+//False only when the box is entirely outside one of the planes
+bool BoxInFrustum(const glm::vec4 planes[6], const WorldBounds& bounds);
+
+#endif
@@ -25,12 +25,35 @@
 #include "Material.h"
 #include "Texture.h"
 #include "TextureManager.h"
+#include "ShaderManager.h"
+#include "LitShaderVariants.h"
+#include "ThreadPool.h"
+#include "LightClusterer.h"
+#include "ObjectLightCuller.h"
+#include "LightSystem.h"
+#include "DeferredRenderer.h"
+#include "ShadowAtlas.h"
+#include "LightmapBaker.h"
+#include "DistantLightSH.h"
+#include "GpuTimer.h"
+#include "DynamicResolution.h"
+#include "DrawBatch.h"
+#include "FrameRingBuffer.h"
+#include "MeshOptimizer.h"
+#include "MeshLOD.h"
+#include "MeshImporter.h"
+#include "MeshletCuller.h"
+#include "WorldBounds.h"
+#include "ShapeGenBenchmark.h"
+#include "PrimitiveCache.h"
+#include "Attenuation.h"
 
 #include "PointLight.h"
 #include "DirectionalLight.h"
 #include "SpotLight.h"
 
 void processInput(GLFWwindow* window);
+void runScene(GLFWwindow* window);
 void resizeFrameBufferCallback(GLFWwindow* window, int width, int height);
 void keyboardCallback(GLFWwindow* window, int keycode, int scancode, int action, int mods);
 void mouseScrollCallback(GLFWwindow* window, double xoffset, double yoffset);
@@ -56,6 +79,13 @@ const float MOUSE_SENSITIVITY = 0.1f;
 const float CAMERA_MOVE_SPEED = 5.0f;
 const float CAMERA_ZOOM_SPEED = 3.0f;
 
+//Capacity of the shared mesh buffers, every ew::Mesh is a range of them
+const int MESH_POOL_VERTICES = 1 << 18;
+const int MESH_POOL_INDICES = 1 << 20;
+
+//Starting size of each frame's slot of the streaming ring, it doubles whenever a frame runs out
+const int FRAME_RING_SIZE = 1 << 20;
+
 Camera camera((float)SCREEN_WIDTH / (float)SCREEN_HEIGHT);
 
 Material defaultMat;
@@ -64,35 +94,55 @@ glm::vec3 bgColor = glm::vec3(0);
 
 float lightScale = .5f;
 
-const int MAX_POINT_LIGHTS = 8;
-PointLight pointLights[MAX_POINT_LIGHTS];
-int pointLightCount = 0;
+//Small cylinders in a ring around the scene, all sharing one cached mesh
+const int MAX_CYLINDER_PROPS = 256;
+int cylinderPropCount = 0;
+
+//Size of the light uniform arrays in defaultLit.frag, clustered shading reads storage buffers and can go past it
+const int MAX_FORWARD_LIGHTS = 8;
+
+const glm::vec3 LIGHT_COLORS[8] = {
+	glm::vec3(1, 1, 1), glm::vec3(0, 1, 1), glm::vec3(0, 0, 1), glm::vec3(1, 0, 1),
+	glm::vec3(1, 0, 0), glm::vec3(1, .5, 0), glm::vec3(1, 1, 0), glm::vec3(0, 1, 0)
+};
+
+const int MAX_POINT_LIGHTS = 1024;
 float pointLightRadius = 5.f;
 float pointLightHeight = 5.f;
 
 const int MAX_DIRECTIONAL_LIGHTS = 8;
-DirectionalLight directionalLights[MAX_DIRECTIONAL_LIGHTS];
-int directionalLightCount = 0;
 float directionalLightAngle = 180.f;	//Angle towards center, 0 is down, + is towards the center, - is away from the center
 
-const int MAX_SPOTLIGHTS = 8;
-SpotLight spotlights[MAX_SPOTLIGHTS];
-int spotlightCount = 0;
+const int MAX_SPOTLIGHTS = 1024;
 float spotlightRadius = 5.f;
 float spotlightHeight = 5.f;
 float spotlightAngle = 0.f;	//Angle towards center, 0 is down, + is towards the center, - is away from the center
 
-float constantAttenuation = 1.f;
-float linearAttenuation = .35f;
-float quadraticAttenuation = .44f;
+//Every light in the scene, edited through copies of the light structs
+LightSystem lightSystem(MAX_POINT_LIGHTS, MAX_SPOTLIGHTS, MAX_DIRECTIONAL_LIGHTS);
+
+Attenuation attenuation;
+float lightCutoff = 1.f / 256.f;	//Light intensity below which a light stops counting, sets every light's radius
 
 bool manuallyMoveLights = false;	//If true, allows you to move point lights manually
 
 bool phong = true;
 
+bool clusteredShading = false;	//If true, point lights and spotlights are culled per froxel and can go past MAX_FORWARD_LIGHTS
+
+bool perObjectLightCulling = true;	//If true, each draw only shades the forward lights whose radius reaches it
+
+bool deferredShading = false;	//If true, shapes go through DeferredRenderer's G-buffer instead of the lit shader and can use every light
+
+bool depthPrepass = false;	//If true, the forward path draws depth first and then shades with GL_EQUAL, so hidden fragments are never lit
+
+bool useTexture = true;
+
 bool wireFrame = false;
 
 const std::string ASSET_PATH = "./Textures/";
+
+char importPath[256] = "./Models/model.obj";	//OBJ the Shapes window imports
 const std::string TEX_FILENAME_DIAMOND_PLATE = "DiamondPlate006C_4K_Color.jpg";
 const std::string TEX_FILENAME_PAVING_STONES = "PavingStones130_4K_Color.jpg";
 
@@ -130,25 +180,133 @@ int main() {
 	//Dark UI theme.
 	ImGui::StyleColorsDark();
 
+	//The scene's GL objects are all destroyed by the time it returns, ImGui's go next, then the context
+	runScene(window);
+
+	ImGui_ImplOpenGL3_Shutdown();
+	ImGui_ImplGlfw_Shutdown();
+	ImGui::DestroyContext();
+
+	glfwTerminate();
+	return 0;
+}
+
+//Everything that owns GL objects is a local here, so the destructors run while the context is still current
+void runScene(GLFWwindow* window) {
+	//Compiles shaders in the background and relinks them when the files change
+	ShaderManager shaderManager;
+
 	//Used to draw shapes. This is the shader you will be completing.
-	Shader litShader("shaders/defaultLit.vert", "shaders/defaultLit.frag");
+	//Specialized per specular model, texturing and light counts, see LitShaderVariants
+	LitShaderVariants litVariants(&shaderManager, "shaders/defaultLit.vert", "shaders/defaultLit.frag");
+	litVariants.Prewarm();
+
+	//Worker threads for CPU side jobs like light clustering
+	ThreadPool threadPool;
+
+	//Everything uploaded once a frame, lights, clusters and draw commands, is streamed through it
+	FrameRingBuffer frameRing(FRAME_RING_SIZE);
+
+	LightClusterer lightClusterer(&threadPool, &frameRing);
+	ObjectLightCuller objectLightCuller;
+	DeferredRenderer deferredRenderer(&shaderManager, &frameRing);
+	ShadowAtlas shadowAtlas(&shaderManager);
+	LightmapBaker lightmapBaker(&threadPool);
+	DistantLightSH distantLightSH;
+	DynamicResolution dynamicResolution(&shaderManager);
+
+	//Depth prepass, the same vertex shader as the lit pass so both land on exactly the same depths
+	Shader& depthPrepassShader = *shaderManager.Load("shaders/defaultLit.vert", "shaders/depthOnly.frag");
+
+	//Forward pass timings
+	GpuTimer prepassTimer;
+	GpuTimer litTimer;
 
 	//Used to draw light sphere
-	Shader unlitShader("shaders/defaultLit.vert", "shaders/unlit.frag");
+	Shader& unlitShader = *shaderManager.Load("shaders/gizmo.vert", "shaders/unlit.frag");
+
+	//Gizmo instances, rebuilt every frame. Point lights are bucketed by the sphere LOD they pick.
+	std::vector<ew::InstanceData> pointLightGizmos[MeshLOD::MAX_LEVELS];
+	std::vector<int> pointLightGizmoLevels;
+	std::vector<ew::InstanceData> spotlightGizmos;
+
+	//Initialize shape transforms
+	ew::Transform cubeTransform;
+	ew::Transform sphereTransform;
+	ew::Transform planeTransform;
+	ew::Transform cylinderTransform;
+	ew::Transform lightTransform;
+	ew::Transform importedTransform;
+
+	cubeTransform.position = glm::vec3(-2.0f, 0.0f, 0.0f);
+	sphereTransform.position = glm::vec3(0.0f, 0.0f, 0.0f);
+
+	planeTransform.position = glm::vec3(0.0f, -1.0f, 0.0f);
+	planeTransform.scale = glm::vec3(10.0f);
+
+	cylinderTransform.position = glm::vec3(2.0f, 0.0f, 0.0f);
 
 	ew::MeshData cubeMeshData;
 	ew::createCube(1.0f, 1.0f, 1.0f, cubeMeshData);
 	ew::MeshData sphereMeshData;
-	ew::createSphere(0.5f, 64, sphereMeshData);
+	ew::createSphere(0.5f, 64, sphereMeshData, &threadPool);
 	ew::MeshData cylinderMeshData;
 	ew::createCylinder(1.0f, 0.5f, 64, cylinderMeshData);
 	ew::MeshData planeMeshData;
 	ew::createPlane(1.0f, 1.0f, planeMeshData);
 
-	ew::Mesh cubeMesh(&cubeMeshData);
-	ew::Mesh sphereMesh(&sphereMeshData);
-	ew::Mesh planeMesh(&planeMeshData);
-	ew::Mesh cylinderMesh(&cylinderMeshData);
+	//Before the lightmap unwrap, which keeps the triangle order but can't share vertices any more
+	MeshOptimizer meshOptimizer;
+	meshOptimizer.Optimize(cubeMeshData, "Cube");
+	meshOptimizer.Optimize(sphereMeshData, "Sphere");
+	meshOptimizer.Optimize(cylinderMeshData, "Cylinder");
+	meshOptimizer.Optimize(planeMeshData, "Plane");
+
+	//Static shapes get lightmaps, which unwraps them, so it has to happen before their meshes are built. The sphere stays dynamic.
+	int cubeLightmap = lightmapBaker.AddStaticMesh(&cubeMeshData, &cubeTransform, 256);
+	int cylinderLightmap = lightmapBaker.AddStaticMesh(&cylinderMeshData, &cylinderTransform, 256);
+	int planeLightmap = lightmapBaker.AddStaticMesh(&planeMeshData, &planeTransform, 512);
+
+	BoundingSphere cubeBounds = GetBoundingSphere(cubeMeshData);
+	BoundingSphere sphereBounds = GetBoundingSphere(sphereMeshData);
+	BoundingSphere cylinderBounds = GetBoundingSphere(cylinderMeshData);
+	BoundingSphere planeBounds = GetBoundingSphere(planeMeshData);
+
+	//Every shape shares one vertex and index buffer, declared first so it outlives the meshes in it
+	ew::MeshPool meshPool(MESH_POOL_VERTICES, MESH_POOL_INDICES);
+	ew::Mesh cubeMesh(&meshPool, &cubeMeshData);
+	ew::Mesh sphereMesh(&meshPool, &sphereMeshData);
+	ew::Mesh planeMesh(&meshPool, &planeMeshData);
+	ew::Mesh cylinderMesh(&meshPool, &cylinderMeshData);
+
+	//Empty until something is imported, an empty handle draws nothing
+	ew::MeshData importedMeshData;
+	ew::Mesh importedMesh(&meshPool, &importedMeshData);
+	BoundingSphere importedBounds;
+	MeshImporter meshImporter(&threadPool, &meshOptimizer);
+	ShapeGenBenchmark shapeGenBenchmark(&threadPool);
+
+	DrawBatch drawBatch(&meshPool, &frameRing);
+	ew::QuantizationError quantizationError;
+	bool quantizationMeasured = false;
+
+	//Shapes nothing modifies per object come from here, one copy each no matter how many objects use them
+	PrimitiveCache primitiveCache(&meshPool, &meshOptimizer, &threadPool);
+	//The scene cylinder is lightmap unwrapped, the light volumes and gizmos only need the plain shape
+	std::shared_ptr<CachedPrimitive> lightVolumeCylinder = primitiveCache.GetCylinder(1.0f, 0.5f, 64);
+	std::vector<std::shared_ptr<CachedPrimitive>> cylinderProps;
+	std::vector<glm::mat4> cylinderPropModels;
+
+	//The sphere doubles as every point light's gizmo, so it gets simplified levels for when it's small on screen
+	MeshLOD sphereLOD(&meshPool, &sphereMesh, sphereMeshData, sphereBounds, &meshOptimizer, "Sphere");
+	int sphereLevel = 0;
+
+	//The full detail sphere and imported meshes are dense enough to cull in pieces, the other shapes go whole
+	MeshletCuller meshletCuller;
+	std::vector<Meshlet> sphereMeshlets;
+	std::vector<Meshlet> importedMeshlets;
+	std::vector<DrawBatch::IndexRange> meshletRanges;
+	MeshletCuller::Build(sphereMeshData, sphereMeshlets);
 
 	//Enable back face culling
 	glEnable(GL_CULL_FACE);
@@ -167,57 +325,49 @@ int main() {
 	texManager.AddTexture((ASSET_PATH + TEX_FILENAME_DIAMOND_PLATE).c_str());
 	texManager.AddTexture((ASSET_PATH + TEX_FILENAME_PAVING_STONES).c_str());
 
-	//Set texture samplers
-	for (size_t i = 0; i < texManager.textureCount; i++)
+	//Every shape blocks light
+	std::vector<ShadowCaster> shadowCasters = {
+		{ &cubeMesh, &cubeTransform, cubeBounds },
+		{ &sphereMesh, &sphereTransform, sphereBounds },
+		{ &cylinderMesh, &cylinderTransform, cylinderBounds },
+		{ &planeMesh, &planeTransform, planeBounds },
+		{ &importedMesh, &importedTransform, importedBounds }
+	};
+
+	//Shapes in shadowCasters order, their bounds are moved into world space together once a frame
+	enum Shape { CUBE, SPHERE, CYLINDER, PLANE, IMPORTED, SHAPE_COUNT };
+	const ew::Bounds* shapeLocalBounds[SHAPE_COUNT] = { &cubeMeshData.bounds, &sphereMeshData.bounds, &cylinderMeshData.bounds, &planeMeshData.bounds, &importedMeshData.bounds };
+	ew::Transform* shapeTransforms[SHAPE_COUNT] = { &cubeTransform, &sphereTransform, &cylinderTransform, &planeTransform, &importedTransform };
+	WorldBounds shapeWorldBounds[SHAPE_COUNT];
+	bool shapeVisible[SHAPE_COUNT];
+	glm::vec4 cameraPlanes[6];
+	bool cullShapes = true;
+	int culledShapes = 0;
+
+	for (int i = 0; i < MAX_POINT_LIGHTS; i++)
 	{
-		//Set texture sampler to texture unit number
-		litShader.setInt("_Textures[" + std::to_string(i) + "].texSampler", i);
+		PointLight light = lightSystem.GetPointLight(i);
+		light.color = LIGHT_COLORS[i % 8];
+		lightSystem.SetPointLight(i, light);
 	}
 
-	//Initialize shape transforms
-	ew::Transform cubeTransform;
-	ew::Transform sphereTransform;
-	ew::Transform planeTransform;
-	ew::Transform cylinderTransform;
-	ew::Transform lightTransform;
-
-	cubeTransform.position = glm::vec3(-2.0f, 0.0f, 0.0f);
-	sphereTransform.position = glm::vec3(0.0f, 0.0f, 0.0f);
-
-	planeTransform.position = glm::vec3(0.0f, -1.0f, 0.0f);
-	planeTransform.scale = glm::vec3(10.0f);
-
-	cylinderTransform.position = glm::vec3(2.0f, 0.0f, 0.0f);
+	for (int i = 0; i < MAX_SPOTLIGHTS; i++)
+	{
+		SpotLight light = lightSystem.GetSpotlight(i);
+		light.color = LIGHT_COLORS[i % 8];
+		lightSystem.SetSpotlight(i, light);
+	}
 
-	pointLights[0].color = glm::vec3(1, 1, 1);
-	pointLights[1].color = glm::vec3(0, 1, 1);
-	pointLights[2].color = glm::vec3(0, 0, 1);
-	pointLights[3].color = glm::vec3(1, 0, 1);
-	pointLights[4].color = glm::vec3(1, 0, 0);
-	pointLights[5].color = glm::vec3(1, .5, 0);
-	pointLights[6].color = glm::vec3(1, 1, 0);
-	pointLights[7].color = glm::vec3(0, 1, 0);
-
-	spotlights[0].color = glm::vec3(1, 1, 1);
-	spotlights[1].color = glm::vec3(0, 1, 1);
-	spotlights[2].color = glm::vec3(0, 0, 1);
-	spotlights[3].color = glm::vec3(1, 0, 1);
-	spotlights[4].color = glm::vec3(1, 0, 0);
-	spotlights[5].color = glm::vec3(1, .5, 0);
-	spotlights[6].color = glm::vec3(1, 1, 0);
-	spotlights[7].color = glm::vec3(0, 1, 0);
-
-	directionalLights[0].color = glm::vec3(1, 1, 1);
-	directionalLights[1].color = glm::vec3(0, 1, 1);
-	directionalLights[2].color = glm::vec3(0, 0, 1);
-	directionalLights[3].color = glm::vec3(1, 0, 1);
-	directionalLights[4].color = glm::vec3(1, 0, 0);
-	directionalLights[5].color = glm::vec3(1, .5, 0);
-	directionalLights[6].color = glm::vec3(1, 1, 0);
-	directionalLights[7].color = glm::vec3(0, 1, 0);
+	for (int i = 0; i < MAX_DIRECTIONAL_LIGHTS; i++)
+	{
+		DirectionalLight light = lightSystem.GetDirectionalLight(i);
+		light.color = LIGHT_COLORS[i % 8];
+		lightSystem.SetDirectionalLight(i, light);
+	}
 
 	while (!glfwWindowShouldClose(window)) {
 		processInput(window);
+		frameRing.BeginFrame();
 		glClearColor(bgColor.r,bgColor.g,bgColor.b, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -229,6 +379,57 @@ int main() {
 		deltaTime = time - lastFrameTime;
 		lastFrameTime = time;
 
+		//Swap in any shaders that finished compiling or were edited on disk
+		shaderManager.Update(time);
+
+		//The governor may shed lights while over budget, the sliders keep what was asked for
+		int requestedPointLights = lightSystem.pointLightCount;
+		int requestedSpotlights = lightSystem.spotlightCount;
+		int governedLights = dynamicResolution.GetMaxLights();
+		if (governedLights >= 0)
+		{
+			lightSystem.pointLightCount = glm::min(lightSystem.pointLightCount, governedLights);
+			lightSystem.spotlightCount = glm::min(lightSystem.spotlightCount, governedLights);
+		}
+		texManager.SetAnisotropy(dynamicResolution.GetAnisotropy());
+
+		//Lay the lights out around their circles, then pack them for the shaders and culling
+		if (!manuallyMoveLights)
+		{
+			lightSystem.ArrangePointLights(pointLightRadius, pointLightHeight);
+			lightSystem.ArrangeDirectionalLights(directionalLightAngle);
+			lightSystem.ArrangeSpotlights(spotlightRadius, spotlightHeight, spotlightAngle);
+		}
+
+		lightSystem.Pack(attenuation, lightCutoff);
+
+		//Only re-renders the shadow maps whose light or casters moved
+		shadowAtlas.Update(lightSystem, shadowCasters, meshPool);
+
+		//Re-bakes the static shapes' lightmaps when asked to
+		lightmapBaker.Update(lightSystem, attenuation, defaultMat);
+
+		//Everything 3D from here on goes into the scaled scene target
+		dynamicResolution.BeginScene(SCREEN_WIDTH, SCREEN_HEIGHT, bgColor);
+
+		const std::vector<GPUPointLight>& gpuPointLights = lightSystem.GetGPUPointLights();
+		const std::vector<GPUSpotLight>& gpuSpotLights = lightSystem.GetGPUSpotlights();
+
+		//Lights past the uniform arrays only exist in the clustered and deferred paths
+		bool listedLights = clusteredShading || deferredShading;
+
+		//Folds the distant lights into spherical harmonics, far point lights only leave the uniform arrays since the listed paths already cull them
+		distantLightSH.Update(lightSystem, attenuation, camera.getPosition(), !listedLights);
+		const std::vector<int>& forwardPointIndices = distantLightSH.GetNearPointLights();
+
+		int forwardPointLights = listedLights ? 0 : glm::min((int)forwardPointIndices.size(), MAX_FORWARD_LIGHTS);
+		int forwardSpotlights = listedLights ? 0 : glm::min(lightSystem.spotlightCount, MAX_FORWARD_LIGHTS);
+
+		//Pick the lit shader permutation for this frame's settings. Keyed on the lights actually uploaded, unrolled variants
+		//shade their slots whatever _UsedPointLights says, and far lights already in the SH must not be shaded again.
+		LitPermutationKey litKey = LitPermutationKey::Create(phong, useTexture, forwardPointLights, lightSystem.directionalLightCount, forwardSpotlights, clusteredShading, perObjectLightCulling, distantLightSH.enabled);
+		Shader& litShader = *litVariants.Get(litKey);
+
 		//Draw
 		litShader.use();
 		litShader.setMat4("_Projection", camera.getProjectionMatrix());
@@ -239,82 +440,57 @@ int main() {
 
 		for (size_t i = 0; i < texManager.textureCount; i++)
 		{
+			//Set texture sampler to texture unit number, every frame since a relinked program loses it
+			litShader.setInt("_Textures[" + std::to_string(i) + "].texSampler", i);
+
 			texManager.textures[i].offset += texManager.textures[i].scrollSpeed * deltaTime;
 			litShader.setVec2("_Textures[" + std::to_string(i) + "].scaleFactor", texManager.textures[i].scaleFactor);
 			litShader.setVec2("_Textures[" + std::to_string(i) + "].offset", texManager.textures[i].offset);
 		}
 
 		//Attenuation Uniforms
-		litShader.setFloat("_Attenuation.constant", constantAttenuation);
-		litShader.setFloat("_Attenuation.linear", linearAttenuation);
-		litShader.setFloat("_Attenuation.quadratic", quadraticAttenuation);
+		litShader.setFloat("_Attenuation.constant", attenuation.constant);
+		litShader.setFloat("_Attenuation.linear", attenuation.linear);
+		litShader.setFloat("_Attenuation.quadratic", attenuation.quadratic);
 
 		//Point Light Uniforms
-		litShader.setInt("_UsedPointLights", pointLightCount);
+		litShader.setInt("_UsedPointLights", forwardPointLights);
 		
-		for (int i = 0; i < pointLightCount; i++)
+		for (int i = 0; i < forwardPointLights; i++)
 		{
-			if (!manuallyMoveLights)
-			{
-				pointLights[i].pos.x = pointLightRadius * (cos(2 * glm::pi<float>() * (i / (float)pointLightCount)));
-				pointLights[i].pos.y = pointLightHeight;
-				pointLights[i].pos.z = pointLightRadius * (sin(2 * glm::pi<float>() * (i / (float)pointLightCount)));
-			}
-
-			litShader.setVec3("_PointLight[" + std::to_string(i) + "].pos", pointLights[i].pos);
-			litShader.setVec3("_PointLight[" + std::to_string(i) + "].color", pointLights[i].color);
-			litShader.setFloat("_PointLight[" + std::to_string(i) + "].intensity", pointLights[i].intensity);
+			const GPUPointLight& light = gpuPointLights[forwardPointIndices[i]];
+			litShader.setVec3("_PointLight[" + std::to_string(i) + "].pos", glm::vec3(light.posRadius));
+			litShader.setVec3("_PointLight[" + std::to_string(i) + "].color", glm::vec3(light.colorIntensity));
+			litShader.setFloat("_PointLight[" + std::to_string(i) + "].intensity", light.colorIntensity.a);
+			litShader.setFloat("_PointLight[" + std::to_string(i) + "].radius", light.posRadius.w);
 		}
 
 		//Directional Light Uniforms
-		litShader.setInt("_UsedDirectionalLights", directionalLightCount);
+		const LightSystem::DirectionalLightArrays& directionalLights = lightSystem.GetDirectionalLights();
+		litShader.setInt("_UsedDirectionalLights", lightSystem.directionalLightCount);
 
-		for (int i = 0; i < directionalLightCount; i++)
+		for (int i = 0; i < lightSystem.directionalLightCount; i++)
 		{
-			if (!manuallyMoveLights)
-			{
-				float angle = glm::sin(glm::radians(-directionalLightAngle));
-
-				directionalLights[i].dir = glm::vec3(
-					//Defines the direction this axis is rotated towards			Defines what angle to rotate by
-					(cos(2 * glm::pi<float>() * (i / (float)directionalLightCount))) * angle,
-					1,
-					(sin(2 * glm::pi<float>() * (i / (float)directionalLightCount))) * angle
-				);
-			}
-
-			litShader.setVec3("_DirectionalLight[" + std::to_string(i) + "].dir", directionalLights[i].dir);
-			litShader.setVec3("_DirectionalLight[" + std::to_string(i) + "].color", directionalLights[i].color);
-			litShader.setFloat("_DirectionalLight[" + std::to_string(i) + "].intensity", directionalLights[i].intensity);
+			litShader.setVec3("_DirectionalLight[" + std::to_string(i) + "].dir", glm::vec3(directionalLights.dirX[i], directionalLights.dirY[i], directionalLights.dirZ[i]));
+			litShader.setVec3("_DirectionalLight[" + std::to_string(i) + "].color", glm::vec3(directionalLights.colorR[i], directionalLights.colorG[i], directionalLights.colorB[i]));
+			litShader.setFloat("_DirectionalLight[" + std::to_string(i) + "].intensity", directionalLights.intensity[i]);
 		}
 
 		//Spotlight Uniforms
-		litShader.setInt("_UsedSpotlights", spotlightCount);
+		litShader.setInt("_UsedSpotlights", forwardSpotlights);
 
-		for (int i = 0; i < spotlightCount; i++)
+		for (int i = 0; i < forwardSpotlights; i++)
 		{
-			if (!manuallyMoveLights)
-			{
-				spotlights[i].pos.x = spotlightRadius * (cos(2 * glm::pi<float>() * (i / (float)spotlightCount)));
-				spotlights[i].pos.y = spotlightHeight;
-				spotlights[i].pos.z = spotlightRadius * (sin(2 * glm::pi<float>() * (i / (float)spotlightCount)));
-				
-				spotlights[i].dir = glm::vec3(
-					//Defines the direction this axis is rotated towards			Defines what angle to rotate by
-					(cos(2 * glm::pi<float>() * (i / (float)spotlightCount))) * glm::sin(glm::radians(-spotlightAngle)),
-					-1,
-					(sin(2 * glm::pi<float>() * (i / (float)spotlightCount))) * glm::sin(glm::radians(-spotlightAngle))
-				);
-			}
-
-			litShader.setVec3("_Spotlight[" + std::to_string(i) + "].pos", spotlights[i].pos);
-			litShader.setVec3("_Spotlight[" + std::to_string(i) + "].dir", spotlights[i].dir);
-			litShader.setVec3("_Spotlight[" + std::to_string(i) + "].color", spotlights[i].color);
-			litShader.setFloat("_Spotlight[" + std::to_string(i) + "].intensity", spotlights[i].intensity);
-			litShader.setFloat("_Spotlight[" + std::to_string(i) + "].range", spotlights[i].range);
-			litShader.setFloat("_Spotlight[" + std::to_string(i) + "].minAngle", glm::cos(glm::radians(spotlights[i].innerAngle)));
-			litShader.setFloat("_Spotlight[" + std::to_string(i) + "].maxAngle", glm::cos(glm::radians(spotlights[i].outerAngle)));
-			litShader.setFloat("_Spotlight[" + std::to_string(i) + "].falloff", spotlights[i].angleFalloff);
+			const GPUSpotLight& light = gpuSpotLights[i];
+			litShader.setVec3("_Spotlight[" + std::to_string(i) + "].pos", glm::vec3(light.posRadius));
+			litShader.setVec3("_Spotlight[" + std::to_string(i) + "].dir", glm::vec3(light.dirFalloff));
+			litShader.setVec3("_Spotlight[" + std::to_string(i) + "].color", glm::vec3(light.colorIntensity));
+			litShader.setFloat("_Spotlight[" + std::to_string(i) + "].intensity", light.colorIntensity.a);
+			litShader.setFloat("_Spotlight[" + std::to_string(i) + "].radius", light.posRadius.w);
+			litShader.setFloat("_Spotlight[" + std::to_string(i) + "].range", light.rangeAngles.x);
+			litShader.setFloat("_Spotlight[" + std::to_string(i) + "].minAngle", light.rangeAngles.y);
+			litShader.setFloat("_Spotlight[" + std::to_string(i) + "].maxAngle", light.rangeAngles.z);
+			litShader.setFloat("_Spotlight[" + std::to_string(i) + "].falloff", light.dirFalloff.w);
 		}
 
 		//Material Uniforms
@@ -328,64 +504,409 @@ int main() {
 
 		litShader.setInt("_Phong", phong);
 
-		//Draw cube
-		glm::mat4 cubeModel = cubeTransform.getModelMatrix();
-		litShader.setMat4("_Model", cubeModel);
-		litShader.setMat4("_NormalMatrix", glm::transpose(glm::inverse(cubeModel)));
-		cubeMesh.draw();
-
-		////Draw sphere
-		glm::mat4 sphereModel = sphereTransform.getModelMatrix();
-		litShader.setMat4("_Model", sphereModel);
-		litShader.setMat4("_NormalMatrix", glm::transpose(glm::inverse(sphereModel)));
-		sphereMesh.draw();
-
-		//Draw cylinder
-		glm::mat4 cylinderModel = cylinderTransform.getModelMatrix();
-		litShader.setMat4("_Model", cylinderModel);
-		litShader.setMat4("_NormalMatrix", glm::transpose(glm::inverse(cylinderModel)));
-		cylinderMesh.draw();
-
-		//Draw plane
-		glm::mat4 planeModel = planeTransform.getModelMatrix();
-		litShader.setMat4("_Model", planeModel);
-		litShader.setMat4("_NormalMatrix", glm::transpose(glm::inverse(planeModel)));
-		planeMesh.draw();
+		shadowAtlas.Bind(litShader);
+
+		if (litKey.sphericalHarmonics)
+		{
+			distantLightSH.Bind(litShader);
+		}
+
+		//Cluster every point light and spotlight against the view frustum
+		if (clusteredShading && !deferredShading)
+		{
+			lightClusterer.Update(camera, lightSystem);
+			lightClusterer.Bind(litShader, dynamicResolution.GetWidth(), dynamicResolution.GetHeight());
+		}
+
+		//Radii of the forward lights, each draw below tests its bounds against them
+		if (litKey.perObjectLights && !deferredShading)
+		{
+			objectLightCuller.SetLights(lightSystem, forwardPointIndices, forwardPointLights, forwardSpotlights);
+		}
+
+		//Draws one shape, listing its lights first when the forward path culls them per object
+		auto drawShape = [&](Shader& shader, ew::Mesh& mesh, int shape, int lightmap, bool perObjectLights, bool depthOnly)
+		{
+			if (!shapeVisible[shape])
+			{
+				return;
+			}
+
+			glm::mat4 model = shapeTransforms[shape]->getModelMatrix();
+			shader.setMat4("_Model", model);
+
+			//The depth prepass only needs positions
+			if (depthOnly)
+			{
+				mesh.drawDepthOnly();
+				return;
+			}
+
+			if (perObjectLights)
+			{
+				objectLightCuller.Apply(shader, shapeWorldBounds[shape].sphere);
+			}
+			shader.setMat4("_NormalMatrix", glm::transpose(glm::inverse(model)));
+			lightmapBaker.Bind(shader, lightmap);
+			mesh.draw();
+		};
+
+		//Each prop asks the cache for its own cylinder, which hands every one of them the same mesh
+		if ((int)cylinderProps.size() != cylinderPropCount)
+		{
+			//Shrinking keeps the rest alive, so the cache doesn't rebuild the mesh every time the slider moves
+			while ((int)cylinderProps.size() > cylinderPropCount)
+			{
+				cylinderProps.pop_back();
+			}
+			while ((int)cylinderProps.size() < cylinderPropCount)
+			{
+				cylinderProps.push_back(primitiveCache.GetCylinder(.5f, .25f, 32));
+			}
+
+			cylinderPropModels.resize(cylinderPropCount);
+			for (int i = 0; i < cylinderPropCount; i++)
+			{
+				float angle = 6.2831853f * i / cylinderPropCount;
+				float ringRadius = 3.5f + .5f * (i % 3);
+				glm::vec3 position = glm::vec3(cosf(angle) * ringRadius, -.75f, sinf(angle) * ringRadius);
+				cylinderPropModels[i] = glm::translate(glm::mat4(1), position);
+			}
+		}
+
+		//World bounds of every shape, for frustum culling, LOD selection and the per-object light lists
+		TransformBounds(shapeLocalBounds, shapeTransforms, SHAPE_COUNT, shapeWorldBounds);
+		ExtractFrustumPlanes(camera.getProjectionMatrix() * camera.getViewMatrix(), cameraPlanes);
+		culledShapes = 0;
+		for (int i = 0; i < SHAPE_COUNT; i++)
+		{
+			shapeVisible[i] = !cullShapes || BoxInFrustum(cameraPlanes, shapeWorldBounds[i]);
+			culledShapes += shapeVisible[i] ? 0 : 1;
+		}
+
+		//The scene sphere and the point light gizmos below pick their LODs from the size they are rendered at
+		sphereLOD.BeginFrame();
+		sphereLevel = sphereLOD.SelectLevel(camera, dynamicResolution.GetHeight(), shapeWorldBounds[SPHERE].sphere, sphereLevel);
+		ew::Mesh& sphereDrawMesh = sphereLOD.GetLevel(sphereLevel);
+
+		//Per-object light lists are uniforms set before every draw, so that path keeps drawing one shape at a time
+		bool batchThisFrame = drawBatch.enabled && DrawBatch::IsSupported() && !(litKey.perObjectLights && !deferredShading);
+		if (batchThisFrame)
+		{
+			//Each lightmap is its own texture, so lightmapped shapes only share a multi-draw while lightmaps are off
+			auto lightmapGroup = [&](int lightmap) { return lightmapBaker.IsActive() ? lightmap : -1; };
+
+			drawBatch.Clear();
+			meshletCuller.BeginFrame(camera);
+			if (shapeVisible[CUBE])
+			{
+				drawBatch.Add(cubeMesh, cubeTransform.getModelMatrix(), lightmapGroup(cubeLightmap));
+			}
+			if (shapeVisible[SPHERE] && sphereLevel == 0)
+			{
+				meshletRanges.clear();
+				meshletCuller.Cull(sphereMeshlets, sphereTransform.getModelMatrix(), meshletRanges);
+				drawBatch.AddRanges(sphereDrawMesh, meshletRanges, sphereTransform.getModelMatrix(), -1);
+			}
+			else if (shapeVisible[SPHERE])
+			{
+				drawBatch.Add(sphereDrawMesh, sphereTransform.getModelMatrix(), -1);
+			}
+			if (shapeVisible[CYLINDER])
+			{
+				drawBatch.Add(cylinderMesh, cylinderTransform.getModelMatrix(), lightmapGroup(cylinderLightmap));
+			}
+			if (shapeVisible[PLANE])
+			{
+				drawBatch.Add(planeMesh, planeTransform.getModelMatrix(), lightmapGroup(planeLightmap));
+			}
+			if (shapeVisible[IMPORTED])
+			{
+				meshletRanges.clear();
+				meshletCuller.Cull(importedMeshlets, importedTransform.getModelMatrix(), meshletRanges);
+				drawBatch.AddRanges(importedMesh, meshletRanges, importedTransform.getModelMatrix(), -1);
+			}
+			for (size_t i = 0; i < cylinderProps.size(); i++)
+			{
+				drawBatch.Add(cylinderProps[i]->mesh, cylinderPropModels[i], -1);
+			}
+			drawBatch.Upload();
+		}
+
+		//Draws every shape, the sphere is the only one without a lightmap
+		auto drawShapes = [&](Shader& shader, bool perObjectLights, bool depthOnly)
+		{
+			//The manager's fallback program has no _Batched path
+			if (batchThisFrame && shader.isReady())
+			{
+				drawBatch.Draw(shader, depthOnly, [&](int lightmap) { lightmapBaker.Bind(shader, lightmap); });
+				return;
+			}
+
+			//Every shape lives in the pool, so its vertex array is bound once for the whole pass
+			if (depthOnly)
+			{
+				meshPool.bindDepthVertexArray();
+			}
+			else
+			{
+				meshPool.bindVertexArray();
+			}
+
+			drawShape(shader, cubeMesh, CUBE, cubeLightmap, perObjectLights, depthOnly);
+			drawShape(shader, sphereDrawMesh, SPHERE, -1, perObjectLights, depthOnly);
+			drawShape(shader, cylinderMesh, CYLINDER, cylinderLightmap, perObjectLights, depthOnly);
+			drawShape(shader, planeMesh, PLANE, planeLightmap, perObjectLights, depthOnly);
+			drawShape(shader, importedMesh, IMPORTED, -1, perObjectLights, depthOnly);
+
+			for (size_t i = 0; i < cylinderProps.size(); i++)
+			{
+				const glm::mat4& model = cylinderPropModels[i];
+				shader.setMat4("_Model", model);
+				if (depthOnly)
+				{
+					cylinderProps[i]->mesh.drawDepthOnly();
+					continue;
+				}
+
+				if (perObjectLights)
+				{
+					objectLightCuller.Apply(shader, TransformBoundingSphere(GetBoundingSphere(cylinderProps[i]->meshData), model));
+				}
+				shader.setMat4("_NormalMatrix", glm::transpose(glm::inverse(model)));
+				lightmapBaker.Bind(shader, -1);
+				cylinderProps[i]->mesh.draw();
+			}
+		};
+
+		if (deferredShading)
+		{
+			//Geometry pass into the G-buffer
+			Shader& gBufferShader = deferredRenderer.BeginGeometry(dynamicResolution.GetWidth(), dynamicResolution.GetHeight());
+			gBufferShader.setMat4("_Projection", camera.getProjectionMatrix());
+			gBufferShader.setMat4("_View", camera.getViewMatrix());
+
+			gBufferShader.setInt("_UseTexture", useTexture);
+			gBufferShader.setInt("_CurrentTexture", currentTextureIndex);
+			for (size_t i = 0; i < texManager.textureCount; i++)
+			{
+				gBufferShader.setInt("_Textures[" + std::to_string(i) + "].texSampler", i);
+				gBufferShader.setVec2("_Textures[" + std::to_string(i) + "].scaleFactor", texManager.textures[i].scaleFactor);
+				gBufferShader.setVec2("_Textures[" + std::to_string(i) + "].offset", texManager.textures[i].offset);
+			}
+
+			gBufferShader.setVec3("_Mat.color", defaultMat.color);
+			gBufferShader.setFloat("_Mat.ambientCoefficient", defaultMat.ambientK);
+			gBufferShader.setFloat("_Mat.diffuseCoefficient", defaultMat.diffuseK);
+			gBufferShader.setFloat("_Mat.specularCoefficient", defaultMat.specularK);
+			gBufferShader.setFloat("_Mat.shininess", defaultMat.shininess);
+
+			drawShapes(gBufferShader, false, false);
+
+			//Light volumes and the directional pass, then the result is copied to the screen
+			deferredRenderer.ShadeLights(camera, lightSystem, attenuation, phong, shadowAtlas, sphereMesh, lightVolumeCylinder->mesh, dynamicResolution.GetFramebuffer());
+		}
+		else
+		{
+			//GL_EQUAL only works once both programs run the lit vertex shader, not the manager's fallback
+			bool prepassThisFrame = depthPrepass && depthPrepassShader.isReady() && litShader.isReady();
+
+			if (prepassThisFrame)
+			{
+				//Lay down the nearest depth first so the lit pass below shades every pixel once
+				prepassTimer.Begin();
+				glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+				depthPrepassShader.use();
+				depthPrepassShader.setMat4("_Projection", camera.getProjectionMatrix());
+				depthPrepassShader.setMat4("_View", camera.getViewMatrix());
+				drawShapes(depthPrepassShader, false, true);
+				glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+				prepassTimer.End();
+
+				glDepthFunc(GL_EQUAL);
+				glDepthMask(GL_FALSE);
+			}
+
+			litTimer.Begin();
+			litShader.use();
+			drawShapes(litShader, litKey.perObjectLights, false);
+			litTimer.End();
+
+			if (prepassThisFrame)
+			{
+				glDepthFunc(GL_LESS);
+				glDepthMask(GL_TRUE);
+			}
+		}
 
 		//Draw light as a small sphere using unlit shader, ironically.
+		//One instanced draw per kind of light, however many there are
 		unlitShader.use();
 		unlitShader.setMat4("_Projection", camera.getProjectionMatrix());
 		unlitShader.setMat4("_View", camera.getViewMatrix());
-		for (size_t i = 0; i < pointLightCount; i++)
+
+		//Levels are kept per packed light for the hysteresis, a light that moves in the packing just starts from its new slot's level
+		pointLightGizmoLevels.resize(gpuPointLights.size(), 0);
+		for (int level = 0; level < MeshLOD::MAX_LEVELS; level++)
 		{
-			unlitShader.setMat4("_Model", glm::translate(glm::mat4(1), pointLights[i].pos) * glm::scale(glm::mat4(1), glm::vec3(lightScale)));
-			unlitShader.setVec3("_Color", pointLights[i].color);
-			sphereMesh.draw();
+			pointLightGizmos[level].clear();
 		}
-
-		for (size_t i = 0; i < spotlightCount; i++)
+		for (size_t i = 0; i < gpuPointLights.size(); i++)
 		{
-			glm::mat4 rotation = ew::rotateX(-asin(spotlights[i].dir.z)) * ew::rotateY(acos(spotlights[i].dir.y)) * ew::rotateZ(-asin(spotlights[i].dir.x));
+			BoundingSphere gizmoBounds;
+			gizmoBounds.center = glm::vec3(gpuPointLights[i].posRadius) + sphereBounds.center * lightScale;
+			gizmoBounds.radius = sphereBounds.radius * lightScale;
+			pointLightGizmoLevels[i] = sphereLOD.SelectLevel(camera, dynamicResolution.GetHeight(), gizmoBounds, pointLightGizmoLevels[i]);
+
+			ew::InstanceData instance;
+			instance.model = glm::mat4(lightScale);
+			instance.model[3] = glm::vec4(glm::vec3(gpuPointLights[i].posRadius), 1);
+			instance.color = glm::vec4(glm::vec3(gpuPointLights[i].colorIntensity), 1);
+			pointLightGizmos[pointLightGizmoLevels[i]].push_back(instance);
+		}
+		for (int level = 0; level < sphereLOD.GetLevelCount(); level++)
+		{
+			sphereLOD.GetLevel(level).drawInstanced(pointLightGizmos[level]);
+		}
 
-			unlitShader.setMat4("_Model", glm::translate(glm::mat4(1), spotlights[i].pos)* rotation * glm::scale(glm::mat4(1), glm::vec3(lightScale)));
-			unlitShader.setVec3("_Color", spotlights[i].color);
-			cylinderMesh.draw();
+		//The cylinder's axis is y, so the rotation is just a basis around the packed direction
+		spotlightGizmos.resize(gpuSpotLights.size());
+		for (size_t i = 0; i < gpuSpotLights.size(); i++)
+		{
+			glm::vec3 axis = glm::vec3(gpuSpotLights[i].dirFalloff);
+			glm::vec3 side = glm::normalize(glm::cross(fabsf(axis.y) < .99f ? glm::vec3(0, 1, 0) : glm::vec3(1, 0, 0), axis));
+			glm::vec3 forward = glm::cross(side, axis);
+
+			glm::mat4 model;
+			model[0] = glm::vec4(side * lightScale, 0);
+			model[1] = glm::vec4(axis * lightScale, 0);
+			model[2] = glm::vec4(forward * lightScale, 0);
+			model[3] = glm::vec4(glm::vec3(gpuSpotLights[i].posRadius), 1);
+			spotlightGizmos[i].model = model;
+			spotlightGizmos[i].color = glm::vec4(glm::vec3(gpuSpotLights[i].colorIntensity), 1);
 		}
+		lightVolumeCylinder->mesh.drawInstanced(spotlightGizmos);
+
+		//Upscale to the screen, ImGui draws on top at full resolution
+		dynamicResolution.EndScene();
+
+		lightSystem.pointLightCount = requestedPointLights;
+		lightSystem.spotlightCount = requestedSpotlights;
 
 		//Material
 		defaultMat.ExposeImGui();
 
+		//Shaders
+		shaderManager.ExposeImGui();
+
 		//General Settings
 		ImGui::SetNextWindowSize(ImVec2(0, 0));	//Size to fit content
 		ImGui::Begin("Settings");
 
 		ImGui::Checkbox("Phong Lighting", &phong);
+		ImGui::Checkbox("Use Texture", &useTexture);
+		litVariants.ExposeImGui();
 		ImGui::Checkbox("Manually Move Lights", &manuallyMoveLights);
 		ImGui::Text("Opens option under settings\nin different types of lights\nto change the individual\nposition and/or direction of\nthe lights");
 
 		ImGui::Text("GL Falloff Attenuation");
-		ImGui::SliderFloat("Linear", &linearAttenuation, .0014f, 1.f);
-		ImGui::SliderFloat("Quadratic", &quadraticAttenuation, .000007f, 2.0f);
+		ImGui::SliderFloat("Linear", &attenuation.linear, .0014f, 1.f);
+		ImGui::SliderFloat("Quadratic", &attenuation.quadratic, .000007f, 2.0f);
+		ImGui::SliderFloat("Light Cutoff", &lightCutoff, .001f, .1f, "%.4f");
+
+		bool modeChanged = ImGui::Checkbox("Deferred Shading", &deferredShading);
+		if (!deferredShading)
+		{
+			modeChanged |= ImGui::Checkbox("Clustered Shading", &clusteredShading);
+		}
+
+		//Back on the plain forward path, only the uniform arrays' worth of lights fit
+		if (modeChanged && !deferredShading && !clusteredShading)
+		{
+			lightSystem.pointLightCount = glm::min(lightSystem.pointLightCount, MAX_FORWARD_LIGHTS);
+			lightSystem.spotlightCount = glm::min(lightSystem.spotlightCount, MAX_FORWARD_LIGHTS);
+		}
+
+		lightSystem.ExposeImGui();
+		shadowAtlas.ExposeImGui();
+		lightmapBaker.ExposeImGui();
+		dynamicResolution.ExposeImGui();
+
+		//The deferred path keeps its own directional light pass
+		if (!deferredShading)
+		{
+			distantLightSH.ExposeImGui();
+		}
+
+		if (deferredShading)
+		{
+			deferredRenderer.ExposeImGui();
+		}
+		else if (clusteredShading)
+		{
+			lightClusterer.ExposeImGui();
+		}
+		else
+		{
+			ImGui::Checkbox("Per-Object Light Culling", &perObjectLightCulling);
+			if (litKey.perObjectLights)
+			{
+				objectLightCuller.ExposeImGui();
+			}
+		}
+
+		if (!deferredShading)
+		{
+			ImGui::Checkbox("Depth Prepass", &depthPrepass);
+			if (depthPrepass)
+			{
+				ImGui::Text("Depth prepass: %.3f ms, lit pass: %.3f ms", prepassTimer.GetAverageMilliseconds(), litTimer.GetAverageMilliseconds());
+			}
+			else
+			{
+				ImGui::Text("Lit pass: %.3f ms", litTimer.GetAverageMilliseconds());
+			}
+		}
+
+		ImGui::Text("Mesh pool: %d vertices, %d indices, %.1f KB (%.1f KB unquantized)", meshPool.getUsedVertices(), meshPool.getUsedIndices(),
+			meshPool.getUsedBytes() / 1024.f, meshPool.getUnquantizedBytes() / 1024.f);
+		frameRing.ExposeImGui();
+		ImGui::Text("Depth passes read %d of %d vertex bytes", (int)meshPool.getDepthVertexBytes(), (int)meshPool.getFullVertexBytes());
+		//Round trips the scene's shapes on demand, uploads don't measure it themselves
+		if (ImGui::Button("Measure Quantization Error"))
+		{
+			quantizationError = ew::QuantizationError();
+			const ew::MeshData* measured[] = { &cubeMeshData, &sphereMeshData, &cylinderMeshData, &planeMeshData, &importedMeshData };
+			for (const ew::MeshData* meshData : measured)
+			{
+				ew::measureQuantizationError(*meshData, quantizationError);
+			}
+			quantizationMeasured = true;
+		}
+		if (quantizationMeasured)
+		{
+			ImGui::Text("Quantization error: position %.5f, normal %.3f deg, uv %.6f", quantizationError.position, quantizationError.normal, quantizationError.uv);
+		}
+		meshOptimizer.ExposeImGui();
+		sphereLOD.ExposeImGui();
+
+		ImGui::Checkbox("Frustum Cull Shapes", &cullShapes);
+		ImGui::Text("%d of %d shapes outside the view", culledShapes, (int)SHAPE_COUNT);
+		if (DrawBatch::IsSupported())
+		{
+			ImGui::Checkbox("Multi-Draw Indirect", &drawBatch.enabled);
+			ImGui::Checkbox("Auto Instancing", &drawBatch.instancing);
+			if (batchThisFrame)
+			{
+				ImGui::Text("%d objects, %d draws as %d commands in %d multi-draws", drawBatch.GetObjectCount(), drawBatch.GetDrawCount(),
+					drawBatch.GetCommandCount(), drawBatch.GetLastSubmitCount());
+			}
+			meshletCuller.ExposeImGui();
+		}
+		else
+		{
+			ImGui::Text("Multi-draw batching needs ARB_shader_draw_parameters");
+		}
 
 		ImGui::End();
 
@@ -393,7 +914,7 @@ int main() {
 		ImGui::SetNextWindowSize(ImVec2(0, 0), ImGuiCond_FirstUseEver);	//Size to fit content
 		ImGui::Begin("Point Lights");
 
-		ImGui::SliderInt("Light Count", &pointLightCount, 0, MAX_POINT_LIGHTS);
+		ImGui::SliderInt("Light Count", &lightSystem.pointLightCount, 0, listedLights ? MAX_POINT_LIGHTS : MAX_FORWARD_LIGHTS);
 
 		if (!manuallyMoveLights)
 		{
@@ -401,12 +922,15 @@ int main() {
 			ImGui::SliderFloat("Light Array Height", &pointLightHeight, -5.f, 30.f);
 		}
 
-		for (size_t i = 0; i < pointLightCount; i++)
+		//Only the first few lights get editors, thousands of them would bury the window
+		for (size_t i = 0; i < glm::min(lightSystem.pointLightCount, MAX_FORWARD_LIGHTS); i++)
 		{
 			ImGui::Text(("Point Light" + std::to_string(i)).c_str());
 
 			ImGui::PushID(i);
-			pointLights[i].ExposeImGui(manuallyMoveLights);
+			PointLight light = lightSystem.GetPointLight(i);
+			light.ExposeImGui(manuallyMoveLights);
+			lightSystem.SetPointLight(i, light);
 			ImGui::PopID();
 		}
 
@@ -416,19 +940,21 @@ int main() {
 		ImGui::SetNextWindowSize(ImVec2(0, 0), ImGuiCond_FirstUseEver);	//Size to fit content
 		ImGui::Begin("Directional Light");
 
-		ImGui::SliderInt("Light Count", &directionalLightCount, 0, MAX_DIRECTIONAL_LIGHTS);
+		ImGui::SliderInt("Light Count", &lightSystem.directionalLightCount, 0, MAX_DIRECTIONAL_LIGHTS);
 
 		if (!manuallyMoveLights)
 		{
 			ImGui::SliderFloat("Light Array Angle", &directionalLightAngle, 90.f, 270.f);
 		}
 		
-		for (size_t i = 0; i < directionalLightCount; i++)
+		for (size_t i = 0; i < lightSystem.directionalLightCount; i++)
 		{
 			ImGui::Text(("Directional Light " + std::to_string(i)).c_str());
 
 			ImGui::PushID(i);
-			directionalLights[i].ExposeImGui(manuallyMoveLights);
+			DirectionalLight light = lightSystem.GetDirectionalLight(i);
+			light.ExposeImGui(manuallyMoveLights);
+			lightSystem.SetDirectionalLight(i, light);
 			ImGui::PopID();
 		}
 
@@ -438,7 +964,7 @@ int main() {
 		ImGui::SetNextWindowSize(ImVec2(0, 0), ImGuiCond_FirstUseEver);	//Size to fit content
 		ImGui::Begin("Spotlight");
 
-		ImGui::SliderInt("Light Count", &spotlightCount, 0, MAX_SPOTLIGHTS);
+		ImGui::SliderInt("Light Count", &lightSystem.spotlightCount, 0, listedLights ? MAX_SPOTLIGHTS : MAX_FORWARD_LIGHTS);
 
 		if (!manuallyMoveLights)
 		{
@@ -447,17 +973,56 @@ int main() {
 			ImGui::SliderFloat("Light Array Angle", &spotlightAngle, -60.f, 60.f);
 		}
 
-		for (size_t i = 0; i < spotlightCount; i++)
+		for (size_t i = 0; i < glm::min(lightSystem.spotlightCount, MAX_FORWARD_LIGHTS); i++)
 		{
 			ImGui::Text(("Spotlight " + std::to_string(i)).c_str());
 
 			ImGui::PushID(i);
-			spotlights[i].ExposeImGui(manuallyMoveLights);
+			SpotLight light = lightSystem.GetSpotlight(i);
+			light.ExposeImGui(manuallyMoveLights);
+			lightSystem.SetSpotlight(i, light);
 			ImGui::PopID();
 		}
 
 		ImGui::End();
 
+		//Shapes
+		ImGui::SetNextWindowSize(ImVec2(0, 0), ImGuiCond_FirstUseEver);	//Size to fit content
+		ImGui::Begin("Shapes");
+
+		const char* shapeNames[SHAPE_COUNT] = { "Cube", "Sphere", "Cylinder", "Plane", "Imported" };
+		for (size_t i = 0; i < shadowCasters.size(); i++)
+		{
+			ImGui::PushID(i);
+			ImGui::Text(shapeNames[i]);
+			ImGui::DragFloat3("Position", &shadowCasters[i].transform->position.x, .05f);
+			ImGui::DragFloat3("Rotation", &shadowCasters[i].transform->rotation.x, .01f);
+			ImGui::DragFloat3("Scale", &shadowCasters[i].transform->scale.x, .05f);
+			ImGui::PopID();
+		}
+
+		ImGui::InputText("OBJ Path", importPath, sizeof(importPath));
+		if (ImGui::Button("Import"))
+		{
+			ew::MeshData loaded;
+			if (meshImporter.Load(importPath, loaded))
+			{
+				importedMeshData = std::move(loaded);
+				importedBounds = GetBoundingSphere(importedMeshData);
+				importedMesh = ew::Mesh(&meshPool, &importedMeshData);
+				MeshletCuller::Build(importedMeshData, importedMeshlets);
+				shadowCasters.back().localBounds = importedBounds;
+				shadowAtlas.Invalidate();
+			}
+		}
+		meshImporter.ExposeImGui();
+		shapeGenBenchmark.ExposeImGui();
+
+		ImGui::SliderInt("Cylinder Props", &cylinderPropCount, 0, MAX_CYLINDER_PROPS);
+		primitiveCache.ExposeImGui();
+
+		ImGui::End();
+
 		//Texture
 		ImGui::SetNextWindowSize(ImVec2(0, 0), ImGuiCond_FirstUseEver);	//Size to fit content
 		ImGui::Begin("Textures");
@@ -476,13 +1041,11 @@ int main() {
 
 		ImGui::Render();
 		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+		frameRing.EndFrame();
 		glfwPollEvents();
 
 		glfwSwapBuffers(window);
 	}
-
-	glfwTerminate();
-	return 0;
 }
 //Author: Eric Winebrenner
 void resizeFrameBufferCallback(GLFWwindow* window, int width, int height)
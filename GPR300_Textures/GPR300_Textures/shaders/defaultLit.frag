@@ -1,4 +1,24 @@
 #version 450                          
+//Permutation defines from LitShaderVariants are inserted after the #version line.
+//PHONG / BLINN_PHONG pick the specular model at compile time, otherwise the _Phong uniform does.
+//*_LIGHT_COUNT of -1 loops to the _Used* uniform, 0 strips the light type, 1-4 are fully unrolled.
+//CLUSTERED reads point lights and spotlights from LightClusterer's storage buffers instead of the uniform arrays.
+//Meshes with a baked lightmap (_UseLightmap) read directional light and spotlight diffuse from it and skip those lights.
+//PER_OBJECT_LIGHTS only visits the lights ObjectLightCuller listed for this draw in _PointLightIndices/_SpotlightIndices.
+//SPHERICAL_HARMONICS takes directional light diffuse from DistantLightSH's coefficients, only _SHSpecularLights get exact specular.
+#ifndef POINT_LIGHT_COUNT
+#define POINT_LIGHT_COUNT -1
+#endif
+#ifndef DIRECTIONAL_LIGHT_COUNT
+#define DIRECTIONAL_LIGHT_COUNT -1
+#endif
+#ifndef SPOTLIGHT_COUNT
+#define SPOTLIGHT_COUNT -1
+#endif
+#ifndef TEXTURED
+#define TEXTURED 1
+#endif
+
 out vec4 FragColor;
 
 in struct Vertex
@@ -9,6 +29,8 @@ in struct Vertex
     vec2 UV;
 }vert_out;
 
+in vec2 LightmapUV;
+
 //Uniforms from application
 
 struct Attenuation
@@ -25,6 +47,7 @@ struct PointLight
     vec3 pos;
     vec3 color;
     float intensity;
+    float radius;   //Past this the light is culled, the falloff is windowed to reach zero there
 };
 
 const int MAX_POINT_LIGHTS = 8;
@@ -48,6 +71,7 @@ struct Spotlight
     vec3 dir;
     vec3 color;
     float intensity;
+    float radius;
 
     float range;
     float minAngle;
@@ -59,6 +83,43 @@ const int MAX_SPOTLIGHTS = 8;
 uniform Spotlight _Spotlight[MAX_SPOTLIGHTS];
 uniform int _UsedSpotlights;
 
+#ifdef PER_OBJECT_LIGHTS
+//Indices into the arrays above of the lights that reach the current draw, _Used* hold how many are listed
+uniform int _PointLightIndices[MAX_POINT_LIGHTS];
+uniform int _SpotlightIndices[MAX_SPOTLIGHTS];
+#endif
+
+#ifdef CLUSTERED
+//Mirrors GPUPointLight / GPUSpotLight in LightClusterer.h
+struct ClusterPointLight
+{
+    vec4 posRadius;
+    vec4 colorIntensity;
+};
+
+struct ClusterSpotlight
+{
+    vec4 posRadius;
+    vec4 dirFalloff;
+    vec4 colorIntensity;
+    vec4 rangeAngles;
+};
+
+layout(std430, binding = 0) readonly buffer ClusterPointLights { ClusterPointLight _ClusterPointLights[]; };
+layout(std430, binding = 1) readonly buffer ClusterSpotlights { ClusterSpotlight _ClusterSpotlights[]; };
+layout(std430, binding = 2) readonly buffer ClusterGrid { uvec4 _Clusters[]; };    //point offset, point count, spot offset, spot count
+layout(std430, binding = 3) readonly buffer ClusterLightIndices { uint _ClusterLightIndices[]; };
+
+const int CLUSTERS_X = 16;
+const int CLUSTERS_Y = 9;
+const int CLUSTERS_Z = 24;
+
+uniform mat4 _View;
+uniform vec2 _ClusterTileSize;
+uniform float _ClusterScale;
+uniform float _ClusterBias;
+#endif
+
 struct Material
 {
     vec3 color;
@@ -80,10 +141,43 @@ struct Texture
     sampler2D texSampler;
 };
 
-const int MAX_TEXTURES = 32;
+const int MAX_TEXTURES = 16;
 uniform Texture _Textures[MAX_TEXTURES];
 uniform int _CurrentTexture;
 
+//Shadow maps from ShadowAtlas, a rect with no size means the light has no tile
+uniform sampler2DShadow _ShadowAtlas;
+uniform vec2 _ShadowTexelSize;
+
+const int MAX_SHADOWED_LIGHTS = 8;
+uniform mat4 _DirectionalShadowMatrix[MAX_SHADOWED_LIGHTS];
+uniform vec4 _DirectionalShadowRect[MAX_SHADOWED_LIGHTS];
+uniform mat4 _SpotlightShadowMatrix[MAX_SHADOWED_LIGHTS];
+uniform vec4 _SpotlightShadowRect[MAX_SHADOWED_LIGHTS];
+
+#ifdef SPHERICAL_HARMONICS
+//L2 irradiance of every distant light, already convolved with the cosine lobe
+uniform vec3 _SHCoefficients[9];
+//Just the far point lights, lightmapped meshes have the directional lights baked already
+uniform vec3 _SHPointCoefficients[9];
+
+struct SHSpecularLight
+{
+    vec3 dir;
+    vec3 color;     //Intensity included
+    int shadowIndex;    //Into the directional shadow arrays, -1 for none
+    bool pointLight;    //A far point light rather than a directional one
+};
+
+const int MAX_SH_SPECULAR_LIGHTS = 4;
+uniform SHSpecularLight _SHSpecularLights[MAX_SH_SPECULAR_LIGHTS];
+uniform int _UsedSHSpecularLights;
+#endif
+
+//Directional light and spotlight irradiance from LightmapBaker, shadows and one bounce included
+uniform sampler2D _Lightmap;
+uniform bool _UseLightmap;
+
 //Functions
 
 vec3 calculateDiffuse(float coefficient, vec3 lightDir, vec3 worldNormal, vec3 intensity)
@@ -103,6 +197,25 @@ float calculateBlinnPhong(vec3 eyeDir, vec3 lightDir, vec3 worldNormal)
     return dot(worldNormal, halfVec);
 }
 
+//What dot product to put in for specular (depending on if phong or blinn-phong it changes)
+float calculateSpecularAngle(vec3 eyeDir, vec3 lightDir, vec3 worldNormal)
+{
+#if defined(PHONG)
+    return calculatePhong(eyeDir, -lightDir, worldNormal);
+#elif defined(BLINN_PHONG)
+    return calculateBlinnPhong(eyeDir, lightDir, worldNormal);
+#else
+    if(_Phong)    //Phong
+    {
+        return calculatePhong(eyeDir, -lightDir, worldNormal);
+    }
+    else    //Blinn-Phong
+    {
+        return calculateBlinnPhong(eyeDir, lightDir, worldNormal);
+    }
+#endif
+}
+
 vec3 calculateSpecular(float coefficient, float angle, float shininess, vec3 intensity)
 {
     return coefficient * pow(clamp(angle, 0, 1), shininess) * intensity;
@@ -113,97 +226,268 @@ float calculateAttenuationFactor(float dist, float constant, float linear, float
     return 1 / (constant + (linear * dist) + (quadratic * dist * dist));
 }
 
-void pointLights(inout vec3 diffuse, inout vec3 specular)
+//Fraction of light reaching worldPos, 3x3 filtered taps kept inside the light's tile
+float calculateShadow(mat4 shadowMatrix, vec4 rect, vec3 worldPos, vec3 worldNormal)
 {
-    for(int i = 0; i < _UsedPointLights; i++)
+    if(rect.z <= 0)
     {
-        vec3 intensityRGB = _PointLight[i].intensity * _PointLight[i].color * _Mat.color;   //Material color and light intensity/color
-        float dist = distance(vert_out.WorldPos, _PointLight[i].pos);    //distance between candidate point and light
-        vec3 lightDir = normalize(_PointLight[i].pos - vert_out.WorldPos);  //Direction to light
-        float attenuationFactor = calculateAttenuationFactor(dist, _Attenuation.constant, _Attenuation.linear, _Attenuation.quadratic);   //Factor of how much light makes it based on distance
+        return 1;
+    }
 
-        //Diffuse Light
-        diffuse += calculateDiffuse(_Mat.diffuseCoefficient, lightDir, vert_out.WorldNormal, intensityRGB)
-        * attenuationFactor;
-    
-        //Specular Light
-        float angle = 0;    //What dot product to put in for specular (depending on if phong or blinn-phong it changes)
-        vec3 eyeDir = normalize(_CamPos - vert_out.WorldPos);   //Direction to viewer
+    //Nudge along the normal so surfaces facing away from the light don't shadow themselves
+    vec4 clip = shadowMatrix * vec4(worldPos + worldNormal * .02, 1);
+    vec3 coord = clip.xyz / clip.w * .5 + .5;
+    if(clip.w <= 0 || any(lessThan(coord, vec3(0))) || any(greaterThan(coord, vec3(1))))
+    {
+        return 1;
+    }
 
-        if(_Phong)    //Phong
-        {
-            angle = calculatePhong(eyeDir, -lightDir, vert_out.WorldNormal);
-        }
-        else    //Blinn-Phong
+    vec2 uv = rect.xy + coord.xy * rect.zw;
+    vec2 tileMin = rect.xy + _ShadowTexelSize;
+    vec2 tileMax = rect.xy + rect.zw - _ShadowTexelSize;
+
+    float lit = 0;
+    for(int y = -1; y <= 1; y++)
+    {
+        for(int x = -1; x <= 1; x++)
         {
-            angle = calculateBlinnPhong(eyeDir, lightDir, vert_out.WorldNormal);
+            lit += textureLod(_ShadowAtlas, vec3(clamp(uv + vec2(x, y) * _ShadowTexelSize, tileMin, tileMax), coord.z), 0);
         }
-    
-        specular += calculateSpecular(_Mat.specularCoefficient, angle, _Mat.shininess, intensityRGB)
-        * attenuationFactor;
     }
+    return lit / 9;
 }
 
-void directionalLight(inout vec3 diffuse, inout vec3 specular)
+//Fades light out towards its radius so nothing pops when the CPU stops counting it as in range
+float calculateRadiusWindow(float dist, float radius)
 {
-    for(int i = 0; i < _UsedDirectionalLights; i++)
+    float ratio = dist / radius;
+    float window = clamp(1 - ratio * ratio * ratio * ratio, 0, 1);
+    return window * window;
+}
+
+void shadePointLight(vec3 lightPos, vec3 lightColor, float lightIntensity, float radius, vec3 eyeDir, inout vec3 diffuse, inout vec3 specular)
+{
+    vec3 intensityRGB = lightIntensity * lightColor * _Mat.color;   //Material color and light intensity/color
+    float dist = distance(vert_out.WorldPos, lightPos);    //distance between candidate point and light
+    vec3 lightDir = normalize(lightPos - vert_out.WorldPos);  //Direction to light
+    float attenuationFactor = calculateAttenuationFactor(dist, _Attenuation.constant, _Attenuation.linear, _Attenuation.quadratic)
+        * calculateRadiusWindow(dist, radius);   //Factor of how much light makes it based on distance
+
+    //Diffuse Light
+    diffuse += calculateDiffuse(_Mat.diffuseCoefficient, lightDir, vert_out.WorldNormal, intensityRGB)
+    * attenuationFactor;
+
+    //Specular Light
+    float angle = calculateSpecularAngle(eyeDir, lightDir, vert_out.WorldNormal);
+
+    specular += calculateSpecular(_Mat.specularCoefficient, angle, _Mat.shininess, intensityRGB)
+    * attenuationFactor;
+}
+
+void shadeSpotlight(vec3 lightPos, vec3 spotDir, vec3 lightColor, float lightIntensity, float radius, float range, float minAngle, float maxAngle, float falloff, float shadow, vec3 eyeDir, inout vec3 diffuse, inout vec3 specular)
+{
+    vec3 intensityRGB = lightIntensity * lightColor * _Mat.color;   //Material color and light intensity/color
+    float dist = distance(vert_out.WorldPos, lightPos);    //distance between candidate point and light
+    vec3 lightDir = normalize(lightPos - vert_out.WorldPos);  //Direction to light
+    float attenuationFactor = calculateAttenuationFactor(dist, _Attenuation.constant, _Attenuation.linear, _Attenuation.quadratic)
+        * calculateRadiusWindow(dist, radius);   //Factor of how much light makes it based on distance
+
+    vec3 fragDir = -lightDir;
+    float fragAngle = dot(normalize(spotDir), fragDir);
+    float angularAttentuation = pow(max(min(((fragAngle - maxAngle) / (minAngle - maxAngle)), 1), 0), falloff) * range * shadow;
+
+    //Diffuse Light
+    diffuse += calculateDiffuse(_Mat.diffuseCoefficient, lightDir, vert_out.WorldNormal, intensityRGB)
+    * attenuationFactor * angularAttentuation; 
+
+    //Specular Light
+    float angle = calculateSpecularAngle(eyeDir, lightDir, vert_out.WorldNormal);
+
+    specular += calculateSpecular(_Mat.specularCoefficient, angle, _Mat.shininess, intensityRGB)
+    * attenuationFactor * angularAttentuation;
+}
+
+void pointLight(int i, vec3 eyeDir, inout vec3 diffuse, inout vec3 specular)
+{
+    shadePointLight(_PointLight[i].pos, _PointLight[i].color, _PointLight[i].intensity, _PointLight[i].radius, eyeDir, diffuse, specular);
+}
+
+void directionalLight(int i, vec3 eyeDir, inout vec3 diffuse, inout vec3 specular)
+{
+    vec3 intensityRGB = _DirectionalLight[i].intensity * _DirectionalLight[i].color * _Mat.color;   //Material color and light intensity/color
+    vec3 lightDir = normalize(_DirectionalLight[i].dir);
+    float shadow = i < MAX_SHADOWED_LIGHTS ? calculateShadow(_DirectionalShadowMatrix[i], _DirectionalShadowRect[i], vert_out.WorldPos, vert_out.WorldNormal) : 1;
+    intensityRGB *= shadow;
+
+    //Diffuse Light
+    diffuse += calculateDiffuse(_Mat.diffuseCoefficient, lightDir, vert_out.WorldNormal, intensityRGB);
+
+    //Specular Light
+    float angle = calculateSpecularAngle(eyeDir, lightDir, vert_out.WorldNormal);
+
+    specular += calculateSpecular(_Mat.specularCoefficient, angle, _Mat.shininess, intensityRGB);
+}
+
+//Spotlight shadows are indexed the same as LightSystem's spotlights, in every path
+float spotlightShadow(int i)
+{
+    return i < MAX_SHADOWED_LIGHTS ? calculateShadow(_SpotlightShadowMatrix[i], _SpotlightShadowRect[i], vert_out.WorldPos, vert_out.WorldNormal) : 1;
+}
+
+void spotlight(int i, vec3 eyeDir, inout vec3 diffuse, inout vec3 specular)
+{
+    shadeSpotlight(_Spotlight[i].pos, _Spotlight[i].dir, _Spotlight[i].color, _Spotlight[i].intensity, _Spotlight[i].radius,
+        _Spotlight[i].range, _Spotlight[i].minAngle, _Spotlight[i].maxAngle, _Spotlight[i].falloff, spotlightShadow(i), eyeDir, diffuse, specular);
+}
+
+#ifdef SPHERICAL_HARMONICS
+//Same basis order as EvaluateBasis in DistantLightSH.cpp
+vec3 evaluateIrradianceSH(vec3 coefficients[9], vec3 n)
+{
+    vec3 irradiance = coefficients[0] * .282095;
+    irradiance += coefficients[1] * (.488603 * n.y);
+    irradiance += coefficients[2] * (.488603 * n.z);
+    irradiance += coefficients[3] * (.488603 * n.x);
+    irradiance += coefficients[4] * (1.092548 * n.x * n.y);
+    irradiance += coefficients[5] * (1.092548 * n.y * n.z);
+    irradiance += coefficients[6] * (.315392 * (3 * n.z * n.z - 1));
+    irradiance += coefficients[7] * (1.092548 * n.x * n.z);
+    irradiance += coefficients[8] * (.546274 * (n.x * n.x - n.y * n.y));
+    return max(irradiance, vec3(0));
+}
+
+//Diffuse of every distant light at a fixed cost, specular only from the brightest few.
+//Lightmapped meshes only take the far point lights, their directional light is in the lightmap.
+void distantLights(vec3 eyeDir, bool lightmapped, inout vec3 diffuse, inout vec3 specular)
+{
+    vec3 irradiance = lightmapped ? evaluateIrradianceSH(_SHPointCoefficients, vert_out.WorldNormal) : evaluateIrradianceSH(_SHCoefficients, vert_out.WorldNormal);
+    diffuse += _Mat.diffuseCoefficient * _Mat.color * irradiance;
+
+    for(int i = 0; i < _UsedSHSpecularLights; i++)
     {
-        vec3 intensityRGB = _DirectionalLight[i].intensity * _DirectionalLight[i].color * _Mat.color;   //Material color and light intensity/color
-        vec3 lightDir = normalize(_DirectionalLight[i].dir);
-    
-        //Diffuse Light
-        diffuse += calculateDiffuse(_Mat.diffuseCoefficient, lightDir, vert_out.WorldNormal, intensityRGB);
-    
-        //Specular Light
-        float angle = 0;    //What dot product to put in for specular (depending on if phong or blinn-phong it changes)
-        vec3 eyeDir = normalize(_CamPos - vert_out.WorldPos);   //Direction to viewer
-
-        if(_Phong)    //Phong
+        if(lightmapped && !_SHSpecularLights[i].pointLight)
         {
-            angle = calculatePhong(eyeDir, -lightDir, vert_out.WorldNormal);
-        }
-        else    //Blinn-Phong
-        {         
-            angle = calculateBlinnPhong(eyeDir, lightDir, vert_out.WorldNormal);
+            continue;
         }
-    
-        specular += calculateSpecular(_Mat.specularCoefficient, angle, _Mat.shininess, intensityRGB);
+
+        int shadowIndex = _SHSpecularLights[i].shadowIndex;
+        float shadow = shadowIndex >= 0 && shadowIndex < MAX_SHADOWED_LIGHTS ? calculateShadow(_DirectionalShadowMatrix[shadowIndex], _DirectionalShadowRect[shadowIndex], vert_out.WorldPos, vert_out.WorldNormal) : 1;
+        vec3 lightDir = normalize(_SHSpecularLights[i].dir);
+        float angle = calculateSpecularAngle(eyeDir, lightDir, vert_out.WorldNormal);
+
+        specular += calculateSpecular(_Mat.specularCoefficient, angle, _Mat.shininess, _SHSpecularLights[i].color * _Mat.color * shadow);
     }
 }
+#endif
 
-void calculateSpotlight(inout vec3 diffuse, inout vec3 specular)
+#ifdef CLUSTERED
+//Only visits the lights LightClusterer assigned to this fragment's froxel
+void clusteredLights(vec3 eyeDir, inout vec3 diffuse, inout vec3 specular)
 {
-    for(int i = 0; i < _UsedSpotlights; i++)
+    float viewDepth = -(_View * vec4(vert_out.WorldPos, 1)).z;
+    int slice = clamp(int(floor(log(viewDepth) * _ClusterScale + _ClusterBias)), 0, CLUSTERS_Z - 1);
+    ivec2 tile = clamp(ivec2(gl_FragCoord.xy / _ClusterTileSize), ivec2(0), ivec2(CLUSTERS_X - 1, CLUSTERS_Y - 1));
+    uvec4 cluster = _Clusters[tile.x + tile.y * CLUSTERS_X + slice * CLUSTERS_X * CLUSTERS_Y];
+
+    for(uint i = 0; i < cluster.y; i++)
     {
-        vec3 intensityRGB = _Spotlight[i].intensity * _Spotlight[i].color * _Mat.color;   //Material color and light intensity/color
-        float dist = distance(vert_out.WorldPos, _Spotlight[i].pos);    //distance between candidate point and light
-        vec3 lightDir = normalize(_Spotlight[i].pos - vert_out.WorldPos);  //Direction to light
-        float attenuationFactor = calculateAttenuationFactor(dist, _Attenuation.constant, _Attenuation.linear, _Attenuation.quadratic);   //Factor of how much light makes it based on distance
+        ClusterPointLight light = _ClusterPointLights[_ClusterLightIndices[cluster.x + i]];
+        shadePointLight(light.posRadius.xyz, light.colorIntensity.rgb, light.colorIntensity.a, light.posRadius.w, eyeDir, diffuse, specular);
+    }
+
+    //Baked into the lightmap
+    if(_UseLightmap)
+    {
+        return;
+    }
 
-        vec3 fragDir = normalize(vert_out.WorldPos - _Spotlight[i].pos);
-        float fragAngle = dot(normalize(_Spotlight[i].dir), fragDir);
-        float angularAttentuation = pow(max(min(((fragAngle - _Spotlight[i].maxAngle) / (_Spotlight[i].minAngle - _Spotlight[i].maxAngle)), 1), 0), _Spotlight[i].falloff) * _Spotlight[i].range;
+    for(uint i = 0; i < cluster.w; i++)
+    {
+        uint index = _ClusterLightIndices[cluster.z + i];
+        ClusterSpotlight light = _ClusterSpotlights[index];
+        shadeSpotlight(light.posRadius.xyz, light.dirFalloff.xyz, light.colorIntensity.rgb, light.colorIntensity.a, light.posRadius.w,
+            light.rangeAngles.x, light.rangeAngles.y, light.rangeAngles.z, light.dirFalloff.w, spotlightShadow(int(index)), eyeDir, diffuse, specular);
+    }
+}
+#endif
 
-        //Diffuse Light
-        diffuse += calculateDiffuse(_Mat.diffuseCoefficient, lightDir, vert_out.WorldNormal, intensityRGB)
-        * attenuationFactor * angularAttentuation; 
+void pointLights(vec3 eyeDir, inout vec3 diffuse, inout vec3 specular)
+{
+#if defined(PER_OBJECT_LIGHTS)
+    for(int i = 0; i < _UsedPointLights; i++)
+    {
+        pointLight(_PointLightIndices[i], eyeDir, diffuse, specular);
+    }
+#elif POINT_LIGHT_COUNT < 0
+    for(int i = 0; i < _UsedPointLights; i++)
+    {
+        pointLight(i, eyeDir, diffuse, specular);
+    }
+#else
+    #if POINT_LIGHT_COUNT > 0
+    pointLight(0, eyeDir, diffuse, specular);
+    #endif
+    #if POINT_LIGHT_COUNT > 1
+    pointLight(1, eyeDir, diffuse, specular);
+    #endif
+    #if POINT_LIGHT_COUNT > 2
+    pointLight(2, eyeDir, diffuse, specular);
+    #endif
+    #if POINT_LIGHT_COUNT > 3
+    pointLight(3, eyeDir, diffuse, specular);
+    #endif
+#endif
+}
 
-        //Specular Light
-        float angle = 0;    //What dot product to put in for specular (depending on if phong or blinn-phong it changes)
-        vec3 eyeDir = normalize(_CamPos - vert_out.WorldPos);   //Direction to viewer
+void directionalLights(vec3 eyeDir, inout vec3 diffuse, inout vec3 specular)
+{
+#if DIRECTIONAL_LIGHT_COUNT < 0
+    for(int i = 0; i < _UsedDirectionalLights; i++)
+    {
+        directionalLight(i, eyeDir, diffuse, specular);
+    }
+#else
+    #if DIRECTIONAL_LIGHT_COUNT > 0
+    directionalLight(0, eyeDir, diffuse, specular);
+    #endif
+    #if DIRECTIONAL_LIGHT_COUNT > 1
+    directionalLight(1, eyeDir, diffuse, specular);
+    #endif
+    #if DIRECTIONAL_LIGHT_COUNT > 2
+    directionalLight(2, eyeDir, diffuse, specular);
+    #endif
+    #if DIRECTIONAL_LIGHT_COUNT > 3
+    directionalLight(3, eyeDir, diffuse, specular);
+    #endif
+#endif
+}
 
-        if(_Phong)    //Phong
-        {
-            angle = calculatePhong(eyeDir, -lightDir, vert_out.WorldNormal);
-        }
-        else    //Blinn-Phong
-        {
-            angle = calculateBlinnPhong(eyeDir, lightDir, vert_out.WorldNormal);
-        }
-    
-        specular += calculateSpecular(_Mat.specularCoefficient, angle, _Mat.shininess, intensityRGB)
-        * attenuationFactor * angularAttentuation;
+void spotlights(vec3 eyeDir, inout vec3 diffuse, inout vec3 specular)
+{
+#if defined(PER_OBJECT_LIGHTS)
+    for(int i = 0; i < _UsedSpotlights; i++)
+    {
+        spotlight(_SpotlightIndices[i], eyeDir, diffuse, specular);
+    }
+#elif SPOTLIGHT_COUNT < 0
+    for(int i = 0; i < _UsedSpotlights; i++)
+    {
+        spotlight(i, eyeDir, diffuse, specular);
     }
+#else
+    #if SPOTLIGHT_COUNT > 0
+    spotlight(0, eyeDir, diffuse, specular);
+    #endif
+    #if SPOTLIGHT_COUNT > 1
+    spotlight(1, eyeDir, diffuse, specular);
+    #endif
+    #if SPOTLIGHT_COUNT > 2
+    spotlight(2, eyeDir, diffuse, specular);
+    #endif
+    #if SPOTLIGHT_COUNT > 3
+    spotlight(3, eyeDir, diffuse, specular);
+    #endif
+#endif
 }
 
 void main()
@@ -214,15 +498,44 @@ void main()
     vec3 diffuse = vec3(0);
     vec3 specular = vec3(0);
 
-    //Point Light diffuse and specular
-    pointLights(diffuse, specular);
+    //Direction to viewer, the same for every light
+    vec3 eyeDir = normalize(_CamPos - vert_out.WorldPos);
 
-    //Directional light diffuse and specular
-    directionalLight(diffuse, specular);
+#ifdef CLUSTERED
+    //Point light and spotlight diffuse and specular, culled per cluster
+    clusteredLights(eyeDir, diffuse, specular);
+#else
+    //Point Light diffuse and specular
+    pointLights(eyeDir, diffuse, specular);
 
     //Spotlight diffuse and specular
-    calculateSpotlight(diffuse, specular);
+    if(!_UseLightmap)
+    {
+        spotlights(eyeDir, diffuse, specular);
+    }
+#endif
+
+    if(_UseLightmap)
+    {
+        //Baked directional light and spotlight diffuse, these lights give no specular on baked meshes
+        diffuse += _Mat.diffuseCoefficient * _Mat.color * texture(_Lightmap, LightmapUV).rgb;
+    }
+
+#ifdef SPHERICAL_HARMONICS
+    //Directional lights and far point lights, projected on the CPU. The far point lights aren't baked, so lightmapped meshes still need them.
+    distantLights(eyeDir, _UseLightmap, diffuse, specular);
+#else
+    if(!_UseLightmap)
+    {
+        //Directional light diffuse and specular
+        directionalLights(eyeDir, diffuse, specular);
+    }
+#endif
 
+#if TEXTURED
     FragColor = texture(_Textures[_CurrentTexture].texSampler, (vert_out.UV + _Textures[_CurrentTexture].offset) * _Textures[_CurrentTexture].scaleFactor) * vec4(ambient + diffuse + specular, 1.0f);
+#else
+    FragColor = vec4(ambient + diffuse + specular, 1.0f);
+#endif
     //FragColor = vec4(vert_out.UV.x, vert_out.UV.y, 0, 1);
 }
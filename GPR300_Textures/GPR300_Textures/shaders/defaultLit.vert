@@ -1,7 +1,14 @@
 #version 450                          
+//Batched draws find their transforms through the base instance, DrawBatch only submits when this is available
+#extension GL_ARB_shader_draw_parameters : enable
 layout (location = 0) in vec3 vPos;  
-layout (location = 1) in vec3 vNormal;
+layout (location = 1) in vec2 vNormal;	//Octahedral, ew::MeshPool quantizes normals
 layout (location = 2) in vec2 vTexCoord;
+layout (location = 3) in vec2 vLightmapUV;
+//Dequantizes the snorm16 positions, ew::Mesh sets these to its box before every draw
+layout (location = 9) in vec3 vPositionScale;
+layout (location = 10) in vec3 vPositionOffset;
+layout (location = 11) in vec4 vUVQuantization;    //Scale in xy, offset in zw, so uvs outside 0-1 survive
 
 out struct Vertex
 {
@@ -11,16 +18,70 @@ out struct Vertex
     vec2 UV;
 }vert_out;
 
+//Only meshes LightmapBaker unwrapped have this stream, the rest read 0
+out vec2 LightmapUV;
+
 uniform mat4 _Model;
 uniform mat4 _View;
 uniform mat4 _Projection;
 
 uniform mat4 _NormalMatrix;
 
+//Per-draw transforms of a DrawBatch multi-draw, used instead of _Model and _NormalMatrix when _Batched is set
+struct DrawTransform
+{
+    mat4 model;
+    mat4 normalMatrix;
+    vec4 positionScale;
+    vec4 positionOffset;
+    vec4 uvQuantization;
+};
+
+layout(std430, binding = 4) readonly buffer DrawTransforms
+{
+    DrawTransform _DrawTransforms[];
+};
+
+uniform bool _Batched;
+
+//The depth prepass runs this shader too, the lit pass tests GL_EQUAL against it so both have to compute the exact same position
+invariant gl_Position;
+
+vec3 decodeOctahedral(vec2 encoded)
+{
+    vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    if(normal.z < 0)
+    {
+        normal.xy = (1.0 - abs(encoded.yx)) * vec2(encoded.x >= 0 ? 1.0 : -1.0, encoded.y >= 0 ? 1.0 : -1.0);
+    }
+    return normalize(normal);
+}
+
 void main(){    
-    vert_out.Normal = vNormal;
-    vert_out.WorldPos = vec3(_Model * vec4(vPos, 1));
-    vert_out.WorldNormal = normalize(mat3(_NormalMatrix) * vert_out.Normal);
-    vert_out.UV = vTexCoord;
-    gl_Position = _Projection * _View * _Model * vec4(vPos,1);
+    mat4 model = _Model;
+    mat4 normalMatrix = _NormalMatrix;
+    vec3 positionScale = vPositionScale;
+    vec3 positionOffset = vPositionOffset;
+    vec4 uvQuantization = vUVQuantization;
+#ifdef GL_ARB_shader_draw_parameters
+    if(_Batched)
+    {
+        //Instanced commands cover objects whose transforms sit next to each other
+        int drawIndex = gl_BaseInstanceARB + gl_InstanceID;
+        model = _DrawTransforms[drawIndex].model;
+        normalMatrix = _DrawTransforms[drawIndex].normalMatrix;
+        positionScale = _DrawTransforms[drawIndex].positionScale.xyz;
+        positionOffset = _DrawTransforms[drawIndex].positionOffset.xyz;
+        uvQuantization = _DrawTransforms[drawIndex].uvQuantization;
+    }
+#endif
+
+    vec3 position = vPos * positionScale + positionOffset;
+
+    vert_out.Normal = decodeOctahedral(vNormal);
+    vert_out.WorldPos = vec3(model * vec4(position, 1));
+    vert_out.WorldNormal = normalize(mat3(normalMatrix) * vert_out.Normal);
+    vert_out.UV = vTexCoord * uvQuantization.xy + uvQuantization.zw;
+    LightmapUV = vLightmapUV;
+    gl_Position = _Projection * _View * model * vec4(position,1);
 }
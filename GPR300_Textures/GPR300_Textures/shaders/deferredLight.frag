@@ -0,0 +1,203 @@
+#version 450
+//Lighting passes of the deferred path, added onto the lighting target.
+//Point lights by default, SPOTLIGHT for spotlight volumes, DIRECTIONAL for the fullscreen directional pass.
+out vec4 FragColor;
+
+uniform sampler2D _GAlbedoDiffuse;
+uniform sampler2D _GNormalSpecular;
+uniform sampler2D _GDepth;
+
+uniform mat4 _InverseViewProjection;
+uniform vec2 _ScreenSize;
+uniform vec3 _CamPos;
+uniform bool _Phong;
+
+struct Attenuation
+{
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+uniform Attenuation _Attenuation;
+
+//Shadow maps from ShadowAtlas, a rect with no size means the light has no tile
+uniform sampler2DShadow _ShadowAtlas;
+uniform vec2 _ShadowTexelSize;
+
+const int MAX_SHADOWED_LIGHTS = 8;
+uniform mat4 _DirectionalShadowMatrix[MAX_SHADOWED_LIGHTS];
+uniform vec4 _DirectionalShadowRect[MAX_SHADOWED_LIGHTS];
+uniform mat4 _SpotlightShadowMatrix[MAX_SHADOWED_LIGHTS];
+uniform vec4 _SpotlightShadowRect[MAX_SHADOWED_LIGHTS];
+
+#if defined(DIRECTIONAL)
+struct DirectionalLight
+{
+    vec3 dir;
+    vec3 color;
+    float intensity;
+};
+
+const int MAX_DIRECTIONAL_LIGHTS = 8;
+uniform DirectionalLight _DirectionalLight[MAX_DIRECTIONAL_LIGHTS];
+uniform int _UsedDirectionalLights;
+#else
+//Mirrors GPUPointLight / GPUSpotLight in LightSystem.h
+struct PointLight
+{
+    vec4 posRadius;
+    vec4 colorIntensity;
+};
+
+struct Spotlight
+{
+    vec4 posRadius;
+    vec4 dirFalloff;
+    vec4 colorIntensity;
+    vec4 rangeAngles;
+};
+
+layout(std430, binding = 0) readonly buffer PointLights { PointLight _PointLights[]; };
+layout(std430, binding = 1) readonly buffer Spotlights { Spotlight _Spotlights[]; };
+
+flat in int LightIndex;
+#endif
+
+struct Surface
+{
+    vec3 worldPos;
+    vec3 normal;
+    vec3 albedo;
+    float diffuseCoefficient;
+    float specularCoefficient;
+    float shininess;
+};
+
+vec3 octahedralDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0);
+    n.xy += vec2(n.x >= 0 ? -t : t, n.y >= 0 ? -t : t);
+    return normalize(n);
+}
+
+//Same models as defaultLit.frag
+float calculateSpecularAngle(vec3 eyeDir, vec3 lightDir, vec3 normal)
+{
+    if(_Phong)
+    {
+        return dot(normalize(reflect(-lightDir, normal)), eyeDir);
+    }
+
+    return dot(normal, normalize(eyeDir + lightDir));
+}
+
+//Fraction of light reaching worldPos, 3x3 filtered taps kept inside the light's tile
+float calculateShadow(mat4 shadowMatrix, vec4 rect, vec3 worldPos, vec3 worldNormal)
+{
+    if(rect.z <= 0)
+    {
+        return 1;
+    }
+
+    //Nudge along the normal so surfaces facing away from the light don't shadow themselves
+    vec4 clip = shadowMatrix * vec4(worldPos + worldNormal * .02, 1);
+    vec3 coord = clip.xyz / clip.w * .5 + .5;
+    if(clip.w <= 0 || any(lessThan(coord, vec3(0))) || any(greaterThan(coord, vec3(1))))
+    {
+        return 1;
+    }
+
+    vec2 uv = rect.xy + coord.xy * rect.zw;
+    vec2 tileMin = rect.xy + _ShadowTexelSize;
+    vec2 tileMax = rect.xy + rect.zw - _ShadowTexelSize;
+
+    float lit = 0;
+    for(int y = -1; y <= 1; y++)
+    {
+        for(int x = -1; x <= 1; x++)
+        {
+            lit += textureLod(_ShadowAtlas, vec3(clamp(uv + vec2(x, y) * _ShadowTexelSize, tileMin, tileMax), coord.z), 0);
+        }
+    }
+    return lit / 9;
+}
+
+float calculateAttenuationFactor(float dist)
+{
+    return 1 / (_Attenuation.constant + (_Attenuation.linear * dist) + (_Attenuation.quadratic * dist * dist));
+}
+
+float calculateRadiusWindow(float dist, float radius)
+{
+    float ratio = dist / radius;
+    float window = clamp(1 - ratio * ratio * ratio * ratio, 0, 1);
+    return window * window;
+}
+
+vec3 shade(Surface surface, vec3 lightDir, vec3 intensityRGB)
+{
+    vec3 eyeDir = normalize(_CamPos - surface.worldPos);
+    vec3 diffuse = surface.diffuseCoefficient * clamp(dot(lightDir, surface.normal), 0, 1) * intensityRGB;
+    vec3 specular = surface.specularCoefficient * pow(clamp(calculateSpecularAngle(eyeDir, lightDir, surface.normal), 0, 1), surface.shininess) * intensityRGB;
+    return (diffuse + specular) * surface.albedo;
+}
+
+void main()
+{
+    vec2 uv = gl_FragCoord.xy / _ScreenSize;
+    float depth = texture(_GDepth, uv).r;
+
+    //Nothing was drawn here
+    if(depth >= 1)
+    {
+        discard;
+    }
+
+    vec4 worldPos = _InverseViewProjection * vec4(vec3(uv, depth) * 2 - 1, 1);
+    vec4 albedoDiffuse = texture(_GAlbedoDiffuse, uv);
+    vec4 normalSpecular = texture(_GNormalSpecular, uv);
+
+    Surface surface;
+    surface.worldPos = worldPos.xyz / worldPos.w;
+    surface.normal = octahedralDecode(normalSpecular.xy);
+    surface.albedo = albedoDiffuse.rgb;
+    surface.diffuseCoefficient = albedoDiffuse.a;
+    surface.specularCoefficient = normalSpecular.z;
+    surface.shininess = normalSpecular.w;
+
+    vec3 light = vec3(0);
+
+#if defined(DIRECTIONAL)
+    for(int i = 0; i < _UsedDirectionalLights; i++)
+    {
+        float shadow = i < MAX_SHADOWED_LIGHTS ? calculateShadow(_DirectionalShadowMatrix[i], _DirectionalShadowRect[i], surface.worldPos, surface.normal) : 1;
+        light += shade(surface, normalize(_DirectionalLight[i].dir), _DirectionalLight[i].intensity * _DirectionalLight[i].color) * shadow;
+    }
+#elif defined(SPOTLIGHT)
+    Spotlight spot = _Spotlights[LightIndex];
+    vec3 toLight = spot.posRadius.xyz - surface.worldPos;
+    float dist = length(toLight);
+    vec3 lightDir = toLight / dist;
+
+    float fragAngle = dot(spot.dirFalloff.xyz, -lightDir);
+    float angularAttenuation = pow(clamp((fragAngle - spot.rangeAngles.z) / (spot.rangeAngles.y - spot.rangeAngles.z), 0, 1), spot.dirFalloff.w) * spot.rangeAngles.x;
+    float attenuation = calculateAttenuationFactor(dist) * calculateRadiusWindow(dist, spot.posRadius.w) * angularAttenuation;
+    if(LightIndex < MAX_SHADOWED_LIGHTS)
+    {
+        attenuation *= calculateShadow(_SpotlightShadowMatrix[LightIndex], _SpotlightShadowRect[LightIndex], surface.worldPos, surface.normal);
+    }
+
+    light = shade(surface, lightDir, spot.colorIntensity.a * spot.colorIntensity.rgb) * attenuation;
+#else
+    PointLight point = _PointLights[LightIndex];
+    vec3 toLight = point.posRadius.xyz - surface.worldPos;
+    float dist = length(toLight);
+
+    light = shade(surface, toLight / dist, point.colorIntensity.a * point.colorIntensity.rgb)
+        * calculateAttenuationFactor(dist) * calculateRadiusWindow(dist, point.posRadius.w);
+#endif
+
+    FragColor = vec4(light, 0);
+}
@@ -0,0 +1,54 @@
+#version 450
+//Light volume of the deferred path, one instance per light.
+//Point lights scale sphereMesh to their radius, SPOTLIGHT stretches cylinderMesh around the cone.
+layout (location = 0) in vec3 vPos;
+//Dequantizes the snorm16 positions, ew::Mesh sets these to its box before every draw
+layout (location = 9) in vec3 vPositionScale;
+layout (location = 10) in vec3 vPositionOffset;
+
+//Mirrors GPUPointLight / GPUSpotLight in LightSystem.h
+struct PointLight
+{
+    vec4 posRadius;
+    vec4 colorIntensity;
+};
+
+struct Spotlight
+{
+    vec4 posRadius;
+    vec4 dirFalloff;
+    vec4 colorIntensity;
+    vec4 rangeAngles;
+};
+
+layout(std430, binding = 0) readonly buffer PointLights { PointLight _PointLights[]; };
+layout(std430, binding = 1) readonly buffer Spotlights { Spotlight _Spotlights[]; };
+
+uniform mat4 _View;
+uniform mat4 _Projection;
+
+flat out int LightIndex;
+
+void main()
+{
+    LightIndex = gl_InstanceID;
+    vec3 localPos = vPos * vPositionScale + vPositionOffset;
+
+#ifdef SPOTLIGHT
+    Spotlight light = _Spotlights[gl_InstanceID];
+    vec3 axis = light.dirFalloff.xyz;
+    vec3 side = normalize(cross(axis, abs(axis.y) < .99 ? vec3(0, 1, 0) : vec3(1, 0, 0)));
+    vec3 up = cross(side, axis);
+
+    //The cylinder runs y -.5 to .5 with radius .5, the apex goes at the bottom cap
+    float length = light.posRadius.w;
+    float cosOuter = min(light.rangeAngles.y, light.rangeAngles.z);
+    float width = 2 * length * sqrt(1 - cosOuter * cosOuter);    //Nothing within range of the apex and inside the cone is further from the axis
+    vec3 worldPos = light.posRadius.xyz + axis * (localPos.y + .5) * length + (side * localPos.x + up * localPos.z) * width;
+#else
+    PointLight light = _PointLights[gl_InstanceID];
+    vec3 worldPos = light.posRadius.xyz + localPos * 2 * light.posRadius.w;
+#endif
+
+    gl_Position = _Projection * _View * vec4(worldPos, 1);
+}
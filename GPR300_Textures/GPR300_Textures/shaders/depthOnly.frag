@@ -0,0 +1,6 @@
+#version 450
+//Nothing to write, the depth buffer gets everything it needs from the rasterizer
+
+void main()
+{
+}
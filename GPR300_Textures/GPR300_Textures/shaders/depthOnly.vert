@@ -0,0 +1,14 @@
+#version 450
+//Depth-only passes, fed by ew::Mesh's position-only vertex array
+layout (location = 0) in vec3 vPos;
+//Dequantizes the snorm16 positions, ew::Mesh sets these to its box before every draw
+layout (location = 9) in vec3 vPositionScale;
+layout (location = 10) in vec3 vPositionOffset;
+
+uniform mat4 _Model;
+uniform mat4 _ViewProjection;
+
+void main()
+{
+    gl_Position = _ViewProjection * _Model * vec4(vPos * vPositionScale + vPositionOffset, 1);
+}
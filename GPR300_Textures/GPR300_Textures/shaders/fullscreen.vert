@@ -0,0 +1,9 @@
+#version 450
+//One triangle covering the screen, drawn with 3 vertices and no vertex buffer
+out vec2 UV;
+
+void main()
+{
+    UV = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(UV * 2 - 1, 0, 1);
+}
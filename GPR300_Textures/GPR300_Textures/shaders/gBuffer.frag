@@ -0,0 +1,63 @@
+#version 450
+//Geometry pass of the deferred path, drawn with defaultLit.vert.
+//Writes surface attributes for DeferredRenderer's light passes and seeds the lighting target with ambient light.
+layout(location = 0) out vec4 GAlbedoDiffuse;     //albedo, diffuse coefficient
+layout(location = 1) out vec4 GNormalSpecular;    //octahedral normal, specular coefficient, shininess
+layout(location = 2) out vec4 GLighting;          //Accumulated light, starts at ambient
+
+in struct Vertex
+{
+    vec3 Normal;
+    vec3 WorldPos;
+    vec3 WorldNormal;
+    vec2 UV;
+}vert_out;
+
+struct Material
+{
+    vec3 color;
+
+    float ambientCoefficient;
+    float diffuseCoefficient;
+    float specularCoefficient;
+    float shininess;
+};
+
+uniform Material _Mat;
+
+struct Texture
+{
+    vec2 scaleFactor;
+    vec2 offset;
+    sampler2D texSampler;
+};
+
+const int MAX_TEXTURES = 16;
+uniform Texture _Textures[MAX_TEXTURES];
+uniform int _CurrentTexture;
+uniform bool _UseTexture;
+
+//Folds the unit sphere onto a square so a normal fits in two channels
+vec2 octahedralEncode(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 folded = n.xy;
+    if(n.z < 0)
+    {
+        folded = (1 - abs(n.yx)) * vec2(n.x >= 0 ? 1 : -1, n.y >= 0 ? 1 : -1);
+    }
+    return folded;
+}
+
+void main()
+{
+    vec3 albedo = _Mat.color;
+    if(_UseTexture)
+    {
+        albedo *= texture(_Textures[_CurrentTexture].texSampler, (vert_out.UV + _Textures[_CurrentTexture].offset) * _Textures[_CurrentTexture].scaleFactor).rgb;
+    }
+
+    GAlbedoDiffuse = vec4(albedo, _Mat.diffuseCoefficient);
+    GNormalSpecular = vec4(octahedralEncode(normalize(vert_out.WorldNormal)), _Mat.specularCoefficient, _Mat.shininess);
+    GLighting = vec4(_Mat.ambientCoefficient * albedo, 1);
+}
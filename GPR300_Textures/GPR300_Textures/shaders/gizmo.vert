@@ -0,0 +1,19 @@
+#version 450
+//Light gizmos, every light of a kind in one draw through ew::Mesh::drawInstanced
+layout (location = 0) in vec3 vPos;
+layout (location = 4) in mat4 vInstanceModel;
+layout (location = 8) in vec4 vInstanceColor;
+//Dequantizes the snorm16 positions, ew::Mesh sets these to its box before every draw
+layout (location = 9) in vec3 vPositionScale;
+layout (location = 10) in vec3 vPositionOffset;
+
+uniform mat4 _View;
+uniform mat4 _Projection;
+
+out vec3 Color;
+
+void main()
+{
+    Color = vInstanceColor.rgb;
+    gl_Position = _Projection * _View * vInstanceModel * vec4(vPos * vPositionScale + vPositionOffset, 1);
+}
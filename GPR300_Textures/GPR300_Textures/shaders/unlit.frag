@@ -1,8 +1,9 @@
 #version 450                          
 out vec4 FragColor;
 
-uniform vec3 _Color;
+//Per instance, from gizmo.vert
+in vec3 Color;
 
 void main(){         
-    FragColor = vec4(_Color,1.0f);
+    FragColor = vec4(Color,1.0f);
 }
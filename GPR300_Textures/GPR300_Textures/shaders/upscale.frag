@@ -0,0 +1,36 @@
+#version 450
+//Stretches DynamicResolution's scaled scene over the whole screen, drawn with fullscreen.vert.
+//_Sharpness of 0 is plain bilinear, above it an unsharp mask adds back some of the detail lost to the lower resolution.
+out vec4 FragColor;
+
+in vec2 UV;
+
+uniform sampler2D _Scene;
+uniform vec2 _UVScale;      //Fraction of the texture the scene was rendered into
+uniform vec2 _TexelSize;
+uniform float _Sharpness;
+
+void main()
+{
+    //Keep the bilinear footprint inside the rendered rect
+    vec2 uvMax = _UVScale - _TexelSize * .5;
+    vec2 uv = min(UV * _UVScale, uvMax);
+
+    vec3 center = textureLod(_Scene, uv, 0).rgb;
+    if(_Sharpness <= 0)
+    {
+        FragColor = vec4(center, 1);
+        return;
+    }
+
+    vec3 left = textureLod(_Scene, clamp(uv - vec2(_TexelSize.x, 0), vec2(0), uvMax), 0).rgb;
+    vec3 right = textureLod(_Scene, clamp(uv + vec2(_TexelSize.x, 0), vec2(0), uvMax), 0).rgb;
+    vec3 down = textureLod(_Scene, clamp(uv - vec2(0, _TexelSize.y), vec2(0), uvMax), 0).rgb;
+    vec3 up = textureLod(_Scene, clamp(uv + vec2(0, _TexelSize.y), vec2(0), uvMax), 0).rgb;
+
+    //Clamped to the neighbourhood so edges don't ring
+    vec3 sharpened = center + (center * 4 - left - right - down - up) * (_Sharpness * .25);
+    vec3 low = min(center, min(min(left, right), min(down, up)));
+    vec3 high = max(center, max(max(left, right), max(down, up)));
+    FragColor = vec4(clamp(sharpened, low, high), 1);
+}